@@ -0,0 +1,276 @@
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim:  CMAES.cpp                                   *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+
+//=============================================================================
+// INCLUDES
+//=============================================================================
+#include "CMAES.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+
+
+using namespace OpenSim;
+using namespace std;
+
+
+/* The eigenvalues and eigenvectors (the columns of V) of the symmetric n by
+ * n matrix A, by cyclic Jacobi rotations, which are plenty for the few
+ * variables CMAES is used for. A is destroyed.
+ */
+static void computeEigen(int n, vector<double>& A, vector<double>& values,
+                         vector<double>& V)
+{
+    V.assign(n*n, 0.0);
+    for (int i = 0; i < n; ++i)
+        V[i*n + i] = 1;
+
+    for (int sweep = 0; sweep < 100; ++sweep) {
+        double offDiagonal = 0;
+        for (int p = 0; p < n; ++p)
+            for (int q = p + 1; q < n; ++q)
+                offDiagonal += A[p*n + q]*A[p*n + q];
+        if (offDiagonal < 1.0e-30)
+            break;
+
+        for (int p = 0; p < n; ++p) {
+            for (int q = p + 1; q < n; ++q) {
+                if (A[p*n + q] == 0)
+                    continue;
+                // the rotation that zeros A(p,q)
+                double theta = (A[q*n + q] - A[p*n + p])/(2*A[p*n + q]);
+                double t = (theta >= 0 ? 1 : -1)/
+                           (std::abs(theta) + std::sqrt(theta*theta + 1));
+                double c = 1/std::sqrt(t*t + 1);
+                double s = t*c;
+                for (int k = 0; k < n; ++k) {
+                    double akp = A[k*n + p], akq = A[k*n + q];
+                    A[k*n + p] = c*akp - s*akq;
+                    A[k*n + q] = s*akp + c*akq;
+                }
+                for (int k = 0; k < n; ++k) {
+                    double apk = A[p*n + k], aqk = A[q*n + k];
+                    A[p*n + k] = c*apk - s*aqk;
+                    A[q*n + k] = s*apk + c*aqk;
+                }
+                for (int k = 0; k < n; ++k) {
+                    double vkp = V[k*n + p], vkq = V[k*n + q];
+                    V[k*n + p] = c*vkp - s*vkq;
+                    V[k*n + q] = s*vkp + c*vkq;
+                }
+            }
+        }
+    }
+
+    values.resize(n);
+    for (int i = 0; i < n; ++i)
+        values[i] = A[i*n + i];
+}
+
+
+//=============================================================================
+// CONSTRUCTOR(S)
+//=============================================================================
+//_____________________________________________________________________________
+/* The strategy parameters are the defaults of Hansen's tutorial. */
+CMAES::CMAES(const std::vector<double>& mean, double sigma,
+             int populationSize, unsigned seed) :
+    _n((int)mean.size()),
+    _mean(mean),
+    _sigma(sigma),
+    _random(seed),
+    _generation(0),
+    _best(mean),
+    _bestCost(numeric_limits<double>::infinity())
+{
+    const double n = _n;
+    _lambda = populationSize > 0 ? populationSize
+                                 : 4 + (int)std::floor(3*std::log(n));
+    _lambda = std::max(_lambda, 2);
+    _mu = _lambda/2;
+
+    _weights.resize(_mu);
+    for (int i = 0; i < _mu; ++i)
+        _weights[i] = std::log(_lambda/2.0 + 0.5) - std::log(i + 1.0);
+    double sum = accumulate(_weights.begin(), _weights.end(), 0.0);
+    double sumOfSquares = 0;
+    for (double& w : _weights) {
+        w /= sum;
+        sumOfSquares += w*w;
+    }
+    _muEff = 1/sumOfSquares;
+
+    _cSigma = (_muEff + 2)/(n + _muEff + 5);
+    _dSigma = 1 + 2*std::max(0.0, std::sqrt((_muEff - 1)/(n + 1)) - 1) +
+              _cSigma;
+    _cc = (4 + _muEff/n)/(n + 4 + 2*_muEff/n);
+    _c1 = 2/((n + 1.3)*(n + 1.3) + _muEff);
+    _cMu = std::min(1 - _c1, 2*(_muEff - 2 + 1/_muEff)/
+                             ((n + 2)*(n + 2) + _muEff));
+    _chiN = std::sqrt(n)*(1 - 1/(4*n) + 1/(21*n*n));
+
+    _C.assign(_n*_n, 0.0);
+    for (int i = 0; i < _n; ++i)
+        _C[i*_n + i] = 1;
+    _pSigma.assign(_n, 0.0);
+    _pc.assign(_n, 0.0);
+    decompose();
+
+    _population.assign(_lambda, vector<double>(_n));
+    _z.assign(_lambda, vector<double>(_n));
+}
+
+//=============================================================================
+// GENERATIONS
+//=============================================================================
+//_____________________________________________________________________________
+const std::vector<std::vector<double>>& CMAES::ask()
+{
+    for (int k = 0; k < _lambda; ++k) {
+        vector<double>& z = _z[k];
+        for (double& zi : z)
+            zi = _normal(_random);
+        for (int i = 0; i < _n; ++i) {
+            double y = 0;
+            for (int j = 0; j < _n; ++j)
+                y += _B[i*_n + j]*_D[j]*z[j];
+            _population[k][i] = _mean[i] + _sigma*y;
+        }
+    }
+    return _population;
+}
+
+void CMAES::tell(const std::vector<double>& costs)
+{
+    vector<int> order(_lambda);
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(),
+                [&](int a, int b) { return costs[a] < costs[b]; });
+
+    if (costs[order[0]] < _bestCost) {
+        _bestCost = costs[order[0]];
+        _best = _population[order[0]];
+    }
+
+    // move the mean to the weighted mean of the best
+    const vector<double> oldMean = _mean;
+    vector<double> yw(_n, 0.0);
+    for (int i = 0; i < _n; ++i) {
+        double m = 0;
+        for (int k = 0; k < _mu; ++k)
+            m += _weights[k]*_population[order[k]][i];
+        _mean[i] = m;
+        yw[i] = (m - oldMean[i])/_sigma;
+    }
+
+    // the step in the coordinates of the distribution: B*D^-1*B'*yw
+    vector<double> bty(_n, 0.0), whitened(_n, 0.0);
+    for (int j = 0; j < _n; ++j) {
+        for (int i = 0; i < _n; ++i)
+            bty[j] += _B[i*_n + j]*yw[i];
+        bty[j] /= _D[j];
+    }
+    for (int i = 0; i < _n; ++i)
+        for (int j = 0; j < _n; ++j)
+            whitened[i] += _B[i*_n + j]*bty[j];
+
+    const double cs = std::sqrt(_cSigma*(2 - _cSigma)*_muEff);
+    double normPSigma = 0;
+    for (int i = 0; i < _n; ++i) {
+        _pSigma[i] = (1 - _cSigma)*_pSigma[i] + cs*whitened[i];
+        normPSigma += _pSigma[i]*_pSigma[i];
+    }
+    normPSigma = std::sqrt(normPSigma);
+
+    // stall the covariance path while the step size grows fast
+    const double hSigma = normPSigma/std::sqrt(
+            1 - std::pow(1 - _cSigma, 2.0*(_generation + 1))) <
+            (1.4 + 2/(_n + 1.0))*_chiN ? 1 : 0;
+    const double cc = std::sqrt(_cc*(2 - _cc)*_muEff);
+    for (int i = 0; i < _n; ++i)
+        _pc[i] = (1 - _cc)*_pc[i] + hSigma*cc*yw[i];
+
+    // rank-one and rank-mu updates of the covariance
+    const double keep = 1 - _c1 - _cMu +
+                        _c1*(1 - hSigma)*_cc*(2 - _cc);
+    for (int i = 0; i < _n; ++i) {
+        for (int j = 0; j <= i; ++j) {
+            double rankMu = 0;
+            for (int k = 0; k < _mu; ++k) {
+                const vector<double>& x = _population[order[k]];
+                rankMu += _weights[k]*(x[i] - oldMean[i])*(x[j] - oldMean[j]);
+            }
+            rankMu /= _sigma*_sigma;
+            double c = keep*_C[i*_n + j] + _c1*_pc[i]*_pc[j] + _cMu*rankMu;
+            _C[i*_n + j] = c;
+            _C[j*_n + i] = c;
+        }
+    }
+
+    _sigma *= std::exp(_cSigma/_dSigma*(normPSigma/_chiN - 1));
+
+    ++_generation;
+    decompose();
+
+    const size_t window = 10 + (size_t)std::ceil(30.0*_n/_lambda);
+    _history.push_back(costs[order[0]]);
+    if (_history.size() > window)
+        _history.erase(_history.begin());
+}
+
+void CMAES::decompose()
+{
+    vector<double> A = _C;
+    vector<double> values;
+    computeEigen(_n, A, values, _B);
+    _D.resize(_n);
+    for (int i = 0; i < _n; ++i)
+        _D[i] = std::sqrt(std::max(values[i], 1.0e-20));
+}
+
+//=============================================================================
+// CONVERGENCE
+//=============================================================================
+double CMAES::getMaxStandardDeviation() const
+{
+    double maxVariance = 0;
+    for (int i = 0; i < _n; ++i)
+        maxVariance = std::max(maxVariance, _C[i*_n + i]);
+    return _sigma*std::sqrt(maxVariance);
+}
+
+bool CMAES::hasConverged(double tolX, double tolFun) const
+{
+    if (_generation > 0 && getMaxStandardDeviation() < tolX)
+        return true;
+
+    const size_t window = 10 + (size_t)std::ceil(30.0*_n/_lambda);
+    if (_history.size() < window)
+        return false;
+    auto range = minmax_element(_history.begin(), _history.end());
+    return *range.second - *range.first < tolFun;
+}
@@ -0,0 +1,142 @@
+#ifndef OPENSIM_CMAES_H_
+#define OPENSIM_CMAES_H_
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim: CMAES.h                                      *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+//============================================================================
+// INCLUDE
+//============================================================================
+#include <random>
+#include <vector>
+
+
+
+namespace OpenSim {
+
+//=============================================================================
+//=============================================================================
+/**
+ * CMAES minimizes a function of a few variables without derivatives with
+ * the covariance matrix adaptation evolution strategy (Hansen, "The CMA
+ * Evolution Strategy: A Tutorial", 2016). Every generation samples a
+ * population of candidates from a normal distribution, and the best half
+ * moves the mean and adapts the covariance and step size of the
+ * distribution.
+ *
+ * The caller evaluates the candidates, so that a whole population can be
+ * evaluated at once, for example in parallel:
+ *
+ * @code
+ * CMAES cmaes(x0, 0.3);
+ * while (!cmaes.hasConverged(1e-6, 1e-9) && cmaes.getGeneration() < 200) {
+ *     const std::vector<std::vector<double>>& population = cmaes.ask();
+ *     for (int i = 0; i < cmaes.getPopulationSize(); ++i)
+ *         costs[i] = f(population[i]);
+ *     cmaes.tell(costs);
+ * }
+ * @endcode
+ *
+ * @author  Hjalti Hilmarsson
+ */
+class CMAES {
+
+public:
+    /** Start at mean with step size sigma in every variable and
+        populationSize candidates per generation, or the default of
+        4 + 3 ln(n) when it is not positive. */
+    CMAES(const std::vector<double>& mean, double sigma,
+          int populationSize = 0, unsigned seed = 0);
+
+    int getNumVariables() const { return _n; }
+    int getPopulationSize() const { return _lambda; }
+    /** The number of candidates that move the mean. */
+    int getNumParents() const { return _mu; }
+    int getGeneration() const { return _generation; }
+
+    const std::vector<double>& getMean() const { return _mean; }
+    double getSigma() const { return _sigma; }
+    /** The largest standard deviation of the distribution. */
+    double getMaxStandardDeviation() const;
+
+    const std::vector<double>& getBest() const { return _best; }
+    double getBestCost() const { return _bestCost; }
+
+    /** Sample the candidates of the next generation. */
+    const std::vector<std::vector<double>>& ask();
+    /** Update the distribution with the costs of the candidates of ask(),
+        in the same order. */
+    void tell(const std::vector<double>& costs);
+
+    /** Whether the distribution has shrunk below tolX in every variable or
+        the best costs of the last generations differ by less than tolFun. */
+    bool hasConverged(double tolX, double tolFun) const;
+
+private:
+    // recompute _B and _D from _C
+    void decompose();
+
+    int _n;
+    int _lambda;
+    int _mu;
+    std::vector<double> _weights;
+    double _muEff;
+
+    // the learning rates and the damping
+    double _cSigma;
+    double _dSigma;
+    double _cc;
+    double _c1;
+    double _cMu;
+    double _chiN;
+
+    std::vector<double> _mean;
+    double _sigma;
+    // the covariance, n by n, row major, its eigenvectors (columns) and the
+    // square roots of its eigenvalues
+    std::vector<double> _C;
+    std::vector<double> _B;
+    std::vector<double> _D;
+    std::vector<double> _pSigma;
+    std::vector<double> _pc;
+
+    std::vector<std::vector<double>> _population;
+    // the normal samples of the population, before scaling by B*D
+    std::vector<std::vector<double>> _z;
+    std::mt19937 _random;
+    std::normal_distribution<double> _normal;
+    int _generation;
+
+    std::vector<double> _best;
+    double _bestCost;
+    // the best cost of each of the last generations
+    std::vector<double> _history;
+
+    //=========================================================================
+};  // END of class CMAES
+
+}; //namespace
+//=============================================================================
+//=============================================================================
+
+#endif // OPENSIM_CMAES_H_
@@ -0,0 +1,338 @@
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim:  ColumnFile.cpp                              *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+
+//=============================================================================
+// INCLUDES
+//=============================================================================
+#include "ColumnFile.h"
+#include "ResultsStream.h"
+#include "OpenSim/Common/Exception.h"
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+
+using namespace OpenSim;
+using namespace std;
+
+static const char Magic[8] = {'R', 'F', 'X', 'C', 'O', 'L', 'S', '1'};
+static const uint32_t Version = 1;
+static const uint64_t HeaderSize = 64;
+static const uint64_t ColumnAlignment = 64;
+
+static uint64_t alignUp(uint64_t n, uint64_t alignment)
+{
+    return (n + alignment - 1)/alignment*alignment;
+}
+
+// the columns are used as they are in memory
+static bool isLittleEndian()
+{
+    const uint16_t one = 1;
+    return *reinterpret_cast<const unsigned char*>(&one) == 1;
+}
+
+template <typename T>
+static void put(std::vector<char>& bytes, uint64_t offset, T value)
+{
+    memcpy(&bytes[offset], &value, sizeof(T));
+}
+
+template <typename T>
+static T get(const char* bytes, uint64_t offset)
+{
+    T value;
+    memcpy(&value, bytes + offset, sizeof(T));
+    return value;
+}
+
+
+//=============================================================================
+// WRITER
+//=============================================================================
+//_____________________________________________________________________________
+ColumnFileWriter::ColumnFileWriter(const std::string& fileName,
+                                   const std::vector<std::string>& labels,
+                                   std::uint64_t numRows) :
+    _file(fileName, ios::binary | ios::trunc),
+    _fileName(fileName),
+    _numRows(numRows)
+{
+    OPENSIM_THROW_IF(!isLittleEndian(), Exception,
+                     "Column files are written on little-endian hosts only.");
+    OPENSIM_THROW_IF(!_file, Exception,
+                     "Could not open '" + fileName + "' for writing.");
+
+    vector<string> columnLabels(1, "time");
+    columnLabels.insert(columnLabels.end(), labels.begin(), labels.end());
+    const uint32_t numColumns = (uint32_t)columnLabels.size();
+
+    uint64_t directorySize = 0;
+    for (const string& label : columnLabels)
+        directorySize += alignUp(12 + label.size(), 8);
+    const uint64_t columnSize = alignUp(numRows*sizeof(double),
+                                        ColumnAlignment);
+    uint64_t dataOffset = alignUp(HeaderSize + directorySize, ColumnAlignment);
+
+    vector<char> bytes(HeaderSize + directorySize, 0);
+    memcpy(&bytes[0], Magic, sizeof(Magic));
+    put(bytes, 8, Version);
+    put(bytes, 12, numColumns);
+    put(bytes, 16, numRows);
+    put(bytes, 24, HeaderSize);
+
+    uint64_t entry = HeaderSize;
+    for (const string& label : columnLabels) {
+        put(bytes, entry, dataOffset);
+        put(bytes, entry + 8, (uint32_t)label.size());
+        memcpy(&bytes[entry + 12], label.data(), label.size());
+        entry += alignUp(12 + label.size(), 8);
+        _dataOffsets.push_back(dataOffset);
+        dataOffset += columnSize;
+    }
+
+    _file.write(bytes.data(), bytes.size());
+    // size the file for all columns; the gaps read as zeros
+    if (dataOffset > bytes.size()) {
+        _file.seekp(dataOffset - 1);
+        _file.put(0);
+    }
+    OPENSIM_THROW_IF(!_file, Exception,
+                     "Could not write to '" + fileName + "'.");
+}
+
+void ColumnFileWriter::write(int column, std::uint64_t firstRow,
+                             const double* values, std::size_t count)
+{
+    OPENSIM_THROW_IF(column < 0 || column >= (int)_dataOffsets.size() ||
+                     firstRow + count > _numRows, Exception,
+                     "Rows out of the range of '" + _fileName + "'.");
+
+    _file.seekp(_dataOffsets[column] + firstRow*sizeof(double));
+    _file.write(reinterpret_cast<const char*>(values), count*sizeof(double));
+    OPENSIM_THROW_IF(!_file, Exception,
+                     "Could not write to '" + _fileName + "'.");
+}
+
+void ColumnFileWriter::close()
+{
+    _file.close();
+    OPENSIM_THROW_IF(!_file, Exception,
+                     "Could not complete '" + _fileName + "'.");
+}
+
+//_____________________________________________________________________________
+void OpenSim::writeColumnFile(const TimeSeriesTable& table,
+                              const std::string& fileName)
+{
+    const size_t numRows = table.getNumRows();
+    ColumnFileWriter writer(fileName, table.getColumnLabels(), numRows);
+
+    writer.write(0, 0, table.getIndependentColumn().data(), numRows);
+    vector<double> values(numRows);
+    for (size_t c = 0; c < table.getNumColumns(); ++c) {
+        const auto column = table.getDependentColumnAtIndex(c);
+        for (size_t r = 0; r < numRows; ++r)
+            values[r] = column[(int)r];
+        writer.write((int)c + 1, 0, values.data(), numRows);
+    }
+    writer.close();
+}
+
+/* The rows are counted in a first pass over the stream, which skips over
+ * the blocks, so the file can be laid out before the second pass copies
+ * the blocks into their columns.
+ */
+void OpenSim::convertResultsStream(const std::string& streamName,
+                                   const std::string& fileName)
+{
+    const uint64_t numRows = ResultsStreamReader(streamName).countRows();
+
+    ResultsStreamReader reader(streamName);
+    ColumnFileWriter writer(fileName, reader.getColumnLabels(), numRows);
+
+    vector<double> time;
+    vector<vector<double>> columns;
+    uint64_t row = 0;
+    while (row < numRows && reader.readBlock(time, columns)) {
+        writer.write(0, row, time.data(), time.size());
+        for (size_t c = 0; c < columns.size(); ++c)
+            writer.write((int)c + 1, row, columns[c].data(), time.size());
+        row += time.size();
+    }
+    writer.close();
+}
+
+
+//=============================================================================
+// READER
+//=============================================================================
+//_____________________________________________________________________________
+ColumnFile::ColumnFile(const std::string& fileName) :
+    _fileName(fileName),
+    _mapping(nullptr),
+    _mappingSize(0),
+    _numRows(0)
+{
+    OPENSIM_THROW_IF(!isLittleEndian(), Exception,
+                     "Column files are read on little-endian hosts only.");
+
+#ifdef _WIN32
+    _fileHandle = CreateFileA(fileName.c_str(), GENERIC_READ,
+                              FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    _mappingHandle = NULL;
+    OPENSIM_THROW_IF(_fileHandle == INVALID_HANDLE_VALUE, Exception,
+                     "Could not open '" + fileName + "'.");
+    LARGE_INTEGER size;
+    GetFileSizeEx(_fileHandle, &size);
+    _mappingSize = (size_t)size.QuadPart;
+    if (_mappingSize > 0) {
+        _mappingHandle = CreateFileMappingA(_fileHandle, NULL, PAGE_READONLY,
+                                            0, 0, NULL);
+        if (_mappingHandle)
+            _mapping = (const char*)MapViewOfFile(_mappingHandle,
+                                                  FILE_MAP_READ, 0, 0, 0);
+    }
+#else
+    int fd = open(fileName.c_str(), O_RDONLY);
+    OPENSIM_THROW_IF(fd < 0, Exception,
+                     "Could not open '" + fileName + "'.");
+    struct stat status;
+    if (fstat(fd, &status) == 0 && status.st_size > 0) {
+        _mappingSize = (size_t)status.st_size;
+        void* mapping = mmap(nullptr, _mappingSize, PROT_READ, MAP_SHARED,
+                             fd, 0);
+        if (mapping != MAP_FAILED)
+            _mapping = (const char*)mapping;
+    }
+    // the mapping keeps the file
+    ::close(fd);
+#endif
+
+    // release the mapping when the file turns out to be malformed
+    try {
+        OPENSIM_THROW_IF(!_mapping, Exception,
+                         "Could not map '" + fileName + "'.");
+        OPENSIM_THROW_IF(_mappingSize < HeaderSize ||
+                         memcmp(_mapping, Magic, sizeof(Magic)) != 0,
+                         Exception, "'" + fileName + "' is not a column file.");
+        OPENSIM_THROW_IF(get<uint32_t>(_mapping, 8) != Version, Exception,
+                         "'" + fileName + "' has an unknown version.");
+
+        const uint32_t numColumns = get<uint32_t>(_mapping, 12);
+        const uint64_t numRows = get<uint64_t>(_mapping, 16);
+        uint64_t entry = get<uint64_t>(_mapping, 24);
+        OPENSIM_THROW_IF(numRows > _mappingSize/sizeof(double), Exception,
+                         "'" + fileName + "' is cut short.");
+        _numRows = (size_t)numRows;
+
+        for (uint32_t c = 0; c < numColumns; ++c) {
+            OPENSIM_THROW_IF(entry > _mappingSize || _mappingSize - entry < 12,
+                             Exception, "The column directory of '" +
+                             fileName + "' is cut short.");
+            const uint64_t dataOffset = get<uint64_t>(_mapping, entry);
+            const uint32_t labelLength = get<uint32_t>(_mapping, entry + 8);
+            OPENSIM_THROW_IF(_mappingSize - entry - 12 < labelLength,
+                             Exception, "The column directory of '" +
+                             fileName + "' is cut short.");
+            OPENSIM_THROW_IF(dataOffset % sizeof(double) != 0 ||
+                             dataOffset > _mappingSize ||
+                             (_mappingSize - dataOffset)/sizeof(double) <
+                             numRows, Exception, "The columns of '" +
+                             fileName + "' are cut short.");
+
+            _labels.push_back(string(_mapping + entry + 12, labelLength));
+            _columns.push_back(
+                    reinterpret_cast<const double*>(_mapping + dataOffset));
+            entry += alignUp(12 + labelLength, 8);
+        }
+        OPENSIM_THROW_IF(_labels.empty(), Exception,
+                         "'" + fileName + "' has no time column.");
+    }
+    catch (...) {
+        unmap();
+        throw;
+    }
+}
+
+ColumnFile::~ColumnFile()
+{
+    unmap();
+}
+
+void ColumnFile::unmap()
+{
+#ifdef _WIN32
+    if (_mapping)
+        UnmapViewOfFile(_mapping);
+    if (_mappingHandle)
+        CloseHandle(_mappingHandle);
+    if (_fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(_fileHandle);
+    _fileHandle = INVALID_HANDLE_VALUE;
+    _mappingHandle = NULL;
+#else
+    if (_mapping)
+        munmap(const_cast<char*>(_mapping), _mappingSize);
+#endif
+    _mapping = nullptr;
+}
+
+//_____________________________________________________________________________
+int ColumnFile::findColumn(const std::string& label) const
+{
+    for (size_t c = 0; c < _labels.size(); ++c)
+        if (_labels[c] == label)
+            return (int)c;
+    return -1;
+}
+
+ColumnSpan ColumnFile::getColumn(int index) const
+{
+    OPENSIM_THROW_IF(index < 0 || index >= getNumColumns(), Exception,
+                     "'" + _fileName + "' has no column " +
+                     to_string(index) + ".");
+    ColumnSpan span = {_columns[index], _numRows};
+    return span;
+}
+
+ColumnSpan ColumnFile::getColumn(const std::string& label) const
+{
+    const int index = findColumn(label);
+    OPENSIM_THROW_IF(index < 0, Exception,
+                     "'" + _fileName + "' has no column '" + label + "'.");
+    return getColumn(index);
+}
@@ -0,0 +1,190 @@
+#ifndef OPENSIM_ColumnFile_H_
+#define OPENSIM_ColumnFile_H_
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim: ColumnFile.h                                 *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+//============================================================================
+// INCLUDE
+//============================================================================
+#include "OpenSim/Common/TimeSeriesTable.h"
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+
+
+namespace OpenSim {
+
+/* A column file holds a table of doubles column by column, so that a
+ * column can be used in place once the file is mapped into memory. All
+ * numbers are little endian and all offsets are from the start of the file:
+ *
+ *   offset  size
+ *   0       8    char   magic       "RFXCOLS1"
+ *   8       4    uint32 version     1
+ *   12      4    uint32 numColumns  including the time, which is column 0
+ *   16      8    uint64 numRows
+ *   24      8    uint64 directoryOffset
+ *   32      32   zero
+ *
+ *   the column directory at directoryOffset, an entry for every column:
+ *   0       8    uint64 dataOffset  a multiple of 64
+ *   8       4    uint32 labelLength
+ *   12           char   label[labelLength], zero padded to a multiple of 8
+ *
+ *   the columns, each numRows doubles from its dataOffset on
+ *
+ * Columns start on 64-byte boundaries so that a mapped column is aligned
+ * for vector loads.
+ */
+
+//=============================================================================
+//=============================================================================
+/**
+ * ColumnFileWriter lays out a column file for a known number of rows and
+ * fills its columns in any order, a run of rows at a time, so a file can be
+ * written from data that arrives row block by row block without holding it
+ * all.
+ *
+ * @author  Hjalti Hilmarsson
+ */
+class ColumnFileWriter {
+
+public:
+    /** Create fileName with a time column and a column for each of labels,
+        all numRows long and zero. */
+    ColumnFileWriter(const std::string& fileName,
+                     const std::vector<std::string>& labels,
+                     std::uint64_t numRows);
+
+    ColumnFileWriter(const ColumnFileWriter&) = delete;
+    ColumnFileWriter& operator=(const ColumnFileWriter&) = delete;
+
+    /** Write count values to column, 0 being the time, from firstRow on. */
+    void write(int column, std::uint64_t firstRow, const double* values,
+               std::size_t count);
+
+    /** Flush and close the file; throws if it could not be written. */
+    void close();
+
+private:
+    std::ofstream _file;
+    std::string _fileName;
+    std::uint64_t _numRows;
+    std::vector<std::uint64_t> _dataOffsets;
+
+    //=========================================================================
+};  // END of class ColumnFileWriter
+
+/** Write table, with its independent column as the time, to a column file. */
+void writeColumnFile(const TimeSeriesTable& table, const std::string& fileName);
+
+/** Convert a results stream (see ResultsStreamWriter) to a column file,
+    reading it one block at a time. */
+void convertResultsStream(const std::string& streamName,
+                          const std::string& fileName);
+
+//=============================================================================
+//=============================================================================
+/**
+ * A run of doubles that a ColumnFile owns.
+ */
+struct ColumnSpan {
+    const double* data;
+    std::size_t size;
+
+    const double* begin() const { return data; }
+    const double* end() const { return data + size; }
+    double operator[](std::size_t i) const { return data[i]; }
+};
+
+//=============================================================================
+//=============================================================================
+/**
+ * ColumnFile maps a column file into memory and hands out its columns
+ * where they lie in the mapping. Nothing is read until a column is used, and
+ * then only the pages of that column, so picking a few columns out of a
+ * wide file costs little more than the columns themselves.
+ *
+ * The spans stay valid for as long as the ColumnFile.
+ *
+ * @code
+ * ColumnFile results("tugOfWar_results.rxc");
+ * ColumnSpan time = results.getTime();
+ * ColumnSpan force = results.getColumn("/forceset/original1|tendon_force");
+ * @endcode
+ *
+ * @author  Hjalti Hilmarsson
+ */
+class ColumnFile {
+
+public:
+    /** Map fileName. Throws if it is not a column file. */
+    explicit ColumnFile(const std::string& fileName);
+    ~ColumnFile();
+
+    ColumnFile(const ColumnFile&) = delete;
+    ColumnFile& operator=(const ColumnFile&) = delete;
+
+    std::size_t getNumRows() const { return _numRows; }
+    /** The number of columns, including the time. */
+    int getNumColumns() const { return (int)_labels.size(); }
+    /** The labels of the columns; the first is "time". */
+    const std::vector<std::string>& getColumnLabels() const
+    {   return _labels; }
+
+    /** The index of the column labeled label, or -1. */
+    int findColumn(const std::string& label) const;
+
+    ColumnSpan getColumn(int index) const;
+    /** Throws if there is no column labeled label. */
+    ColumnSpan getColumn(const std::string& label) const;
+    ColumnSpan getTime() const { return getColumn(0); }
+
+private:
+    // release the mapping and the file
+    void unmap();
+
+    std::string _fileName;
+    const char* _mapping;
+    std::size_t _mappingSize;
+#ifdef _WIN32
+    void* _fileHandle;
+    void* _mappingHandle;
+#endif
+
+    std::size_t _numRows;
+    std::vector<std::string> _labels;
+    std::vector<const double*> _columns;
+
+    //=========================================================================
+};  // END of class ColumnFile
+
+}; //namespace
+//=============================================================================
+//=============================================================================
+
+#endif // OPENSIM_ColumnFile_H_
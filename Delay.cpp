@@ -85,28 +85,73 @@ Delay::Delay(const std::string& name,
  */
 void Delay::constructProperties()
 {
+    constructProperty_delay(0.0);
+    constructProperty_history_resolution(1.0e-4);
+    constructProperty_record_accepted_steps_only(true);
+    constructProperty_delay_mode("history");
+    constructProperty_pade_order(4);
     
+    _padeMode = false;
+    signalChannel = -1;
+    _recordAcceptedStepsOnly = true;
 }
 
-void Delay::addToSystem(SimTK::MultibodySystem& system) const
+void Delay::extendAddToSystem(SimTK::MultibodySystem& system) const
 {
-    Super::addToSystem(system);
-    Delay* mutableThis = const_cast<Delay *>(this);
+    Super::extendAddToSystem(system);
     
+    // the Pade delay filter integrates with the rest of the system
+    for (const std::string& name : signalStateNames)
+        addStateVariable(name);
 }
 
 
 void Delay::extendConnectToModel(Model &model)
 {
     Super::extendConnectToModel(model);
-    muscleHistory.setSize(0);
-    muscleHistory.setMemoryOwner(true);
     
-    const Muscle& musc = getMuscle();
+    OPENSIM_THROW_IF_FRMOBJ(get_delay() < 0, Exception,
+                            "Expected delay to be non-negative.");
+    OPENSIM_THROW_IF_FRMOBJ(get_history_resolution() <= 0, Exception,
+                            "Expected history_resolution to be positive.");
+    OPENSIM_THROW_IF_FRMOBJ(
+            get_delay_mode() != "history" && get_delay_mode() != "pade",
+            Exception, "Expected delay_mode to be 'history' or 'pade', "
+            "but got '" + get_delay_mode() + "'.");
+    OPENSIM_THROW_IF_FRMOBJ(
+            get_pade_order() < 1 || get_pade_order() > PadeDelay::MaxOrder,
+            Exception, "Expected pade_order to be between 1 and " +
+            std::to_string(PadeDelay::MaxOrder) + ".");
     
-    PiecewiseLinearFunction muscleSignal;
-    muscleSignal.setName(musc.getName());
-    muscleHistory.cloneAndAppend(muscleSignal);
+    // cache what the signal needs so evaluating it does no lookups
+    _signalInput = &getInput<double>("signal");
+    _recordAcceptedStepsOnly = get_record_accepted_steps_only();
+    
+    _padeMode = get_delay_mode() == "pade";
+    signalStateNames.clear();
+    
+    if (_padeMode) {
+        signalPade.setDelay(get_delay(), get_pade_order());
+        for (int i = 0; i < signalPade.getNumStates(); ++i)
+            signalStateNames.push_back("signal_delay_" + std::to_string(i));
+    }
+    
+    // record in the model's DelayBank if it has one
+    _bank.clear();
+    if (!_padeMode && get_record_accepted_steps_only()) {
+        if (DelayBank* bank = DelayBank::findInModel(model)) {
+            signalChannel = bank->addChannel(*this, "signal", get_delay(),
+                [this](const SimTK::State& s) {
+                    return _signalInput->getValue(s); });
+            _bank = bank;
+        }
+    }
+    
+    if (!_padeMode && _bank.empty()) {
+        // size the history for the delay so nothing is allocated while simulating
+        muscleHistory.updPrototype().allocate(get_delay(),
+                                              get_history_resolution());
+    }
     
 }
 
@@ -123,6 +168,66 @@ const Muscle& Delay::getMuscle() const
 }
 
 
+//=============================================================================
+// SIMULATION
+//=============================================================================
+void Delay::extendInitStateFromProperties(SimTK::State& s) const
+{
+    Super::extendInitStateFromProperties(s);
+    
+    // the update value is reset too, so no stale push is replayed into it
+    if (!_padeMode && _bank.empty())
+        muscleHistory.reset(s, get_delay());
+}
+
+/* The Manager realizes the Report stage once for every accepted step, so
+ * recording here keeps integrator trial stages and rejected steps out of the
+ * history.
+ */
+void Delay::extendRealizeReport(const SimTK::State& s) const
+{
+    Super::extendRealizeReport(s);
+    
+    if (!_padeMode && _bank.empty() && _recordAcceptedStepsOnly)
+        muscleHistory.record(s, s.getTime(), _signalInput->getValue(s));
+}
+
+/* In Pade mode the delayed signal is the output of a linear filter driven by
+ * the undelayed one. The filter states start at zero.
+ */
+void Delay::computeStateVariableDerivatives(const SimTK::State& s) const
+{
+    if (!_padeMode)
+        return;
+    
+    double x[PadeDelay::MaxOrder];
+    double xdot[PadeDelay::MaxOrder];
+    
+    getPadeStates(s, x);
+    signalPade.calcDerivatives(x, _signalInput->getValue(s), xdot);
+    for (size_t i = 0; i < signalStates.size(); ++i)
+        signalStates[i]->setDerivative(s, xdot[i]);
+}
+
+void Delay::getPadeStates(const SimTK::State& s, double* x) const
+{
+    for (size_t i = 0; i < signalStates.size(); ++i)
+        x[i] = signalStates[i]->getValue(s);
+}
+
+void Delay::extendRealizeTopology(SimTK::State& s) const
+{
+    Super::extendRealizeTopology(s);
+    
+    // every State gets its own delay history
+    if (!_padeMode && _bank.empty())
+        muscleHistory.allocate(getSystem().getDefaultSubsystem(), s);
+    
+    signalStates.clear();
+    for (const std::string& name : signalStateNames)
+        signalStates.push_back(traverseToStateVariable(name));
+}
+
 //=============================================================================
 // SIGNALS
 //=============================================================================
@@ -135,23 +240,42 @@ const Muscle& Delay::getMuscle() const
 
 double Delay::getSignal(const SimTK::State& s) const
 {
-    double signal = getInputValue<double>(s, "signal");
+    double signal = _signalInput->getValue(s);
     double time = s.getTime();
     double delaySignal = 0;
     
-    const Muscle& musc = getMuscle();
-    
-    muscleHistory.get(musc.getName()).addPoint(time, signal);
-    
-    if((time - get_delay()) < muscleHistory.get(musc.getName()).getXValues()[0])
-    {
-        delaySignal = 0;
+    if (_padeMode) {
+        double x[PadeDelay::MaxOrder];
+        getPadeStates(s, x);
+        delaySignal = signalPade.calcOutput(x, signal);
+    }
+    else if (!_bank.empty()) {
+        delaySignal = _bank->getDelayedValue(s, signalChannel, signal);
+    }
+    else if (_recordAcceptedStepsOnly) {
+        // the current sample stays pending until the step is accepted
+        delaySignal = muscleHistory.getValue(s).getDelayedValue(time, signal);
     }
-    else
-    {
-        delaySignal = muscleHistory.get(musc.getName()).calcValue(SimTK::Vector(1,time-get_delay()));
+    else {
+        muscleHistory.record(s, time, signal);
+        // zero until the history reaches back a full delay
+        delaySignal = muscleHistory.getRecordedValue(s).getDelayedValue(time);
     }
     
     return delaySignal;
 }
 
+//=============================================================================
+// CHECKPOINTS
+//=============================================================================
+void Delay::writeCheckpoint(std::ostream& out, const SimTK::State& s) const
+{
+    if (!_padeMode && _bank.empty())
+        muscleHistory.write(out, s);
+}
+
+void Delay::readCheckpoint(std::istream& in, SimTK::State& s) const
+{
+    if (!_padeMode && _bank.empty())
+        muscleHistory.read(in, s);
+}
@@ -30,7 +30,9 @@
 #include "osimDelayDLL.h"
 #include "OpenSim/Simulation/Control/Controller.h"
 #include "OpenSim/Simulation/Model/Muscle.h"
-#include "OpenSim/Common/PiecewiseLinearFunction.h"
+#include "DelayLineVariable.h"
+#include "PadeDelay.h"
+#include "DelayBank.h"
 #include "OpenSim/Simulation/Model/Model.h"
 
 
@@ -62,6 +64,10 @@ public:
 // PROPERTIES
 //=============================================================================
     OpenSim_DECLARE_PROPERTY(delay, double, "The time delay (seconds) between the muscle stretch and the stretch reflex signal");
+    OpenSim_DECLARE_PROPERTY(history_resolution, double, "The minimum time (seconds) between samples kept in the delay history");
+    OpenSim_DECLARE_PROPERTY(record_accepted_steps_only, bool, "Record the delay history only at accepted integration steps (when the Report stage is realized) instead of at every evaluation");
+    OpenSim_DECLARE_PROPERTY(delay_mode, std::string, "How the delay is computed: 'history' interpolates the recorded signal, 'pade' integrates a Pade approximation of the delay as continuous states");
+    OpenSim_DECLARE_PROPERTY(pade_order, int, "The order (number of states) of the Pade approximation used when delay_mode is 'pade'");
     
 //==============================================================================
 // SOCKETS
@@ -106,6 +112,15 @@ public:
     Get quanitites of interest common to all spindles*/
     void setSignal(SimTK::State& s, double delaySignal) const;
     double getSignal(const SimTK::State& s) const;
+
+//--------------------------------------------------------------------------
+// CHECKPOINTS
+//--------------------------------------------------------------------------
+    /** Write what this delay keeps in s besides its continuous states: its delay history.
+        Used by StateCheckpoint. */
+    void writeCheckpoint(std::ostream& out, const SimTK::State& s) const;
+    /** Read what writeCheckpoint() wrote into s. */
+    void readCheckpoint(std::istream& in, SimTK::State& s) const;
         
 
 private:
@@ -114,9 +129,34 @@ private:
     // ModelComponent interface to connect this component to its model
     void extendConnectToModel(Model& aModel) override;
     // ModelComponent interface to add computational elemetns to the SimTK system
-    void addToSystem(SimTK::MultibodySystem& system) const;
+    void extendAddToSystem(SimTK::MultibodySystem& system) const override;
+    // integrate the Pade delay states
+    void computeStateVariableDerivatives(const SimTK::State& s) const override;
+    // clear the delay history for a new simulation
+    void extendInitStateFromProperties(SimTK::State& s) const override;
+    // commit the current sample to the delay history at accepted steps
+    void extendRealizeReport(const SimTK::State& s) const override;
+    // read the Pade delay filter states
+    void getPadeStates(const SimTK::State& s, double* x) const;
+    // look up the Pade delay state variables once the system is built
+    void extendRealizeTopology(SimTK::State& s) const override;
+    
+    // the delay history, kept in the State
+    mutable DelayLineVariable muscleHistory;
+    
+    // Pade delay filter and the names of its state variables
+    bool _padeMode;
+    PadeDelay signalPade;
+    std::vector<std::string> signalStateNames;
+    mutable std::vector<const StateVariable*> signalStates;
+    
+    // the model's DelayBank and the channel of the signal, when it is used
+    SimTK::ReferencePtr<const DelayBank> _bank;
+    int signalChannel;
     
-    mutable OpenSim::Set<PiecewiseLinearFunction> muscleHistory;
+    // the signal input and the settings read on every evaluation
+    SimTK::ReferencePtr<const Input<double>> _signalInput;
+    bool _recordAcceptedStepsOnly;
 
     
 protected:
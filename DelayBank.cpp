@@ -0,0 +1,472 @@
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim:  DelayBank.cpp                               *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+
+//=============================================================================
+// INCLUDES
+//=============================================================================
+#include "DelayBank.h"
+#include <OpenSim/OpenSim.h>
+#include <algorithm>
+#include <cmath>
+
+
+
+// This allows us to use OpenSim functions, classes, etc., without having to
+// prefix the names of those things with "OpenSim::".
+using namespace OpenSim;
+using namespace std;
+using namespace SimTK;
+
+
+//=============================================================================
+// KERNELS
+//=============================================================================
+/* out = a + w*(b - a) over n contiguous channels. Written without aliasing
+ * or branches so that it compiles to packed SIMD instructions. */
+static void interpolateRows(const double* __restrict a,
+                            const double* __restrict b,
+                            double w,
+                            double* __restrict out,
+                            int n)
+{
+    for (int i = 0; i < n; ++i)
+        out[i] = a[i] + w*(b[i] - a[i]);
+}
+
+
+//=============================================================================
+// CONSTRUCTOR(S) AND DESTRUCTOR
+//=============================================================================
+//_____________________________________________________________________________
+/* Default constructor. */
+DelayBank::DelayBank()
+{
+    constructProperties();
+    setName("delay_bank");
+}
+
+//=============================================================================
+// SETUP PROPERTIES
+//=============================================================================
+void DelayBank::constructProperties()
+{
+    constructProperty_history_resolution(1.0e-4);
+}
+
+void DelayBank::extendFinalizeFromProperties()
+{
+    Super::extendFinalizeFromProperties();
+
+    OPENSIM_THROW_IF_FRMOBJ(get_history_resolution() <= 0, Exception,
+                            "Expected history_resolution to be positive.");
+
+    // the owners register again when they connect
+    _channels.clear();
+    _channelIndex.clear();
+}
+
+/* The lookups depend on the time and on the committed rows, which
+ * invalidate Position when they change.
+ */
+void DelayBank::extendAddToSystem(SimTK::MultibodySystem& system) const
+{
+    Super::extendAddToSystem(system);
+
+    _lookupCV = addCacheVariable("lookup", Lookup(), SimTK::Stage::Position);
+}
+
+/* Lay out the columns so that channels with equal delays are adjacent and
+ * size the rows for the longest delay. Apart from the newest row, the rows
+ * are at least history_resolution apart, as in DelayLine.
+ */
+void DelayBank::extendRealizeTopology(SimTK::State& s) const
+{
+    Super::extendRealizeTopology(s);
+
+    int nc = getNumChannels();
+
+    _columnChannels.resize(nc);
+    for (int i = 0; i < nc; ++i)
+        _columnChannels[i] = i;
+    stable_sort(_columnChannels.begin(), _columnChannels.end(),
+                [this](int a, int b) {
+                    return _channels[a].delay < _channels[b].delay; });
+
+    _columns.resize(nc);
+    _channelGroups.resize(nc);
+    _groups.clear();
+    double maxDelay = 0;
+    for (int c = 0; c < nc; ++c) {
+        int i = _columnChannels[c];
+        double delay = _channels[i].delay;
+        if (_groups.empty() || _groups.back().delay != delay) {
+            Group group;
+            group.delay = delay;
+            group.begin = c;
+            group.end = c;
+            _groups.push_back(group);
+        }
+        _groups.back().end = c + 1;
+        _columns[i] = c;
+        _channelGroups[i] = static_cast<int>(_groups.size()) - 1;
+        maxDelay = max(maxDelay, delay);
+    }
+
+    int capacity = 3 + static_cast<int>(
+            ceil(maxDelay/get_history_resolution()));
+    History history;
+    history.times.assign(capacity, 0.0);
+    history.values.assign(size_t(capacity)*nc, 0.0);
+    history.head = 0;
+    history.size = 0;
+    history.version = 0;
+    history.replayable = false;
+    history.lastTime = 0;
+    history.lastRow.assign(nc, 0.0);
+
+    // every State gets its own rows
+    _historyIndex = getSystem().getDefaultSubsystem()
+            .allocateAutoUpdateDiscreteVariable(s, Stage::Position,
+                new Value<History>(history), Stage::Position);
+}
+
+//=============================================================================
+// CHANNELS
+//=============================================================================
+int DelayBank::addChannel(const Component& owner, const std::string& name,
+                          double delay, const Source& source)
+{
+    Channel channel;
+    channel.key = owner.getAbsolutePathString() + "/" + name;
+    channel.delay = delay > 0 ? delay : 0;
+    channel.source = source;
+
+    auto inserted = _channelIndex.insert(
+            std::make_pair(channel.key, getNumChannels()));
+    if (!inserted.second) {
+        _channels[inserted.first->second] = channel;
+        return inserted.first->second;
+    }
+    _channels.push_back(channel);
+    return getNumChannels() - 1;
+}
+
+/* Looking the bank up by its path visits the model's own components only,
+ * rather than every component of the model. */
+DelayBank* DelayBank::findInModel(Model& model)
+{
+    static const std::string path = "delay_bank";
+    if (!model.hasComponent<DelayBank>(path))
+        return nullptr;
+    return &model.updComponent<DelayBank>(path);
+}
+
+//=============================================================================
+// SIMULATION
+//=============================================================================
+/* As in readCheckpoint(), the update value is overwritten too, so no push
+ * recorded in s before is replayed into the emptied history.
+ */
+void DelayBank::extendInitStateFromProperties(SimTK::State& s) const
+{
+    Super::extendInitStateFromProperties(s);
+
+    const Subsystem& subsystem = getSystem().getDefaultSubsystem();
+    History& history = Value<History>::updDowncast(
+            subsystem.updDiscreteVariable(s, _historyIndex)).upd();
+    history.head = 0;
+    history.size = 0;
+    ++history.version;
+    history.replayable = false;
+
+    Value<History>::updDowncast(
+            subsystem.updDiscreteVarUpdateValue(s, _historyIndex)).upd() =
+            history;
+}
+
+/* The Manager realizes the Report stage once for every accepted step, so all
+ * channels are sampled together here, in one row. The row goes to the update
+ * value of the rows, which holds the rows of the previous step until it is
+ * brought up to date.
+ */
+void DelayBank::extendRealizeReport(const SimTK::State& s) const
+{
+    Super::extendRealizeReport(s);
+
+    int nc = getNumChannels();
+    if (nc == 0)
+        return;
+
+    const Subsystem& subsystem = getSystem().getDefaultSubsystem();
+    History& next = Value<History>::updDowncast(
+            subsystem.updDiscreteVarUpdateValue(s, _historyIndex)).upd();
+    if (!subsystem.isDiscreteVarUpdateValueRealized(s, _historyIndex))
+        catchUp(next, getHistory(s));
+
+    for (int c = 0; c < nc; ++c)
+        next.lastRow[c] = _channels[_columnChannels[c]].source(s);
+    push(next, s.getTime());
+    subsystem.markDiscreteVarUpdateValueRealized(s, _historyIndex);
+}
+
+const DelayBank::History& DelayBank::getHistory(const SimTK::State& s) const
+{
+    return Value<History>::downcast(getSystem().getDefaultSubsystem()
+            .getDiscreteVariable(s, _historyIndex)).get();
+}
+
+int DelayBank::getNumSamples(const SimTK::State& s) const
+{
+    return getHistory(s).size;
+}
+
+int DelayBank::row(const History& h, int i) const
+{
+    int j = h.head + i;
+    int capacity = static_cast<int>(h.times.size());
+    return j < capacity ? j : j - capacity;
+}
+
+int DelayBank::countBefore(const History& h, double time) const
+{
+    int lo = 0;
+    int hi = h.size;
+    while (lo < hi) {
+        int mid = (lo + hi)/2;
+        if (h.times[row(h, mid)] < time)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+void DelayBank::push(History& h, double time) const
+{
+    ++h.version;
+    h.replayable = true;
+    h.lastTime = time;
+
+    int capacity = static_cast<int>(h.times.size());
+    if (capacity == 0)
+        return;
+
+    double resolution = get_history_resolution();
+    double maxDelay = _groups.empty() ? 0 : _groups.back().delay;
+
+    // rewind past any row that is not older than the new one
+    h.size = countBefore(h, time);
+
+    // merge into the newest row while it is closer than the resolution to
+    // the one before it
+    if (h.size > 1 &&
+            h.times[row(h, h.size-1)] - h.times[row(h, h.size-2)] < resolution)
+        --h.size;
+
+    // keep a single row at or before the start of the longest window
+    while (h.size > 1 && h.times[row(h, 1)] <= time - maxDelay) {
+        h.head = row(h, 1);
+        --h.size;
+    }
+
+    if (h.size == capacity) {
+        h.head = row(h, 1);
+        --h.size;
+    }
+
+    int nc = getNumChannels();
+    int r = row(h, h.size);
+    h.times[r] = time;
+    copy(h.lastRow.begin(), h.lastRow.end(), h.values.begin() + size_t(r)*nc);
+    ++h.size;
+}
+
+/* Replaying the last push of newer costs one row; copying all of them is
+ * only needed when older is further behind.
+ */
+void DelayBank::catchUp(History& older, const History& newer) const
+{
+    if (newer.version == older.version)
+        return;
+
+    if (newer.replayable && newer.version == older.version + 1 &&
+            newer.times.size() == older.times.size()) {
+        older.lastRow = newer.lastRow;
+        push(older, newer.lastTime);
+        return;
+    }
+
+    older = newer;
+}
+
+//=============================================================================
+// SIGNALS
+//=============================================================================
+/* One binary search per group of equal delays, then one vectorized pass over
+ * the columns of the group. Groups whose delayed time falls after the newest
+ * stored row need the pending values and are finished per channel in
+ * getDelayedValue().
+ */
+void DelayBank::calcDelayedValues(const History& h, double time,
+                                  Lookup& lookup) const
+{
+    int nc = getNumChannels();
+    int n = countBefore(h, time);
+
+    lookup.delayed.resize(nc);
+    lookup.groups.resize(_groups.size());
+
+    for (size_t g = 0; g < _groups.size(); ++g) {
+        const Group& group = _groups[g];
+        Resolution& resolution = lookup.groups[g];
+        double delayedTime = time - group.delay;
+        resolution.last = -1;
+        resolution.w = 1;
+
+        if (n == 0) {
+            resolution.kind = delayedTime < time ? Resolution::Zero
+                                                 : Resolution::Pending;
+            continue;
+        }
+        if (delayedTime < h.times[h.head]) {
+            resolution.kind = Resolution::Zero;
+            continue;
+        }
+
+        int last = row(h, n-1);
+        if (delayedTime >= h.times[last]) {
+            resolution.kind = Resolution::Pending;
+            resolution.last = last;
+            resolution.w = (delayedTime - h.times[last])/(time - h.times[last]);
+            continue;
+        }
+
+        // find the rows [lo, hi] with times[lo] <= delayedTime < times[hi]
+        int lo = 0;
+        int hi = n - 1;
+        while (hi - lo > 1) {
+            int mid = (lo + hi)/2;
+            if (h.times[row(h, mid)] <= delayedTime)
+                lo = mid;
+            else
+                hi = mid;
+        }
+        int i = row(h, lo);
+        int j = row(h, hi);
+        double w = (delayedTime - h.times[i])/(h.times[j] - h.times[i]);
+
+        interpolateRows(&h.values[size_t(i)*nc + group.begin],
+                        &h.values[size_t(j)*nc + group.begin],
+                        w,
+                        &lookup.delayed[group.begin],
+                        group.end - group.begin);
+        resolution.kind = Resolution::Interpolated;
+    }
+}
+
+double DelayBank::getDelayedValue(const SimTK::State& s, int channel,
+                                  double value) const
+{
+    const History& history = getHistory(s);
+    if (!isCacheVariableValid(s, _lookupCV)) {
+        calcDelayedValues(history, s.getTime(),
+                          updCacheVariableValue(s, _lookupCV));
+        markCacheVariableValid(s, _lookupCV);
+    }
+    const Lookup& lookup = getCacheVariableValue(s, _lookupCV);
+
+    const Resolution& resolution = lookup.groups[_channelGroups[channel]];
+    int column = _columns[channel];
+
+    switch (resolution.kind) {
+    case Resolution::Interpolated:
+        return lookup.delayed[column];
+    case Resolution::Pending: {
+        if (resolution.last < 0)
+            return value;
+        double newest = history.values[
+                size_t(resolution.last)*getNumChannels() + column];
+        return newest + resolution.w*(value - newest);
+    }
+    default:
+        return 0;
+    }
+}
+
+//=============================================================================
+// CHECKPOINTS
+//=============================================================================
+/* The rows are written oldest first, with the columns in storage order. */
+void DelayBank::writeCheckpoint(std::ostream& out, const SimTK::State& s) const
+{
+    const Subsystem& subsystem = getSystem().getDefaultSubsystem();
+    const History& h = subsystem.isDiscreteVarUpdateValueRealized(s, _historyIndex)
+        ? Value<History>::downcast(
+                subsystem.getDiscreteVarUpdateValue(s, _historyIndex)).get()
+        : getHistory(s);
+
+    size_t nc = _columnChannels.size();
+    out << nc << " " << h.size;
+    for (int i = 0; i < h.size; ++i) {
+        int r = row(h, i);
+        out << " " << h.times[r];
+        for (size_t c = 0; c < nc; ++c)
+            out << " " << h.values[r*nc + c];
+    }
+    out << "\n";
+}
+
+/* As in DelayLineVariable::read(), the update value is overwritten too, so
+ * nothing recorded in s before is committed afterwards.
+ */
+void DelayBank::readCheckpoint(std::istream& in, SimTK::State& s) const
+{
+    const Subsystem& subsystem = getSystem().getDefaultSubsystem();
+    History& h = Value<History>::updDowncast(
+            subsystem.updDiscreteVariable(s, _historyIndex)).upd();
+
+    size_t nc;
+    int size;
+    OPENSIM_THROW_IF_FRMOBJ(!(in >> nc >> size) || size < 0, Exception,
+                            "Malformed checkpoint.");
+    OPENSIM_THROW_IF_FRMOBJ(nc != _columnChannels.size() ||
+            size > static_cast<int>(h.times.size()), Exception,
+            "The checkpoint does not fit this bank's channels and capacity.");
+
+    for (int r = 0; r < size; ++r) {
+        OPENSIM_THROW_IF_FRMOBJ(!(in >> h.times[r]), Exception,
+                                "Malformed checkpoint.");
+        for (size_t c = 0; c < nc; ++c)
+            OPENSIM_THROW_IF_FRMOBJ(!(in >> h.values[r*nc + c]), Exception,
+                                    "Malformed checkpoint.");
+    }
+    h.head = 0;
+    h.size = size;
+    ++h.version;
+    h.replayable = false;
+
+    Value<History>::updDowncast(
+            subsystem.updDiscreteVarUpdateValue(s, _historyIndex)).upd() = h;
+}
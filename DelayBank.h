@@ -0,0 +1,223 @@
+#ifndef OPENSIM_DelayBank_H_
+#define OPENSIM_DelayBank_H_
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim: DelayBank.h                                  *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+//============================================================================
+// INCLUDE
+//============================================================================
+#include "osimDelayBankDLL.h"
+#include "OpenSim/Simulation/Model/ModelComponent.h"
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+
+namespace OpenSim {
+
+//=============================================================================
+//=============================================================================
+/**
+ * DelayBank holds the delay histories of all proprioceptor signals of a model
+ * in one place. When a model contains a DelayBank named delay_bank, the
+ * default name, among its own components, every SimpleSpindle, GolgiTendon
+ * and Delay in history mode finds it by that path and registers its signals
+ * with it as channels in extendConnectToModel instead of keeping its own
+ * DelayLine.
+ *
+ * The samples are stored structure-of-arrays: one ring of times shared by all
+ * channels and, for every time, a contiguous row with the value of each
+ * channel. At each accepted step (Report stage) the bank evaluates all channel
+ * sources and records one row. The rows live in each SimTK::State, as an
+ * auto-update discrete variable committed when the integrator starts its
+ * next step (see DelayLineVariable), so one model can run simulations on
+ * many States at once. Delayed queries are answered for all channels
+ * at once: channels with equal delays are stored next to each other, so one
+ * search over the times is shared by the group and the interpolation runs as
+ * a single loop over contiguous memory that the compiler vectorizes.
+ *
+ * @author  Hjalti Hilmarsson
+ */
+class OSIMDELAYBANK_API DelayBank : public ModelComponent {
+OpenSim_DECLARE_CONCRETE_OBJECT(DelayBank, ModelComponent);
+
+public:
+//=============================================================================
+// PROPERTIES
+//=============================================================================
+    OpenSim_DECLARE_PROPERTY(history_resolution, double,
+                            "The minimum time (seconds) between samples kept in the delay history");
+
+    /** The undelayed value of a channel in the given state. */
+    typedef std::function<double(const SimTK::State&)> Source;
+
+//=============================================================================
+// METHODS
+//=============================================================================
+    //--------------------------------------------------------------------------
+    // CONSTRUCTION AND DESTRUCTION
+    //--------------------------------------------------------------------------
+    /** Default constructor. */
+    DelayBank();
+
+    // Uses default (compiler-generated) destructor, copy constructor and copy
+    // assignment operator.
+
+//--------------------------------------------------------------------------
+// CHANNELS
+//--------------------------------------------------------------------------
+    /** Register the signal called name of the component owner, delayed by
+        delay seconds, and return its channel index. Registering the same
+        signal again updates it and returns the same index. Channels are
+        cleared when the model is finalized, so owners register in
+        extendConnectToModel. */
+    int addChannel(const Component& owner, const std::string& name,
+                   double delay, const Source& source);
+
+    int getNumChannels() const { return static_cast<int>(_channels.size()); }
+
+    /** The DelayBank of model: the component delay_bank of the model, found
+        by its path, or nullptr if the model has none. */
+    static DelayBank* findInModel(Model& model);
+
+//--------------------------------------------------------------------------
+// SIGNALS
+//--------------------------------------------------------------------------
+    /** The value of channel at (time - delay), where value is the channel's
+        undelayed value in s. The current value is pending until the step is
+        accepted, as in DelayLine::getDelayedValue(time, value). */
+    double getDelayedValue(const SimTK::State& s, int channel,
+                           double value) const;
+
+    /** The number of rows committed in s. */
+    int getNumSamples(const SimTK::State& s) const;
+
+//--------------------------------------------------------------------------
+// CHECKPOINTS
+//--------------------------------------------------------------------------
+    /** Write what this bank keeps in s besides its continuous states: the rows recorded in s.
+        Used by StateCheckpoint. */
+    void writeCheckpoint(std::ostream& out, const SimTK::State& s) const;
+    /** Read what writeCheckpoint() wrote into s. */
+    void readCheckpoint(std::istream& in, SimTK::State& s) const;
+
+private:
+    // Connect properties to local pointers.  */
+    void constructProperties();
+    // forget the channels of a previous connection
+    void extendFinalizeFromProperties() override;
+    // add the cache of the delayed lookups
+    void extendAddToSystem(SimTK::MultibodySystem& system) const override;
+    // lay out the columns and allocate the rows once all channels are
+    // registered
+    void extendRealizeTopology(SimTK::State& s) const override;
+    // clear the history for a new simulation
+    void extendInitStateFromProperties(SimTK::State& s) const override;
+    // record one row with all channels at accepted steps
+    void extendRealizeReport(const SimTK::State& s) const override;
+
+    struct Channel {
+        std::string key;
+        double delay;
+        Source source;
+    };
+
+    struct Group {
+        double delay;
+        int begin;
+        int end;
+    };
+
+    // the rows of one State. The last row pushed is kept so that an older
+    // version can be brought up to date by replaying it, as in
+    // DelayLine::catchUp().
+    struct History {
+        std::vector<double> times;
+        std::vector<double> values;
+        int head;
+        int size;
+        long long version;
+        bool replayable;
+        double lastTime;
+        std::vector<double> lastRow;
+    };
+
+    // how getDelayedValue resolves each group at the lookup time: zero, the
+    // interpolated value, or between row last and the pending value with
+    // weight w
+    struct Resolution {
+        enum Kind { Zero, Interpolated, Pending } kind;
+        int last;
+        double w;
+    };
+
+    // the delayed values of all columns at the time of one State
+    struct Lookup {
+        std::vector<double> delayed;
+        std::vector<Resolution> groups;
+    };
+
+    // physical row of the i-th oldest sample
+    int row(const History& h, int i) const;
+    // number of stored rows older than time
+    int countBefore(const History& h, double time) const;
+    // push h.lastRow at time
+    void push(History& h, double time) const;
+    // bring older up to date with newer
+    void catchUp(History& older, const History& newer) const;
+    // the rows committed in s
+    const History& getHistory(const SimTK::State& s) const;
+    // interpolate all channels at time
+    void calcDelayedValues(const History& h, double time,
+                           Lookup& lookup) const;
+
+    //=============================================================================
+    // Private Members
+    //=============================================================================
+    std::vector<Channel> _channels;
+    // the channel of each key
+    std::unordered_map<std::string, int> _channelIndex;
+    // column in the rows and group of equal delays of each channel, and the
+    // channel stored in each column
+    mutable std::vector<int> _columns;
+    mutable std::vector<int> _channelGroups;
+    mutable std::vector<int> _columnChannels;
+    mutable std::vector<Group> _groups;
+
+    // the rows, kept in the State, and the lookups at its time
+    mutable SimTK::DiscreteVariableIndex _historyIndex;
+    mutable CacheVariable<Lookup> _lookupCV;
+
+    //=========================================================================
+};  // END of class DelayBank
+
+}; //namespace
+//=============================================================================
+//=============================================================================
+
+#endif // OPENSIM_DelayBank_H_
+
+
@@ -0,0 +1,288 @@
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim:  DelayLine.cpp                               *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+
+//=============================================================================
+// INCLUDES
+//=============================================================================
+#include "DelayLine.h"
+#include <cmath>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+
+
+
+using namespace OpenSim;
+using namespace std;
+
+
+//=============================================================================
+// CONSTRUCTOR(S)
+//=============================================================================
+//_____________________________________________________________________________
+/* Default constructor. */
+DelayLine::DelayLine() :
+    _delay(0), _resolution(0), _interval(0), _head(0), _size(0),
+    _version(0), _replayable(false), _lastTime(0), _lastValue(0)
+{
+}
+
+/* Allocate the ring buffer.
+ *
+ * Apart from the newest sample, the stored samples are at least resolution
+ * apart, so the window (time - delay, time] holds at most delay/resolution + 2
+ * of them. One more sample at or before (time - delay) is kept to interpolate
+ * from.
+ */
+void DelayLine::allocate(double delay, double resolution)
+{
+    _delay = delay > 0 ? delay : 0;
+    _resolution = resolution > 0 ? resolution : 0;
+
+    int capacity = 3;
+    if (_resolution > 0)
+        capacity += static_cast<int>(ceil(_delay/_resolution));
+
+    _times.assign(capacity, 0.0);
+    _values.assign(capacity, 0.0);
+    _interval = 0;
+    clear();
+}
+
+/* Samples pushed every interval seconds are never merged as long as the
+ * resolution is below the interval, whatever the rounding of their times.
+ */
+void DelayLine::allocateUniform(double delay, double interval)
+{
+    allocate(delay, 0.5*interval);
+    _interval = interval > 0 ? interval : 0;
+}
+
+void DelayLine::clear()
+{
+    _head = 0;
+    _size = 0;
+    ++_version;
+    _replayable = false;
+}
+
+//=============================================================================
+// SAMPLES
+//=============================================================================
+int DelayLine::index(int i) const
+{
+    int j = _head + i;
+    int capacity = getCapacity();
+    return j < capacity ? j : j - capacity;
+}
+
+void DelayLine::popOldest()
+{
+    _head = index(1);
+    --_size;
+}
+
+void DelayLine::popNewest()
+{
+    --_size;
+}
+
+double DelayLine::getOldestTime() const { return _times[_head]; }
+
+double DelayLine::getNewestTime() const { return _times[index(_size-1)]; }
+
+double DelayLine::getNewestValue() const { return _values[index(_size-1)]; }
+
+void DelayLine::push(double time, double value)
+{
+    ++_version;
+    _replayable = true;
+    _lastTime = time;
+    _lastValue = value;
+
+    int capacity = getCapacity();
+    if (capacity == 0)
+        return;
+
+    // rewind past any sample that is not older than the new one
+    while (_size > 0 && getNewestTime() >= time)
+        popNewest();
+
+    // merge into the newest sample while it is closer than the resolution
+    // to the one before it
+    if (_size > 1 &&
+        _times[index(_size-1)] - _times[index(_size-2)] < _resolution)
+        popNewest();
+
+    // keep a single sample at or before the start of the window
+    while (_size > 1 && _times[index(1)] <= time - _delay)
+        popOldest();
+
+    if (_size == capacity)
+        popOldest();
+
+    int i = index(_size);
+    _times[i] = time;
+    _values[i] = value;
+    ++_size;
+}
+
+/* Pushing is deterministic, so replaying the last push of newer on the
+ * version before it reproduces newer without copying the window.
+ */
+void DelayLine::catchUp(const DelayLine& newer)
+{
+    if (newer._version == _version)
+        return;
+
+    if (newer._replayable && newer._version == _version + 1 &&
+            newer.getCapacity() == getCapacity()) {
+        push(newer._lastTime, newer._lastValue);
+        return;
+    }
+
+    *this = newer;
+}
+
+//=============================================================================
+// QUERIES
+//=============================================================================
+/* With uniform samples the index follows from the time, up to rounding, which
+ * the two loops correct with a step or two.
+ */
+int DelayLine::countBefore(double time, int n) const
+{
+    if (_interval > 0 && n > 0) {
+        double k = ceil((time - _times[_head])/_interval);
+        int i = k < 0 ? 0 : (k > n ? n : static_cast<int>(k));
+        while (i > 0 && _times[index(i-1)] >= time)
+            --i;
+        while (i < n && _times[index(i)] < time)
+            ++i;
+        return i;
+    }
+
+    int lo = 0;
+    int hi = n;
+    while (lo < hi) {
+        int mid = (lo + hi)/2;
+        if (_times[index(mid)] < time)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+double DelayLine::interpolate(double time, int n) const
+{
+    if (n == 0)
+        return 0;
+    if (time <= _times[_head])
+        return _values[_head];
+    if (time >= _times[index(n-1)])
+        return _values[index(n-1)];
+
+    // the segment [hi-1, hi] with times[hi-1] < time <= times[hi]
+    int hi = countBefore(time, n);
+    int i = index(hi-1);
+    int j = index(hi);
+    double w = (time - _times[i])/(_times[j] - _times[i]);
+    return _values[i] + w*(_values[j] - _values[i]);
+}
+
+double DelayLine::getValue(double time) const
+{
+    return interpolate(time, _size);
+}
+
+double DelayLine::getDelayedValue(double time) const
+{
+    double delayedTime = time - _delay;
+    if (_size == 0 || delayedTime < getOldestTime())
+        return 0;
+
+    return getValue(delayedTime);
+}
+
+double DelayLine::getDelayedValue(double time, double value) const
+{
+    double delayedTime = time - _delay;
+
+    // stored samples at or after time would be discarded by the push
+    int n = countBefore(time, _size);
+    if (n == 0)
+        return delayedTime < time ? 0 : value;
+    if (delayedTime < getOldestTime())
+        return 0;
+
+    // between the newest kept sample and the pending one
+    int i = index(n-1);
+    if (delayedTime >= _times[i]) {
+        double w = (delayedTime - _times[i])/(time - _times[i]);
+        return _values[i] + w*(value - _values[i]);
+    }
+
+    return interpolate(delayedTime, n);
+}
+
+//=============================================================================
+// SERIALIZATION
+//=============================================================================
+void DelayLine::write(ostream& out) const
+{
+    streamsize precision = out.precision(numeric_limits<double>::max_digits10);
+    out << _delay << " " << _resolution << " " << _interval << " " << _size;
+    for (int i = 0; i < _size; ++i)
+        out << " " << _times[index(i)] << " " << _values[index(i)];
+    out << "\n";
+    out.precision(precision);
+}
+
+/* The samples are stored as they were, not pushed, so merging does not
+ * change them.
+ */
+void DelayLine::read(istream& in)
+{
+    double delay, resolution, interval;
+    int size;
+    if (!(in >> delay >> resolution >> interval >> size) || size < 0)
+        throw runtime_error("DelayLine::read: malformed delay line.");
+
+    if (interval > 0)
+        allocateUniform(delay, interval);
+    else
+        allocate(delay, resolution);
+    if (size > getCapacity())
+        throw runtime_error("DelayLine::read: more samples than the delay "
+                            "and resolution allow.");
+
+    for (int i = 0; i < size; ++i) {
+        if (!(in >> _times[i] >> _values[i]))
+            throw runtime_error("DelayLine::read: malformed sample.");
+    }
+    _size = size;
+}
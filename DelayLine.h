@@ -0,0 +1,159 @@
+#ifndef OPENSIM_DelayLine_H_
+#define OPENSIM_DelayLine_H_
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim: DelayLine.h                                  *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+//============================================================================
+// INCLUDE
+//============================================================================
+#include <iosfwd>
+#include <vector>
+
+
+
+namespace OpenSim {
+
+//=============================================================================
+//=============================================================================
+/**
+ * DelayLine is a fixed capacity ring buffer of (time, value) samples used by
+ * the proprioceptors to delay their signals. Only the window needed to answer
+ * queries at (newest time - delay) is kept: older samples are discarded as new
+ * ones are pushed, and samples closer together than the resolution are merged
+ * into the newest one. The capacity therefore follows from the delay and the
+ * resolution alone and all memory is allocated in allocate().
+ *
+ * Delayed values are linearly interpolated between the stored samples with a
+ * binary search over the window, O(log(delay/resolution)). When the samples
+ * are pushed at a fixed interval (see allocateUniform()) they are found by
+ * their index instead, in O(1). A pending sample
+ * that has not been pushed yet, such as the value at an integrator trial
+ * stage, can take part in a query without being recorded.
+ *
+ * @author  Hjalti Hilmarsson
+ */
+class DelayLine {
+
+public:
+    //--------------------------------------------------------------------------
+    // CONSTRUCTION
+    //--------------------------------------------------------------------------
+    /** Default constructor. The line has no capacity until allocate(). */
+    DelayLine();
+
+    /** Size the buffer to hold a window of delay seconds of samples spaced
+        at least resolution seconds apart, and clear it. */
+    void allocate(double delay, double resolution);
+    /** Size the buffer for samples pushed every interval seconds, and clear
+        it. Queries then index the samples directly instead of searching. */
+    void allocateUniform(double delay, double interval);
+    /** Remove all samples, keeping the allocated capacity. */
+    void clear();
+
+//--------------------------------------------------------------------------
+// SAMPLES
+//--------------------------------------------------------------------------
+    /** Append the sample (time, value). Samples at or after time are
+        discarded first, so pushing an earlier time rewinds the line. */
+    void push(double time, double value);
+    /** Bring this line up to date with newer, a later version of the same
+        history. When this line is exactly one push behind, that push is
+        replayed, in O(1); otherwise newer is copied. */
+    void catchUp(const DelayLine& newer);
+
+    int getSize() const { return _size; }
+    int getCapacity() const { return static_cast<int>(_times.size()); }
+    bool isEmpty() const { return _size == 0; }
+    double getDelay() const { return _delay; }
+    double getResolution() const { return _resolution; }
+    double getSampleInterval() const { return _interval; }
+
+    double getOldestTime() const;
+    double getNewestTime() const;
+    double getNewestValue() const;
+
+//--------------------------------------------------------------------------
+// QUERIES
+//--------------------------------------------------------------------------
+    /** The stored signal linearly interpolated at time. Times before the
+        oldest sample return the oldest value and times after the newest
+        sample return the newest value. */
+    double getValue(double time) const;
+    /** The signal at (time - delay), or zero if no sample is that old. */
+    double getDelayedValue(double time) const;
+    /** The signal at (time - delay) as if the pending sample (time, value)
+        had been pushed. The line itself is not modified. */
+    double getDelayedValue(double time, double value) const;
+
+//--------------------------------------------------------------------------
+// SERIALIZATION
+//--------------------------------------------------------------------------
+    /** Write the sizing and the stored samples as text, with every double
+        written to round-trip exactly. */
+    void write(std::ostream& out) const;
+    /** Replace this line with one written by write(). Throws if the text
+        is malformed. */
+    void read(std::istream& in);
+
+private:
+    // physical index of the i-th oldest sample
+    int index(int i) const;
+    // number of the n oldest samples that are older than time
+    int countBefore(double time, int n) const;
+    // interpolate at time within the n oldest samples
+    double interpolate(double time, int n) const;
+    void popOldest();
+    void popNewest();
+
+    //=============================================================================
+    // Private Members
+    //=============================================================================
+    double _delay;
+    double _resolution;
+    // the interval of uniformly pushed samples, or zero
+    double _interval;
+
+    std::vector<double> _times;
+    std::vector<double> _values;
+    // physical index of the oldest sample and number of stored samples
+    int _head;
+    int _size;
+
+    // counts the changes to the line; the last one was pushing the sample
+    // (_lastTime, _lastValue) when _replayable is set, for catchUp()
+    long long _version;
+    bool _replayable;
+    double _lastTime;
+    double _lastValue;
+
+    //=========================================================================
+};  // END of class DelayLine
+
+}; //namespace
+//=============================================================================
+//=============================================================================
+
+#endif // OPENSIM_DelayLine_H_
+
+
@@ -0,0 +1,121 @@
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim:  DelayLineVariable.cpp                       *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+
+//=============================================================================
+// INCLUDES
+//=============================================================================
+#include "DelayLineVariable.h"
+
+
+
+using namespace OpenSim;
+using namespace SimTK;
+
+
+//=============================================================================
+// ALLOCATION
+//=============================================================================
+/* The recorded samples enter the delayed signals, which are Position stage
+ * outputs, so committing them invalidates Position.
+ */
+void DelayLineVariable::allocate(const SimTK::Subsystem& subsystem,
+                                 SimTK::State& s)
+{
+    _subsystem = &subsystem;
+    _index = subsystem.allocateAutoUpdateDiscreteVariable(s,
+            Stage::Position, new Value<DelayLine>(_prototype),
+            Stage::Position);
+}
+
+//=============================================================================
+// STATE DEPENDENT ACCESSORS
+//=============================================================================
+const DelayLine& DelayLineVariable::getValue(const SimTK::State& s) const
+{
+    return Value<DelayLine>::downcast(
+            _subsystem->getDiscreteVariable(s, _index)).get();
+}
+
+const DelayLine& DelayLineVariable::getRecordedValue(const SimTK::State& s) const
+{
+    if (!_subsystem->isDiscreteVarUpdateValueRealized(s, _index))
+        return getValue(s);
+    return Value<DelayLine>::downcast(
+            _subsystem->getDiscreteVarUpdateValue(s, _index)).get();
+}
+
+void DelayLineVariable::record(const SimTK::State& s, double time,
+                               double value) const
+{
+    DelayLine& next = Value<DelayLine>::updDowncast(
+            _subsystem->updDiscreteVarUpdateValue(s, _index)).upd();
+
+    // the update value holds an older version until the first record
+    if (!_subsystem->isDiscreteVarUpdateValueRealized(s, _index))
+        next.catchUp(getValue(s));
+
+    next.push(time, value);
+    _subsystem->markDiscreteVarUpdateValueRealized(s, _index);
+}
+
+DelayLine& DelayLineVariable::updValue(SimTK::State& s) const
+{
+    return Value<DelayLine>::updDowncast(
+            _subsystem->updDiscreteVariable(s, _index)).upd();
+}
+
+/* The update value is overwritten as well: its version counts the changes
+ * of another buffer and could match the new line's by chance, and then
+ * catchUp() would keep the old samples.
+ */
+void DelayLineVariable::reset(SimTK::State& s, double delay) const
+{
+    DelayLine& line = updValue(s);
+    if (_prototype.getSampleInterval() > 0)
+        line.allocateUniform(delay, _prototype.getSampleInterval());
+    else
+        line.allocate(delay, _prototype.getResolution());
+
+    Value<DelayLine>::updDowncast(
+            _subsystem->updDiscreteVarUpdateValue(s, _index)).upd() = line;
+}
+
+//=============================================================================
+// SERIALIZATION
+//=============================================================================
+void DelayLineVariable::write(std::ostream& out, const SimTK::State& s) const
+{
+    getRecordedValue(s).write(out);
+}
+
+/* As in reset(), the update value is overwritten too. */
+void DelayLineVariable::read(std::istream& in, SimTK::State& s) const
+{
+    DelayLine& line = updValue(s);
+    line.read(in);
+
+    Value<DelayLine>::updDowncast(
+            _subsystem->updDiscreteVarUpdateValue(s, _index)).upd() = line;
+}
@@ -0,0 +1,108 @@
+#ifndef OPENSIM_DelayLineVariable_H_
+#define OPENSIM_DelayLineVariable_H_
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim: DelayLineVariable.h                          *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+//============================================================================
+// INCLUDE
+//============================================================================
+#include "DelayLine.h"
+#include "SimTKcommon.h"
+
+
+
+namespace OpenSim {
+
+//=============================================================================
+//=============================================================================
+/**
+ * DelayLineVariable keeps a DelayLine in each SimTK::State instead of in the
+ * component, so one model can run any number of simulations, one after the
+ * other or concurrently on different States, without their histories
+ * mixing. The component itself only holds the empty prototype and the index
+ * of the variable.
+ *
+ * The line is an auto-update discrete variable. Samples recorded while the
+ * State is being realized, such as at the Report stage of an accepted step,
+ * go to the variable's update value and the integrator commits them when it
+ * starts the next step. The update value is the buffer committed the step
+ * before, so it is brought up to date with DelayLine::catchUp() rather than
+ * copied.
+ *
+ * @author  Hjalti Hilmarsson
+ */
+class DelayLineVariable {
+
+public:
+    DelayLineVariable() {}
+
+    /** The empty line every State starts with. Size it with allocate() or
+        allocateUniform() before the system is built. */
+    const DelayLine& getPrototype() const { return _prototype; }
+    DelayLine& updPrototype() { return _prototype; }
+
+    /** Allocate the variable in s with a copy of the prototype. Call this
+        from extendRealizeTopology(). */
+    void allocate(const SimTK::Subsystem& subsystem, SimTK::State& s);
+    bool isAllocated() const { return !_subsystem.empty(); }
+
+//--------------------------------------------------------------------------
+// STATE DEPENDENT ACCESSORS
+//--------------------------------------------------------------------------
+    /** The line committed in s. */
+    const DelayLine& getValue(const SimTK::State& s) const;
+    /** The line committed in s with the samples recorded in s since. */
+    const DelayLine& getRecordedValue(const SimTK::State& s) const;
+    /** Record (time, value) in s, to be committed when the integrator
+        starts its next step. The committed line is not modified. */
+    void record(const SimTK::State& s, double time, double value) const;
+    /** The committed line, to modify it directly, as event handlers and
+        state initialization do. */
+    DelayLine& updValue(SimTK::State& s) const;
+    /** Resize the line in s for a new delay, spaced like the prototype, and
+        clear it. Nothing recorded in s before is committed afterwards. */
+    void reset(SimTK::State& s, double delay) const;
+
+//--------------------------------------------------------------------------
+// SERIALIZATION
+//--------------------------------------------------------------------------
+    /** Write the line recorded in s (see DelayLine::write()). */
+    void write(std::ostream& out, const SimTK::State& s) const;
+    /** Replace the line in s with one written by write(). Nothing recorded
+        in s before is committed afterwards. */
+    void read(std::istream& in, SimTK::State& s) const;
+
+private:
+    DelayLine _prototype;
+    SimTK::ReferencePtr<const SimTK::Subsystem> _subsystem;
+    SimTK::DiscreteVariableIndex _index;
+
+    //=========================================================================
+};  // END of class DelayLineVariable
+
+}; //namespace
+//=============================================================================
+//=============================================================================
+
+#endif // OPENSIM_DelayLineVariable_H_
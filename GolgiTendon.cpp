@@ -85,27 +85,99 @@ GolgiTendon::GolgiTendon(const std::string& name,
  */
 void GolgiTendon::constructProperties()
 {
+    constructProperty_delay(0.0);
+    constructProperty_history_resolution(1.0e-4);
+    constructProperty_record_accepted_steps_only(true);
+    constructProperty_sampling_rate(0.0);
+    constructProperty_delay_mode("history");
+    constructProperty_pade_order(4);
+    constructProperty_snapshot("");
     
+    _padeMode = false;
+    tendonChannel = -1;
+    _tendonSlackLength = 0;
+    _recordAcceptedStepsOnly = true;
+    _samplingInterval = 0;
 }
 
-void GolgiTendon::addToSystem(SimTK::MultibodySystem& system)const
+void GolgiTendon::extendAddToSystem(SimTK::MultibodySystem& system) const
 {
-    Super::addToSystem(system);
-    GolgiTendon* mutableThis = const_cast<GolgiTendon *>(this);
+    Super::extendAddToSystem(system);
+    
+    // the Pade delay filter integrates with the rest of the system
+    for (const std::string& name : tendonStateNames)
+        addStateVariable(name);
+    
+    if (_samplingInterval > 0) {
+        system.updDefaultSubsystem().addEventHandler(
+            new PeriodicSampler(_samplingInterval,
+                [this](SimTK::State& s) { recordSample(s); }));
+    }
+    
+    // the delayed signal is valid for as long as the stage of its output
+    _tendonLengthCV = addCacheVariable("tendon_length", 0.0,
+                                       SimTK::Stage::Position);
 }
 
 void GolgiTendon::extendConnectToModel(Model &model)
 {
     Super::extendConnectToModel(model);
     
-    muscleTendonHistory.setSize(0);
-    muscleTendonHistory.setMemoryOwner(true);
+    OPENSIM_THROW_IF_FRMOBJ(get_delay() < 0, Exception,
+                            "Expected delay to be non-negative.");
+    OPENSIM_THROW_IF_FRMOBJ(get_history_resolution() <= 0, Exception,
+                            "Expected history_resolution to be positive.");
+    OPENSIM_THROW_IF_FRMOBJ(get_sampling_rate() < 0, Exception,
+                            "Expected sampling_rate to be non-negative.");
+    OPENSIM_THROW_IF_FRMOBJ(
+            get_delay_mode() != "history" && get_delay_mode() != "pade",
+            Exception, "Expected delay_mode to be 'history' or 'pade', "
+            "but got '" + get_delay_mode() + "'.");
+    OPENSIM_THROW_IF_FRMOBJ(
+            get_pade_order() < 1 || get_pade_order() > PadeDelay::MaxOrder,
+            Exception, "Expected pade_order to be between 1 and " +
+            std::to_string(PadeDelay::MaxOrder) + ".");
+    
+    // cache what the signal needs so evaluating it does no lookups
+    _muscle = &getSocket<Muscle>("muscle").getConnectee();
+    _tendonSlackLength = _muscle->getTendonSlackLength();
+    _recordAcceptedStepsOnly = get_record_accepted_steps_only();
     
-    const Muscle& musc = getMuscle();
+    _padeMode = get_delay_mode() == "pade";
+    tendonStateNames.clear();
     
-    PiecewiseLinearFunction muscleTendon;
-    muscleTendon.setName(musc.getName());
-    muscleTendonHistory.cloneAndAppend(muscleTendon);
+    if (_padeMode) {
+        tendonPade.setDelay(get_delay(), get_pade_order());
+        for (int i = 0; i < tendonPade.getNumStates(); ++i)
+            tendonStateNames.push_back("tendon_delay_" + std::to_string(i));
+    }
+    
+    // a sampled history is recorded by its own periodic event
+    _samplingInterval = 0;
+    if (!_padeMode && get_sampling_rate() > 0)
+        _samplingInterval = 1/get_sampling_rate();
+    
+    // record in the model's DelayBank if it has one
+    _bank.clear();
+    if (!_padeMode && _samplingInterval == 0 &&
+            get_record_accepted_steps_only()) {
+        if (DelayBank* bank = DelayBank::findInModel(model)) {
+            tendonChannel = bank->addChannel(*this, "tendon", get_delay(),
+                [this](const SimTK::State& s) { return calcTendonStretch(s); });
+            _bank = bank;
+        }
+    }
+    
+    if (!_padeMode && _bank.empty() && _samplingInterval > 0) {
+        // a uniformly sampled history is indexed directly
+        muscleTendonHistory.updPrototype().allocateUniform(get_delay(),
+                                                           _samplingInterval);
+    }
+    else if (!_padeMode && _bank.empty()) {
+        // size the history for the delay so nothing is allocated while simulating
+        muscleTendonHistory.updPrototype().allocate(get_delay(),
+                                                    get_history_resolution());
+    }
     
 }
 
@@ -118,45 +190,204 @@ void GolgiTendon::extendConnectToModel(Model &model)
 //-----------------------------------------------------------------------------
 const Muscle& GolgiTendon::getMuscle() const
 {
+    if (!_muscle.empty())
+        return *_muscle;
     return getSocket<Muscle>("muscle").getConnectee();
 }
 
+//-----------------------------------------------------------------------------
+// Parameters in the State
+//-----------------------------------------------------------------------------
+double GolgiTendon::getDelay(const SimTK::State& s) const
+{
+    if (_padeMode || !_bank.empty())
+        return get_delay();
+    return muscleTendonHistory.getValue(s).getDelay();
+}
+
+void GolgiTendon::setDelay(SimTK::State& s, double delay) const
+{
+    OPENSIM_THROW_IF_FRMOBJ(delay < 0, Exception,
+                            "Expected delay to be non-negative.");
+    OPENSIM_THROW_IF_FRMOBJ(_padeMode || !_bank.empty(), Exception,
+            "The delay can only be set in the State in the 'history' "
+            "delay_mode without a DelayBank; set the delay property and "
+            "rebuild the system instead.");
+    muscleTendonHistory.reset(s, delay);
+}
+
+//-----------------------------------------------------------------------------
+// Checkpoints
+//-----------------------------------------------------------------------------
+void GolgiTendon::writeCheckpoint(std::ostream& out,
+                                  const SimTK::State& s) const
+{
+    if (!_padeMode && _bank.empty())
+        muscleTendonHistory.write(out, s);
+}
+
+void GolgiTendon::readCheckpoint(std::istream& in, SimTK::State& s) const
+{
+    if (!_padeMode && _bank.empty())
+        muscleTendonHistory.read(in, s);
+}
+
+
+//=============================================================================
+// SIMULATION
+//=============================================================================
+void GolgiTendon::extendInitStateFromProperties(SimTK::State& s) const
+{
+    Super::extendInitStateFromProperties(s);
+    
+    if (!_padeMode && _bank.empty())
+        muscleTendonHistory.reset(s, get_delay());
+}
+
+void GolgiTendon::extendSetPropertiesFromState(const SimTK::State& s)
+{
+    Super::extendSetPropertiesFromState(s);
+    
+    set_delay(getDelay(s));
+}
+
+/* The Manager realizes the Report stage once for every accepted step, so
+ * recording here keeps integrator trial stages and rejected steps out of the
+ * history.
+ */
+void GolgiTendon::extendRealizeReport(const SimTK::State& s) const
+{
+    Super::extendRealizeReport(s);
+    
+    if (!_padeMode && _bank.empty() && _recordAcceptedStepsOnly &&
+            _samplingInterval == 0)
+        muscleTendonHistory.record(s, s.getTime(), calcTendonStretch(s));
+}
+
+/* Called by the periodic event every sampling interval, so the history holds
+ * uniformly spaced samples.
+ */
+void GolgiTendon::recordSample(SimTK::State& s) const
+{
+    getSystem().realize(s, SimTK::Stage::Position);
+    double stretch = calcTendonStretch(s);
+    muscleTendonHistory.updValue(s).push(s.getTime(), stretch);
+}
+
+/* In Pade mode the delayed signal is the output of a linear filter driven by
+ * the undelayed one. The filter states start at zero.
+ */
+void GolgiTendon::computeStateVariableDerivatives(const SimTK::State& s) const
+{
+    if (!_padeMode)
+        return;
+    
+    double x[PadeDelay::MaxOrder];
+    double xdot[PadeDelay::MaxOrder];
+    
+    getPadeStates(s, x);
+    tendonPade.calcDerivatives(x, calcTendonStretch(s), xdot);
+    for (size_t i = 0; i < tendonStates.size(); ++i)
+        tendonStates[i]->setDerivative(s, xdot[i]);
+}
+
+void GolgiTendon::getPadeStates(const SimTK::State& s, double* x) const
+{
+    for (size_t i = 0; i < tendonStates.size(); ++i)
+        x[i] = tendonStates[i]->getValue(s);
+}
+
+void GolgiTendon::extendRealizeTopology(SimTK::State& s) const
+{
+    Super::extendRealizeTopology(s);
+    
+    // every State gets its own delay history
+    if (!_padeMode && _bank.empty())
+        muscleTendonHistory.allocate(getSystem().getDefaultSubsystem(), s);
+    
+    tendonStates.clear();
+    for (const std::string& name : tendonStateNames)
+        tendonStates.push_back(traverseToStateVariable(name));
+    
+    // read the muscle through its snapshot if one is given
+    _snapshot.clear();
+    if (!get_snapshot().empty()) {
+        const MuscleSensorSnapshot& snapshot =
+                getComponent<MuscleSensorSnapshot>(get_snapshot());
+        OPENSIM_THROW_IF_FRMOBJ(&snapshot.getMuscle() != _muscle.get(),
+                Exception, "Expected snapshot '" + get_snapshot() +
+                "' to measure muscle '" + _muscle->getName() + "'.");
+        _snapshot = &snapshot;
+    }
+}
 
 //=============================================================================
 // SIGNALS
 //=============================================================================
 //_____________________________________________________________________________
 /**
- * Compute the tendon length for the Golgi Tendon
+ * Compute the undelayed stretch of the tendon beyond its slack length
+ *
+ * @param s         current state of the system
+ */
+double GolgiTendon::calcTendonStretch(const SimTK::State& s) const
+{
+    double tendon_length = _snapshot.empty() ? _muscle->getTendonLength(s)
+                                             : _snapshot->getTendonLength(s);
+    return tendon_length - _tendonSlackLength;
+}
+
+//_____________________________________________________________________________
+/**
+ * Get the tendon length for the Golgi Tendon
+ *
+ * It is computed once per realized state and cached. In Pade mode it also
+ * depends on the filter states, which do not invalidate the cache, so it is
+ * recomputed on every call; that is only the filter output.
  *
  * @param s         current state of the system
  */
 
 double GolgiTendon::getTendonLength(const SimTK::State& s) const
+{
+    if (_padeMode)
+        return calcTendonLength(s);
+    if (!isCacheVariableValid(s, _tendonLengthCV))
+        setCacheVariableValue(s, _tendonLengthCV, calcTendonLength(s));
+    return getCacheVariableValue(s, _tendonLengthCV);
+}
+
+//_____________________________________________________________________________
+/**
+ * Compute the delayed tendon length for the Golgi Tendon
+ *
+ * @param s         current state of the system
+ */
+
+double GolgiTendon::calcTendonLength(const SimTK::State& s) const
 {
     double time = s.getTime();
     double length = 0;
-    double tendon_length = 0;
-    double tendon_slack_length = 0;
-    double golgi_length = 0;
-    
-    const Muscle& musc = getMuscle();
+    double golgi_length = calcTendonStretch(s);
     
-    tendon_length = musc.getTendonLength(s);
-    tendon_slack_length = musc.getTendonSlackLength();
-    golgi_length = tendon_length - tendon_slack_length;
-    
-    muscleTendonHistory.get(musc.getName()).addPoint(time, golgi_length);
-    
-    if((time - get_delay()) < muscleTendonHistory.get(musc.getName()).getXValues()[0])
-    {
-        length = 0;
+    if (_padeMode) {
+        double x[PadeDelay::MaxOrder];
+        getPadeStates(s, x);
+        length = tendonPade.calcOutput(x, golgi_length);
+    }
+    else if (!_bank.empty()) {
+        length = _bank->getDelayedValue(s, tendonChannel, golgi_length);
     }
-    else
-    {
-        length = golgi_length;
+    else if (_recordAcceptedStepsOnly || _samplingInterval > 0) {
+        // the current sample stays pending until it is recorded
+        length = muscleTendonHistory.getValue(s)
+                .getDelayedValue(time, golgi_length);
+    }
+    else {
+        muscleTendonHistory.record(s, time, golgi_length);
+        // zero until the history reaches back a full delay
+        length = muscleTendonHistory.getRecordedValue(s).getDelayedValue(time);
     }
     
     return length;
 }
-
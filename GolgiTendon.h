@@ -30,7 +30,11 @@
 #include "osimGolgiTendonDLL.h"
 #include "OpenSim/Simulation/Control/Controller.h"
 #include "OpenSim/Simulation/Model/Muscle.h"
-#include "OpenSim/Common/PiecewiseLinearFunction.h"
+#include "DelayLineVariable.h"
+#include "PadeDelay.h"
+#include "DelayBank.h"
+#include "PeriodicSampler.h"
+#include "MuscleSensorSnapshot.h"
 #include "OpenSim/Simulation/Model/Model.h"
 
 
@@ -56,6 +60,18 @@ public:
 //=============================================================================
     OpenSim_DECLARE_PROPERTY(delay, double,
                             "The time delay (seconds) between the muscle stretch and the stretch reflex signal");
+    OpenSim_DECLARE_PROPERTY(history_resolution, double,
+                            "The minimum time (seconds) between samples kept in the delay history");
+    OpenSim_DECLARE_PROPERTY(record_accepted_steps_only, bool,
+                            "Record the delay history only at accepted integration steps (when the Report stage is realized) instead of at every evaluation");
+    OpenSim_DECLARE_PROPERTY(sampling_rate, double,
+                            "The rate (Hz) at which a periodic event samples the delay history; 0 records at every accepted integration step");
+    OpenSim_DECLARE_PROPERTY(delay_mode, std::string,
+                            "How the delay is computed: 'history' interpolates the recorded signal, 'pade' integrates a Pade approximation of the delay as continuous states");
+    OpenSim_DECLARE_PROPERTY(pade_order, int,
+                            "The order (number of states) of the Pade approximation used when delay_mode is 'pade'");
+    OpenSim_DECLARE_PROPERTY(snapshot, std::string,
+                            "The path of the MuscleSensorSnapshot of the muscle, read instead of the muscle; none when empty");
 //==============================================================================
 // SOCKETS
 //==============================================================================
@@ -99,6 +115,28 @@ public:
     Get quanitites of interest common to all spindles*/
     void setTendonLength(SimTK::State& s, double length) const;
     double getTendonLength(const SimTK::State& s) const;
+    
+//--------------------------------------------------------------------------
+// GOLGI TENDON PARAMETERS IN THE STATE
+//--------------------------------------------------------------------------
+/** @name Golgi Tendon Parameters in the State
+    The delay is kept in the State with the delay history and initialized
+    from the property, so a State copy can be given another delay without
+    rebuilding the system. */
+    double getDelay(const SimTK::State& s) const;
+    /** Set the delay in s and clear the delay history in s. Only the
+        'history' delay_mode without a DelayBank supports this; the others
+        need the system rebuilt. */
+    void setDelay(SimTK::State& s, double delay) const;
+
+//--------------------------------------------------------------------------
+// CHECKPOINTS
+//--------------------------------------------------------------------------
+    /** Write what this organ keeps in s besides its continuous states: its delay history.
+        Used by StateCheckpoint. */
+    void writeCheckpoint(std::ostream& out, const SimTK::State& s) const;
+    /** Read what writeCheckpoint() wrote into s. */
+    void readCheckpoint(std::istream& in, SimTK::State& s) const;
         
 
 private:
@@ -107,9 +145,52 @@ private:
     // ModelComponent interface to connect this component to its model
     void extendConnectToModel(Model& aModel) override;
     // ModelComponent interface to add computational elemetns to the SimTK system
-    void addToSystem(SimTK::MultibodySystem& system) const;
+    void extendAddToSystem(SimTK::MultibodySystem& system) const override;
+    // integrate the Pade delay states
+    void computeStateVariableDerivatives(const SimTK::State& s) const override;
+    // clear the delay history for a new simulation
+    void extendInitStateFromProperties(SimTK::State& s) const override;
+    // copy the delay in the State back to the property
+    void extendSetPropertiesFromState(const SimTK::State& s) override;
+    // commit the current sample to the delay history at accepted steps
+    void extendRealizeReport(const SimTK::State& s) const override;
+    // record the history at the periodic sampling event
+    void recordSample(SimTK::State& s) const;
+    
+    // the undelayed tendon stretch beyond its slack length
+    double calcTendonStretch(const SimTK::State& s) const;
+    // the delayed signal, before it is cached
+    double calcTendonLength(const SimTK::State& s) const;
+    // read the Pade delay filter states
+    void getPadeStates(const SimTK::State& s, double* x) const;
+    // look up the Pade delay state variables once the system is built
+    void extendRealizeTopology(SimTK::State& s) const override;
+    
+    // the delay history, kept in the State
+    mutable DelayLineVariable muscleTendonHistory;
+    
+    // Pade delay filter and the names of its state variables
+    bool _padeMode;
+    PadeDelay tendonPade;
+    std::vector<std::string> tendonStateNames;
+    mutable std::vector<const StateVariable*> tendonStates;
+    
+    // the model's DelayBank and the channel of the signal, when it is used
+    SimTK::ReferencePtr<const DelayBank> _bank;
+    int tendonChannel;
+    
+    // the connected muscle and the constants read on every evaluation
+    SimTK::ReferencePtr<const Muscle> _muscle;
+    // the muscle's sensor snapshot, when the model has one
+    mutable SimTK::ReferencePtr<const MuscleSensorSnapshot> _snapshot;
+    double _tendonSlackLength;
+    bool _recordAcceptedStepsOnly;
+    // the period of the sampling event, or zero when it is not used
+    double _samplingInterval;
     
-    mutable OpenSim::Set<PiecewiseLinearFunction> muscleTendonHistory;
+    // the delayed signal of the current state, so that repeated queries
+    // neither recompute it nor record it again
+    mutable CacheVariable<double> _tendonLengthCV;
     
 protected:
     //=========================================================================
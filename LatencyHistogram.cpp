@@ -0,0 +1,141 @@
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim:  LatencyHistogram.cpp                        *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+
+//=============================================================================
+// INCLUDES
+//=============================================================================
+#include "LatencyHistogram.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <ostream>
+
+
+
+using namespace OpenSim;
+using namespace std;
+
+
+// the largest power of two that is bucketed; longer latencies go to the
+// last bucket
+static const int MaxShift = 34;
+
+
+//=============================================================================
+// CONSTRUCTOR(S)
+//=============================================================================
+//_____________________________________________________________________________
+LatencyHistogram::LatencyHistogram() :
+    _counts((MaxShift + 2)*SubBuckets, 0)
+{
+    clear();
+}
+
+void LatencyHistogram::clear()
+{
+    std::fill(_counts.begin(), _counts.end(), 0);
+    _count = 0;
+    _min = numeric_limits<long long>::max();
+    _max = 0;
+    _sum = 0;
+}
+
+//=============================================================================
+// BUCKETS
+//=============================================================================
+/* Latencies below 2*SubBuckets ns have a bucket each. Above, a latency is
+ * shifted right until it is below 2*SubBuckets, and the shift and what is
+ * left give the bucket, so the buckets of each power of two are
+ * 2^shift ns wide.
+ */
+int LatencyHistogram::getBucket(long long nanoseconds)
+{
+    long long v = std::max(nanoseconds, 0LL);
+    int shift = 0;
+    while (v >= 2*SubBuckets && shift < MaxShift) {
+        v >>= 1;
+        ++shift;
+    }
+    if (v >= 2*SubBuckets)
+        v = 2*SubBuckets - 1;
+    return shift*SubBuckets + (int)v;
+}
+
+long long LatencyHistogram::getLowerEdge(int bucket)
+{
+    if (bucket < 2*SubBuckets)
+        return bucket;
+    int shift = bucket/SubBuckets - 1;
+    long long mantissa = bucket - shift*SubBuckets;
+    return mantissa << shift;
+}
+
+long long LatencyHistogram::getUpperEdge(int bucket)
+{
+    if (bucket < 2*SubBuckets)
+        return bucket;
+    int shift = bucket/SubBuckets - 1;
+    return getLowerEdge(bucket) + (1LL << shift) - 1;
+}
+
+//=============================================================================
+// COUNTS
+//=============================================================================
+void LatencyHistogram::record(long long nanoseconds)
+{
+    if (nanoseconds < 0)
+        nanoseconds = 0;
+    ++_counts[getBucket(nanoseconds)];
+    ++_count;
+    _min = std::min(_min, nanoseconds);
+    _max = std::max(_max, nanoseconds);
+    _sum += nanoseconds;
+}
+
+long long LatencyHistogram::getPercentile(double percent) const
+{
+    if (_count == 0)
+        return 0;
+    long long rank = (long long)std::ceil(percent/100*_count);
+    rank = std::min(std::max(rank, 1LL), _count);
+
+    // the last bucket also holds everything longer
+    long long seen = 0;
+    for (int b = 0; b + 1 < (int)_counts.size(); ++b) {
+        seen += _counts[b];
+        if (seen >= rank)
+            return std::min(std::max(getUpperEdge(b), _min), _max);
+    }
+    return _max;
+}
+
+void LatencyHistogram::write(std::ostream& out) const
+{
+    out << "lower_ns\tupper_ns\tcount\n";
+    for (int b = 0; b < (int)_counts.size(); ++b)
+        if (_counts[b] > 0)
+            out << getLowerEdge(b) << "\t" << getUpperEdge(b) << "\t"
+                << _counts[b] << "\n";
+}
@@ -0,0 +1,93 @@
+#ifndef OPENSIM_LatencyHistogram_H_
+#define OPENSIM_LatencyHistogram_H_
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim: LatencyHistogram.h                           *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+//============================================================================
+// INCLUDE
+//============================================================================
+#include <iosfwd>
+#include <vector>
+
+
+
+namespace OpenSim {
+
+//=============================================================================
+//=============================================================================
+/**
+ * LatencyHistogram counts latencies in nanoseconds in log-linear buckets:
+ * every power of two is split into SubBuckets buckets, so a percentile is
+ * known to within 1/SubBuckets of its value from 1 ns to over 15 minutes.
+ * All buckets are allocated by the constructor and recording is a few
+ * integer operations, so it can be called in a real-time loop.
+ *
+ * @author  Hjalti Hilmarsson
+ */
+class LatencyHistogram {
+
+public:
+    /** The buckets per power of two. */
+    static const int SubBuckets = 64;
+
+    LatencyHistogram();
+
+    /** Count a latency of nanoseconds; negative latencies count as 0. */
+    void record(long long nanoseconds);
+    /** Remove all counts. */
+    void clear();
+
+    long long getCount() const { return _count; }
+    long long getMin() const { return _count > 0 ? _min : 0; }
+    long long getMax() const { return _max; }
+    double getMean() const { return _count > 0 ? _sum/_count : 0; }
+    /** The latency that percent percent of the counts do not exceed: the
+        upper edge of its bucket, or the maximum if that is lower or the
+        latency is beyond the last bucket. */
+    long long getPercentile(double percent) const;
+
+    /** Write the buckets that have counts as tab separated rows of their
+        lower edge, upper edge and count, in nanoseconds. */
+    void write(std::ostream& out) const;
+
+private:
+    // the bucket of a latency and the edges of a bucket
+    static int getBucket(long long nanoseconds);
+    static long long getLowerEdge(int bucket);
+    static long long getUpperEdge(int bucket);
+
+    std::vector<long long> _counts;
+    long long _count;
+    long long _min;
+    long long _max;
+    double _sum;
+
+    //=========================================================================
+};  // END of class LatencyHistogram
+
+}; //namespace
+//=============================================================================
+//=============================================================================
+
+#endif // OPENSIM_LatencyHistogram_H_
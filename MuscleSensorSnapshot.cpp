@@ -0,0 +1,131 @@
+/* -------------------------------------------------------------------------- *
+ *                   OpenSim:  MuscleSensorSnapshot.cpp                       *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+
+//=============================================================================
+// INCLUDES
+//=============================================================================
+#include "MuscleSensorSnapshot.h"
+#include <OpenSim/OpenSim.h>
+
+
+
+// This allows us to use OpenSim functions, classes, etc., without having to
+// prefix the names of those things with "OpenSim::".
+using namespace OpenSim;
+using namespace std;
+using namespace SimTK;
+
+
+//=============================================================================
+// CONSTRUCTOR(S) AND DESTRUCTOR
+//=============================================================================
+//_____________________________________________________________________________
+/* Default constructor. */
+MuscleSensorSnapshot::MuscleSensorSnapshot()
+{
+}
+
+/* Convenience constructor. */
+MuscleSensorSnapshot::MuscleSensorSnapshot(const std::string& name,
+                                           const Muscle& muscle)
+{
+    OPENSIM_THROW_IF(name.empty(), ComponentHasNoName, getClassName());
+
+    setName(name);
+    connectSocket_muscle(muscle);
+}
+
+//=============================================================================
+// SETUP
+//=============================================================================
+void MuscleSensorSnapshot::extendConnectToModel(Model& model)
+{
+    Super::extendConnectToModel(model);
+
+    _muscle = &getSocket<Muscle>("muscle").getConnectee();
+}
+
+/* Each group of values is valid for as long as the stage it depends on. */
+void MuscleSensorSnapshot::extendAddToSystem(SimTK::MultibodySystem& system) const
+{
+    Super::extendAddToSystem(system);
+
+    _lengthsCV = addCacheVariable("lengths", Vec3(0), SimTK::Stage::Position);
+    _lengtheningSpeedCV = addCacheVariable("lengthening_speed", 0.0,
+                                           SimTK::Stage::Velocity);
+    _tendonForceCV = addCacheVariable("tendon_force", 0.0,
+                                      SimTK::Stage::Dynamics);
+}
+
+const Muscle& MuscleSensorSnapshot::getMuscle() const
+{
+    if (!_muscle.empty())
+        return *_muscle;
+    return getSocket<Muscle>("muscle").getConnectee();
+}
+
+//=============================================================================
+// SIGNALS
+//=============================================================================
+const Vec3& MuscleSensorSnapshot::getLengths(const SimTK::State& s) const
+{
+    if (!isCacheVariableValid(s, _lengthsCV)) {
+        Vec3 lengths(_muscle->getFiberLength(s),
+                     _muscle->getLength(s),
+                     _muscle->getTendonLength(s));
+        setCacheVariableValue(s, _lengthsCV, lengths);
+    }
+    return getCacheVariableValue(s, _lengthsCV);
+}
+
+double MuscleSensorSnapshot::getFiberLength(const SimTK::State& s) const
+{
+    return getLengths(s)[0];
+}
+
+double MuscleSensorSnapshot::getLength(const SimTK::State& s) const
+{
+    return getLengths(s)[1];
+}
+
+double MuscleSensorSnapshot::getTendonLength(const SimTK::State& s) const
+{
+    return getLengths(s)[2];
+}
+
+double MuscleSensorSnapshot::getLengtheningSpeed(const SimTK::State& s) const
+{
+    if (!isCacheVariableValid(s, _lengtheningSpeedCV))
+        setCacheVariableValue(s, _lengtheningSpeedCV,
+                              _muscle->getLengtheningSpeed(s));
+    return getCacheVariableValue(s, _lengtheningSpeedCV);
+}
+
+double MuscleSensorSnapshot::getTendonForce(const SimTK::State& s) const
+{
+    if (!isCacheVariableValid(s, _tendonForceCV))
+        setCacheVariableValue(s, _tendonForceCV, _muscle->getTendonForce(s));
+    return getCacheVariableValue(s, _tendonForceCV);
+}
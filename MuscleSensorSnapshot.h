@@ -0,0 +1,122 @@
+#ifndef OPENSIM_MuscleSensorSnapshot_H_
+#define OPENSIM_MuscleSensorSnapshot_H_
+/* -------------------------------------------------------------------------- *
+ *                   OpenSim: MuscleSensorSnapshot.h                          *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+//============================================================================
+// INCLUDE
+//============================================================================
+#include "osimMuscleSensorSnapshotDLL.h"
+#include "OpenSim/Simulation/Model/ModelComponent.h"
+#include "OpenSim/Simulation/Model/Muscle.h"
+
+
+
+namespace OpenSim {
+
+//=============================================================================
+//=============================================================================
+/**
+ * MuscleSensorSnapshot reads everything the proprioceptors measure on one
+ * muscle in one pass per realization stage: the fiber, muscle-tendon and
+ * tendon lengths once the Position stage is realized, the lengthening speed
+ * at Velocity and the tendon force at Dynamics. The values are kept in cache
+ * variables, so every SimpleSpindle and GolgiTendon on the muscle reads them
+ * without going back to the muscle model.
+ *
+ * Add one snapshot per muscle to the model and give its path to the
+ * snapshot property of the proprioceptors on that muscle; a proprioceptor
+ * without one reads the muscle directly.
+ *
+ * @author  Hjalti Hilmarsson
+ */
+class OSIMMUSCLESENSORSNAPSHOT_API MuscleSensorSnapshot : public ModelComponent {
+OpenSim_DECLARE_CONCRETE_OBJECT(MuscleSensorSnapshot, ModelComponent);
+
+public:
+//==============================================================================
+// SOCKETS
+//==============================================================================
+    OpenSim_DECLARE_SOCKET(muscle, Muscle, "The muscle that the snapshot measures");
+
+//=============================================================================
+// OUTPUTS
+//=============================================================================
+    OpenSim_DECLARE_OUTPUT(fiber_length, double, getFiberLength, SimTK::Stage::Position);
+    OpenSim_DECLARE_OUTPUT(length, double, getLength, SimTK::Stage::Position);
+    OpenSim_DECLARE_OUTPUT(tendon_length, double, getTendonLength, SimTK::Stage::Position);
+    OpenSim_DECLARE_OUTPUT(lengthening_speed, double, getLengtheningSpeed, SimTK::Stage::Velocity);
+    OpenSim_DECLARE_OUTPUT(tendon_force, double, getTendonForce, SimTK::Stage::Dynamics);
+
+//=============================================================================
+// METHODS
+//=============================================================================
+    //--------------------------------------------------------------------------
+    // CONSTRUCTION AND DESTRUCTION
+    //--------------------------------------------------------------------------
+    /** Default constructor. */
+    MuscleSensorSnapshot();
+    MuscleSensorSnapshot(const std::string& name, const Muscle& muscle);
+
+    // Uses default (compiler-generated) destructor, copy constructor and copy
+    // assignment operator.
+
+    // get the muscle this snapshot measures
+    const Muscle& getMuscle() const;
+
+//--------------------------------------------------------------------------
+// STATE DEPENDENT ACCESSORS
+//--------------------------------------------------------------------------
+    double getFiberLength(const SimTK::State& s) const;
+    double getLength(const SimTK::State& s) const;
+    double getTendonLength(const SimTK::State& s) const;
+    double getLengtheningSpeed(const SimTK::State& s) const;
+    double getTendonForce(const SimTK::State& s) const;
+
+private:
+    // ModelComponent interface to connect this component to its model
+    void extendConnectToModel(Model& aModel) override;
+    // ModelComponent interface to add computational elemetns to the SimTK system
+    void extendAddToSystem(SimTK::MultibodySystem& system) const override;
+
+    // the fiber, muscle-tendon and tendon lengths, read together
+    const SimTK::Vec3& getLengths(const SimTK::State& s) const;
+
+    //=============================================================================
+    // Private Members
+    //=============================================================================
+    SimTK::ReferencePtr<const Muscle> _muscle;
+
+    mutable CacheVariable<SimTK::Vec3> _lengthsCV;
+    mutable CacheVariable<double> _lengtheningSpeedCV;
+    mutable CacheVariable<double> _tendonForceCV;
+
+    //=========================================================================
+};  // END of class MuscleSensorSnapshot
+
+}; //namespace
+//=============================================================================
+//=============================================================================
+
+#endif // OPENSIM_MuscleSensorSnapshot_H_
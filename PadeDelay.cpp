@@ -0,0 +1,119 @@
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim:  PadeDelay.cpp                               *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+
+//=============================================================================
+// INCLUDES
+//=============================================================================
+#include "PadeDelay.h"
+
+
+
+using namespace OpenSim;
+using namespace std;
+
+
+//=============================================================================
+// CONSTRUCTOR(S)
+//=============================================================================
+//_____________________________________________________________________________
+/* Default constructor. */
+PadeDelay::PadeDelay() :
+    _delay(0), _feedthrough(1)
+{
+}
+
+/* Build the filter.
+ *
+ * With tau = s*delay the approximation is N(-tau)/N(tau) where
+ *     N(tau) = sum_k c_k tau^k,  c_k = (2n-k)! n! / ((2n)! k! (n-k)!).
+ * Dividing both polynomials by c_n gives the monic denominator coefficients
+ * alpha_k = c_k/c_n and numerator coefficients beta_k = (-1)^k alpha_k,
+ * beta_n = (-1)^n. The controllable canonical states x_k are scaled by alpha_0
+ * so that x_1 = u at steady state, and time is scaled by the delay.
+ */
+void PadeDelay::setDelay(double delay, int order)
+{
+    _delay = delay > 0 ? delay : 0;
+    _alpha.clear();
+    _gamma.clear();
+    _feedthrough = 1;
+
+    if (_delay == 0)
+        return;
+
+    int n = order < 1 ? 1 : (order > MaxOrder ? MaxOrder : order);
+
+    vector<double> c(n+1);
+    c[0] = 1;
+    for (int k = 0; k < n; ++k)
+        c[k+1] = c[k]*(n-k)/((2.0*n-k)*(k+1));
+
+    _alpha.resize(n);
+    _gamma.resize(n);
+    _feedthrough = (n % 2 == 0) ? 1 : -1;
+
+    double sign = 1;
+    for (int k = 0; k < n; ++k) {
+        _alpha[k] = c[k]/c[n];
+        double beta = sign*_alpha[k];
+        _gamma[k] = (beta - _feedthrough*_alpha[k])/_alpha[0];
+        sign = -sign;
+    }
+}
+
+//=============================================================================
+// EVALUATION
+//=============================================================================
+void PadeDelay::calcDerivatives(const double* x, double u, double* xdot) const
+{
+    int n = getNumStates();
+    if (n == 0)
+        return;
+
+    double rate = 1.0/_delay;
+    double last = _alpha[0]*u;
+    for (int k = 0; k < n; ++k)
+        last -= _alpha[k]*x[k];
+    for (int k = 0; k < n-1; ++k)
+        xdot[k] = rate*x[k+1];
+    xdot[n-1] = rate*last;
+}
+
+double PadeDelay::calcOutput(const double* x, double u) const
+{
+    double y = _feedthrough*u;
+    for (int k = 0; k < getNumStates(); ++k)
+        y += _gamma[k]*x[k];
+    return y;
+}
+
+void PadeDelay::calcSteadyState(double u, double* x) const
+{
+    int n = getNumStates();
+    for (int k = 0; k < n; ++k)
+        x[k] = 0;
+    if (n > 0)
+        x[0] = u;
+}
@@ -0,0 +1,101 @@
+#ifndef OPENSIM_PadeDelay_H_
+#define OPENSIM_PadeDelay_H_
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim: PadeDelay.h                                  *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+//============================================================================
+// INCLUDE
+//============================================================================
+#include <vector>
+
+
+
+namespace OpenSim {
+
+//=============================================================================
+//=============================================================================
+/**
+ * PadeDelay is a state space realization of the order n Pade approximation
+ * of a transport delay, exp(-s*delay) ~= N(-s*delay)/N(s*delay). It holds no
+ * state of its own: the caller owns the n filter states (for example as
+ * continuous state variables of a component) and asks for their derivatives
+ * and for the filter output.
+ *
+ * The states are scaled so that holding a constant input u the first state
+ * equals u and the others are zero, which keeps them the same size as the
+ * signal being delayed.
+ *
+ * @author  Hjalti Hilmarsson
+ */
+class PadeDelay {
+
+public:
+    /** The largest supported order. Higher orders are badly conditioned. */
+    static const int MaxOrder = 10;
+
+    //--------------------------------------------------------------------------
+    // CONSTRUCTION
+    //--------------------------------------------------------------------------
+    /** Default constructor. A zero delay that passes its input through. */
+    PadeDelay();
+
+    /** Set the delay (seconds) and the order of the approximation. The order
+        is clamped to [1, MaxOrder]; a zero delay needs no states. */
+    void setDelay(double delay, int order);
+
+    /** The number of filter states. */
+    int getNumStates() const { return static_cast<int>(_alpha.size()); }
+    double getDelay() const { return _delay; }
+
+//--------------------------------------------------------------------------
+// EVALUATION
+//--------------------------------------------------------------------------
+    /** Time derivatives of the filter states x for the input u. */
+    void calcDerivatives(const double* x, double u, double* xdot) const;
+    /** The delayed signal for the filter states x and the input u. */
+    double calcOutput(const double* x, double u) const;
+    /** The filter states that hold the output at a constant input u. */
+    void calcSteadyState(double u, double* x) const;
+
+private:
+    //=============================================================================
+    // Private Members
+    //=============================================================================
+    double _delay;
+    // monic denominator coefficients of the delay normalized filter
+    std::vector<double> _alpha;
+    // output coefficients of the scaled states and the direct feedthrough
+    std::vector<double> _gamma;
+    double _feedthrough;
+
+    //=========================================================================
+};  // END of class PadeDelay
+
+}; //namespace
+//=============================================================================
+//=============================================================================
+
+#endif // OPENSIM_PadeDelay_H_
+
+
@@ -0,0 +1,73 @@
+#ifndef OPENSIM_PeriodicSampler_H_
+#define OPENSIM_PeriodicSampler_H_
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim: PeriodicSampler.h                            *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+//============================================================================
+// INCLUDE
+//============================================================================
+#include <functional>
+#include "simbody/internal/EventHandler.h"
+
+
+
+namespace OpenSim {
+
+//=============================================================================
+//=============================================================================
+/**
+ * PeriodicSampler is a SimTK periodic event handler that calls back a
+ * component every interval seconds of simulated time. The integrator stops
+ * exactly at the sample times and only accepted steps reach them, so the
+ * callback sees a uniformly sampled, committed trajectory. The component that
+ * adds the sampler to the system must outlive it, as the model's components
+ * do.
+ *
+ * @author  Hjalti Hilmarsson
+ */
+class PeriodicSampler : public SimTK::PeriodicEventHandler {
+
+public:
+    typedef std::function<void(SimTK::State&)> Callback;
+
+    PeriodicSampler(double interval, const Callback& callback) :
+        SimTK::PeriodicEventHandler(interval), _callback(callback) {}
+
+    void handleEvent(SimTK::State& s, SimTK::Real accuracy,
+                     bool& shouldTerminate) const override
+    {
+        _callback(s);
+    }
+
+private:
+    Callback _callback;
+
+    //=========================================================================
+};  // END of class PeriodicSampler
+
+}; //namespace
+//=============================================================================
+//=============================================================================
+
+#endif // OPENSIM_PeriodicSampler_H_
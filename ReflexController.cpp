@@ -31,6 +31,9 @@
 #include "OpenSim/Simulation/Model/Muscle.h"
 #include "SimpleSpindle.h"
 #include "GolgiTendon.h"
+#include "PeriodicSampler.h"
+#include <chrono>
+#include <unordered_map>
 
 
 // This allows us to use OpenSim functions, classes, etc., without having to
@@ -95,90 +98,68 @@ void ReflexController::constructProperties()
     constructProperty_gain_velocity(1.0);
     constructProperty_spindle_list();
     constructProperty_golgi_list();
+    constructProperty_neural_update_rate(0.0);
     
     _spindleSet.setMemoryOwner(false);
     _golgiSet.setMemoryOwner(false);
+    _neuralUpdateInterval = 0;
 
 }
 
 
-void ReflexController::extendConnectToModel(Model &model)
+/* Resolve a list of component names, or "ALL", to the components of type T
+ * in the model. The components are indexed by name in a single pass, so the
+ * cost is linear in the number of components and names.
+ */
+template <class T>
+static void resolveComponents(const Model& model,
+                              const Property<std::string>& names,
+                              Set<const T>& set)
 {
-    Super::extendConnectToModel(model);
-    
-    // make a delay list that corresponds to each spindel/golgi
-
-    
-    _spindleSet.setMemoryOwner(false);
-    _spindleSet.setSize(0);
-    
-    int nac = getProperty_spindle_list().size();
-    if (nac == 0)
-        return;
+    set.setMemoryOwner(false);
+    set.setSize(0);
     
-    auto spindles = model.getComponentList<SimpleSpindle>();
-    if (IO::Uppercase(get_spindle_list(0)) == "ALL") {
-        for (auto& spindle : spindles) {
-            _spindleSet.adoptAndAppend(&spindle);
-        }
+    int n = names.size();
+    if (n == 0)
         return;
-    }
     
-    else {
-        for (int i = 0; i < nac; i++) {
-            bool found = false;
-            for (auto& spindle : spindles) {
-                if (get_spindle_list(i) == spindle.getName()) {
-                    _spindleSet.adoptAndAppend(&spindle);
-                    found = true;
-                    break;
-                }
-            }
-            if (!found) {
-                cerr << "WARN: ReflexController::connectToModel : SimpleSpindle "
-                << get_spindle_list(i) <<
-                " was not found and will be ignored." << endl;
-            }
-        }
+    bool all = IO::Uppercase(names[0]) == "ALL";
+    std::unordered_map<std::string, const T*> index;
+    for (const T& component : model.getComponentList<T>()) {
+        if (all)
+            set.adoptAndAppend(&component);
+        else
+            index.emplace(component.getName(), &component);
     }
-    
-    
-    
-    _golgiSet.setMemoryOwner(false);
-    _golgiSet.setSize(0);
-    
-    int nac1 = getProperty_golgi_list().size();
-    if (nac1 == 0)
+    if (all)
         return;
     
-    auto golgis = model.getComponentList<GolgiTendon>();
-    if (IO::Uppercase(get_golgi_list(0)) == "ALL") {
-        for (auto& golgi : golgis) {
-            _golgiSet.adoptAndAppend(&golgi);
-        }
-        return;
-    }
-    
-    else {
-        for (int i = 0; i < nac1; i++) {
-            bool found = false;
-            for (auto& golgi : golgis) {
-                if (get_golgi_list(i) == golgi.getName()) {
-                    _golgiSet.adoptAndAppend(&golgi);
-                    found = true;
-                    break;
-                }
-            }
-            if (!found) {
-                cerr << "WARN: ReflexController::connectToModel : GolgiTendon "
-                << get_golgi_list(i) <<
-                " was not found and will be ignored." << endl;
-            }
+    for (int i = 0; i < n; i++) {
+        auto found = index.find(names[i]);
+        if (found == index.end()) {
+            log_warn("ReflexController::connectToModel : {} '{}' was not "
+                     "found and will be ignored.", T::getClassName(), names[i]);
+            continue;
         }
+        set.adoptAndAppend(found->second);
     }
+}
+
+void ReflexController::extendConnectToModel(Model &model)
+{
+    Super::extendConnectToModel(model);
     
+    OPENSIM_THROW_IF_FRMOBJ(get_neural_update_rate() < 0, Exception,
+                            "Expected neural_update_rate to be non-negative.");
+    _neuralUpdateInterval = 0;
+    if (get_neural_update_rate() > 0)
+        _neuralUpdateInterval = 1/get_neural_update_rate();
     
+    auto start = std::chrono::steady_clock::now();
     
+    // the spindle and Golgi lists are resolved independently
+    resolveComponents(model, getProperty_spindle_list(), _spindleSet);
+    resolveComponents(model, getProperty_golgi_list(), _golgiSet);
     
     Set<const Actuator>& actuators = updActuators();
 
@@ -194,6 +175,152 @@ void ReflexController::extendConnectToModel(Model &model)
         }else
             cnt++;
     }
+    
+    double ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+    log_info("ReflexController '{}' connected {} spindles and {} Golgi "
+             "tendon organs in {} ms.", getName(), _spindleSet.getSize(),
+             _golgiSet.getSize(), ms);
+}
+
+/* With a neural update rate the reflexes are evaluated by a periodic event
+ * instead of by computeControls(), so their cost does not depend on the
+ * integrator step size. Set the sampling_rate of the afferents to the same
+ * rate to record their delay histories at the same instants.
+ */
+void ReflexController::extendAddToSystem(SimTK::MultibodySystem& system) const
+{
+    Super::extendAddToSystem(system);
+    
+    // scratch only, so it never needs to be valid
+    _scratchCV = addCacheVariable("scratch", Scratch(), SimTK::Stage::Velocity);
+    
+    if (_neuralUpdateInterval > 0) {
+        system.updDefaultSubsystem().addEventHandler(
+            new PeriodicSampler(_neuralUpdateInterval,
+                [this](SimTK::State& s) { sampleControls(s); }));
+    }
+}
+
+/* Pair the spindles and Golgi tendon organs by the muscle they measure and
+ * resolve the muscle constants and the muscle's slot in the model controls.
+ * The sensors' muscle sockets are only certain to be connected, and the
+ * actuators only get their control indices, once the system is built, so
+ * the channel table is built here. Muscle::addInControls() is probed once
+ * to find the slot.
+ */
+void ReflexController::extendRealizeTopology(SimTK::State& s) const
+{
+    Super::extendRealizeTopology(s);
+    
+    const Set<const SimpleSpindle>& spindles = getSpindleSet();
+    const Set<const GolgiTendon>& golgis = getGolgiSet();
+    
+    _channels.clear();
+    _spindleChannels.clear();
+    _golgiChannels.clear();
+    _channels.reserve(spindles.getSize() + golgis.getSize());
+    std::unordered_map<const Muscle*, int> channelOfMuscle;
+    
+    auto channel = [&](const Muscle& musc) -> Channel& {
+        auto found = channelOfMuscle.find(&musc);
+        if (found != channelOfMuscle.end())
+            return _channels[found->second];
+        channelOfMuscle.emplace(&musc, static_cast<int>(_channels.size()));
+        Channel added;
+        added.muscle = &musc;
+        added.spindle = nullptr;
+        added.golgi = nullptr;
+        added.controlIndex = -1;
+        _channels.push_back(added);
+        return _channels.back();
+    };
+    
+    for (int i = 0; i < spindles.getSize(); i++) {
+        Channel& c = channel(spindles.get(i).getMuscle());
+        if (c.spindle) {
+            log_warn("ReflexController '{}' has more than one spindle on "
+                     "muscle '{}'; '{}' will be ignored.", getName(),
+                     c.muscle->getName(), spindles.get(i).getName());
+            continue;
+        }
+        c.spindle = &spindles.get(i);
+    }
+    for (int i = 0; i < golgis.getSize(); i++) {
+        Channel& c = channel(golgis.get(i).getMuscle());
+        if (c.golgi) {
+            log_warn("ReflexController '{}' has more than one Golgi tendon "
+                     "organ on muscle '{}'; '{}' will be ignored.", getName(),
+                     c.muscle->getName(), golgis.get(i).getName());
+            continue;
+        }
+        c.golgi = &golgis.get(i);
+    }
+    
+    SimTK::Vector probe(getModel().getNumControls(), 0.0);
+    SimTK::Vector unit(1, 1.0);
+    
+    int n = static_cast<int>(_channels.size());
+    _invOptimalFiberLength.assign(n, 0.0);
+    _invMaxSpeed.assign(n, 0.0);
+    _invTendonSlackLength.assign(n, 0.0);
+    
+    for (int i = 0; i < n; i++) {
+        Channel& c = _channels[i];
+        const Muscle& musc = *c.muscle;
+        
+        probe = 0;
+        musc.addInControls(unit, probe);
+        for (int j = 0; j < probe.size(); j++) {
+            if (probe[j] != 0) {
+                c.controlIndex = j;
+                break;
+            }
+        }
+        OPENSIM_THROW_IF_FRMOBJ(c.controlIndex < 0, Exception,
+            "Could not find the control of muscle '" + musc.getName() + "'.");
+        
+        double f_o = musc.getOptimalFiberLength();
+        _invOptimalFiberLength[i] = 1/f_o;
+        _invMaxSpeed[i] = 1/(f_o*musc.getMaxContractionVelocity());
+        _invTendonSlackLength[i] = 1/musc.getTendonSlackLength();
+        
+        if (c.spindle)
+            _spindleChannels.push_back(i);
+        if (c.golgi)
+            _golgiChannels.push_back(i);
+    }
+    
+    // the held controls start at zero, like the delayed afferents; a new
+    // hold must invalidate the controls the model caches at Velocity
+    const SimTK::Subsystem& subsystem = getSystem().getDefaultSubsystem();
+    if (_neuralUpdateInterval > 0) {
+        _heldControlsIndex = subsystem.allocateDiscreteVariable(s,
+                SimTK::Stage::Velocity,
+                new SimTK::Value<SimTK::Vector>(SimTK::Vector(n, 0.0)));
+    }
+    
+    // the gains only enter the controls, which the model caches at Velocity
+    _gainLengthIndex = subsystem.allocateDiscreteVariable(s,
+            SimTK::Stage::Velocity, new SimTK::Value<double>(get_gain_length()));
+    _gainVelocityIndex = subsystem.allocateDiscreteVariable(s,
+            SimTK::Stage::Velocity, new SimTK::Value<double>(get_gain_velocity()));
+}
+
+void ReflexController::extendInitStateFromProperties(SimTK::State& s) const
+{
+    Super::extendInitStateFromProperties(s);
+    
+    setGainLength(s, get_gain_length());
+    setGainVelocity(s, get_gain_velocity());
+}
+
+void ReflexController::extendSetPropertiesFromState(const SimTK::State& s)
+{
+    Super::extendSetPropertiesFromState(s);
+    
+    set_gain_length(getGainLength(s));
+    set_gain_velocity(getGainVelocity(s));
 }
 
 //=============================================================================
@@ -247,6 +374,70 @@ Set <const GolgiTendon>& ReflexController::updGolgis() { return _golgiSet; }
 
 const Set< const GolgiTendon>& ReflexController::getGolgiSet() const { return _golgiSet; }
 
+
+// Checkpoints
+void ReflexController::writeCheckpoint(std::ostream& out,
+                                       const SimTK::State& s) const
+{
+    out << getGainLength(s) << " " << getGainVelocity(s);
+    if (_neuralUpdateInterval > 0) {
+        const SimTK::Vector& held = SimTK::Value<SimTK::Vector>::downcast(
+                getSystem().getDefaultSubsystem()
+                .getDiscreteVariable(s, _heldControlsIndex)).get();
+        out << " " << held.size();
+        for (int i = 0; i < held.size(); i++)
+            out << " " << held[i];
+    }
+    out << "\n";
+}
+
+void ReflexController::readCheckpoint(std::istream& in,
+                                      SimTK::State& s) const
+{
+    double k_l, k_v;
+    OPENSIM_THROW_IF_FRMOBJ(!(in >> k_l >> k_v), Exception,
+                            "Malformed checkpoint.");
+    setGainLength(s, k_l);
+    setGainVelocity(s, k_v);
+    if (_neuralUpdateInterval > 0) {
+        SimTK::Vector& held = SimTK::Value<SimTK::Vector>::updDowncast(
+                getSystem().getDefaultSubsystem()
+                .updDiscreteVariable(s, _heldControlsIndex)).upd();
+        int n;
+        OPENSIM_THROW_IF_FRMOBJ(!(in >> n) || n != held.size(), Exception,
+                "The checkpoint does not fit this controller's channels.");
+        for (int i = 0; i < n; i++)
+            OPENSIM_THROW_IF_FRMOBJ(!(in >> held[i]), Exception,
+                                    "Malformed checkpoint.");
+    }
+}
+
+
+// Gains in the State
+double ReflexController::getGainLength(const SimTK::State& s) const
+{
+    return SimTK::Value<double>::downcast(getSystem().getDefaultSubsystem()
+            .getDiscreteVariable(s, _gainLengthIndex)).get();
+}
+
+void ReflexController::setGainLength(SimTK::State& s, double gain) const
+{
+    SimTK::Value<double>::updDowncast(getSystem().getDefaultSubsystem()
+            .updDiscreteVariable(s, _gainLengthIndex)).upd() = gain;
+}
+
+double ReflexController::getGainVelocity(const SimTK::State& s) const
+{
+    return SimTK::Value<double>::downcast(getSystem().getDefaultSubsystem()
+            .getDiscreteVariable(s, _gainVelocityIndex)).get();
+}
+
+void ReflexController::setGainVelocity(SimTK::State& s, double gain) const
+{
+    SimTK::Value<double>::updDowncast(getSystem().getDefaultSubsystem()
+            .updDiscreteVariable(s, _gainVelocityIndex)).upd() = gain;
+}
+
 //=============================================================================
 // COMPUTATIONS
 //=============================================================================
@@ -254,54 +445,91 @@ const Set< const GolgiTendon>& ReflexController::getGolgiSet() const { return _g
 /**
  * Compute the signals for spindles
  *
+ * The afferents of all channels are gathered into contiguous arrays and the
+ * reflex law is evaluated for all of them by one vectorized kernel.
+ *
  * @param s         current state of the system
- * @param controls  system wide controls to which this component can read off
  */
 
-void ReflexController::computeControls(const State& s,
-                                          Vector &controls) const {
-    // get time
-    double t = s.getTime();
-
-    double t_o = 1;
-    double f_o = 1;
-    double stretch = 0;
-    //reflex control
-    double control = 0;
-    double tendon_length = 0;
-    double speed = 0;
-    double max_speed = 0;
-    double k_l = get_gain_length();
-    double k_v = get_gain_velocity();
+const ReflexController::Scratch&
+ReflexController::calcReflexControls(const State& s) const
+{
+    double k_l = getGainLength(s);
+    double k_v = getGainVelocity(s);
     
-    const Set<const SimpleSpindle>& spindles = getSpindleSet();
-    const Set<const GolgiTendon>& golgis = getGolgiSet();
+    int n = static_cast<int>(_channels.size());
+    Scratch& scratch = updCacheVariableValue(s, _scratchCV);
+    if (scratch.controls.size() != n) {
+        scratch.stretch.assign(n, 0.0);
+        scratch.speed.assign(n, 0.0);
+        scratch.tendonLength.assign(n, 0.0);
+        scratch.controls.assign(n, 0.0);
+    }
+    double* stretch = scratch.stretch.data();
+    double* speed = scratch.speed.data();
+    double* tendon_length = scratch.tendonLength.data();
     
-    // make a for loop for all the spindles and golgi tendon (we assume that the reflex controller employs the same muscles with both a golgi-tendon organ and a spindle)
-    for (int i = 0; i< spindles.getSize(); i++) {
-        const SimpleSpindle& spindle = spindles.get(i);
-        const GolgiTendon& golgi = golgis.get(i);
-        
-        stretch = spindle.getSpindleLength(s);
-        speed = spindle.getSpindleSpeed(s);
-        tendon_length = golgi.getTendonLength(s);
-
-        const Muscle& musc = spindle.getMuscle();
+    // gather the afferents of the channels that have each kind of sensor
+    for (int c : _spindleChannels) {
+        const SimpleSpindle& spindle = *_channels[c].spindle;
+        stretch[c] = spindle.getSpindleLength(s);
+        speed[c] = spindle.getSpindleSpeed(s);
+    }
+    for (int c : _golgiChannels)
+        tendon_length[c] = _channels[c].golgi->getTendonLength(s);
     
-        f_o = musc.getOptimalFiberLength();
-        t_o = musc.getTendonSlackLength();
-        max_speed = f_o*musc.getMaxContractionVelocity();
-        
+    computeReflexControls(n, k_l, k_v, stretch, speed, tendon_length,
+                          _invOptimalFiberLength.data(), _invMaxSpeed.data(),
+                          _invTendonSlackLength.data(),
+                          scratch.controls.data());
+    return scratch;
+}
+
+//_____________________________________________________________________________
+/**
+ * Evaluate the reflexes at the neural update event and hold their controls
+ * in the discrete state until the next one
+ *
+ * @param s         current state of the system
+ */
+
+void ReflexController::sampleControls(State& s) const
+{
+    getSystem().realize(s, SimTK::Stage::Velocity);
+    const double* control = calcReflexControls(s).controls.data();
     
-        control = 0.5*k_l*(fabs(stretch)+stretch)/f_o;
-        control += 0.5*k_v*(fabs(speed)+speed)/max_speed;
-        control += 0.5*k_l*(fabs(tendon_length)+tendon_length)/t_o;
-        
+    Vector& held = Value<Vector>::updDowncast(getSystem().getDefaultSubsystem()
+            .updDiscreteVariable(s, _heldControlsIndex)).upd();
+    for (int i = 0; i < held.size(); i++)
+        held[i] = control[i];
+}
 
-        SimTK::Vector actControls(1,control);
-        // add reflex controls to whatever controls are already in place.
-        // make a member function to get the refernce of the spindles that have the referneces to the muscles
-        musc.addInControls(actControls, controls);
+//_____________________________________________________________________________
+/**
+ * Compute the signals for spindles
+ *
+ * Without a neural update rate the reflexes are evaluated on every call;
+ * with one, the controls held since the last update are applied.
+ *
+ * @param s         current state of the system
+ * @param controls  system wide controls to which this component can read off
+ */
+
+void ReflexController::computeControls(const State& s,
+                                          Vector &controls) const {
+    int n = static_cast<int>(_channels.size());
+    
+    const double* control;
+    if (_neuralUpdateInterval > 0) {
+        control = Value<Vector>::downcast(getSystem().getDefaultSubsystem()
+                .getDiscreteVariable(s, _heldControlsIndex)).get()
+                .getContiguousScalarData();
     }
+    else {
+        control = calcReflexControls(s).controls.data();
+    }
+    
+    // add reflex controls to whatever controls are already in place.
+    for (int i = 0; i < n; i++)
+        controls[_channels[i].controlIndex] += control[i];
 }
-
@@ -30,6 +30,8 @@
 #include "osimReflexControllerDLL.h"
 #include "OpenSim/Simulation/Control/Controller.h"
 #include "OpenSim/Simulation/Model/Muscle.h"
+#include "ReflexKernel.h"
+#include <vector>
 
 
 
@@ -67,6 +69,7 @@ public:
     OpenSim_DECLARE_PROPERTY(gain_velocity, double, "The factor by which the stretch reflex speed is scaled");
     OpenSim_DECLARE_LIST_PROPERTY(spindle_list, std::string, "The list of model spindles that this controller will depend upond for control");
         OpenSim_DECLARE_LIST_PROPERTY(golgi_list, std::string, "The list of model golgi-tendons that this controller will depend upond for control");
+    OpenSim_DECLARE_PROPERTY(neural_update_rate, double, "The rate (Hz) at which the reflexes are evaluated and their controls held in between; 0 evaluates them whenever the controls are computed");
 
 //==============================================================================
 // SOCKETS
@@ -121,6 +124,42 @@ public:
      */
     void computeControls(const SimTK::State& s,
                          SimTK::Vector &controls) const override;
+    
+    //--------------------------------------------------------------------------
+    // Gains in the State
+    //--------------------------------------------------------------------------
+    /** The gains are kept in the State and initialized from the properties,
+        so a State copy can be given other gains without rebuilding the
+        system. */
+    double getGainLength(const SimTK::State& s) const;
+    void setGainLength(SimTK::State& s, double gain) const;
+    double getGainVelocity(const SimTK::State& s) const;
+    void setGainVelocity(SimTK::State& s, double gain) const;
+    
+    //--------------------------------------------------------------------------
+    // Checkpoints
+    //--------------------------------------------------------------------------
+    /** Write what this controller keeps in s: its gains and held controls.
+        Used by StateCheckpoint. */
+    void writeCheckpoint(std::ostream& out, const SimTK::State& s) const;
+    /** Read what writeCheckpoint() wrote into s. */
+    void readCheckpoint(std::istream& in, SimTK::State& s) const;
+    
+    //--------------------------------------------------------------------------
+    // Channels
+    //--------------------------------------------------------------------------
+    /** The sensors of one controlled muscle and its slot in the model
+        controls, resolved once so that evaluation does no lookups. A channel
+        has a spindle, a Golgi tendon organ or both. */
+    struct Channel {
+        const Muscle* muscle;
+        const SimpleSpindle* spindle;
+        const GolgiTendon* golgi;
+        int controlIndex;
+    };
+    /** The channels in the order of the reflex controls, known once the
+        system is built. */
+    const std::vector<Channel>& getChannels() const { return _channels; }
 
 
 private:
@@ -128,12 +167,57 @@ private:
     void constructProperties();
     // ModelComponent interface to connect this component to its model
     void extendConnectToModel(Model& aModel) override;
+    // ModelComponent interface to add the neural update event to the system
+    void extendAddToSystem(SimTK::MultibodySystem& system) const override;
+    // build the reflex evaluation plan once actuators have control indices
+    void extendRealizeTopology(SimTK::State& s) const override;
+    // initialize the gains in the State from the properties
+    void extendInitStateFromProperties(SimTK::State& s) const override;
+    // copy the gains in the State back to the properties
+    void extendSetPropertiesFromState(const SimTK::State& s) override;
+    
+    // arrays for gathering the afferents and computing the controls. They
+    // are kept in each State, so that simulations on different States can
+    // run concurrently; the afferents of missing sensors stay zero.
+    struct Scratch {
+        AlignedArray stretch;
+        AlignedArray speed;
+        AlignedArray tendonLength;
+        AlignedArray controls;
+    };
+    mutable CacheVariable<Scratch> _scratchCV;
+    
+    // evaluate the reflex law for every channel into the controls of the
+    // State's scratch, which is returned
+    const Scratch& calcReflexControls(const SimTK::State& s) const;
+    // sample the afferents and hold the controls at the neural update event
+    void sampleControls(SimTK::State& s) const;
 
     // the set of Model spindles that this controller controls
     Set<const SimpleSpindle> _spindleSet;
     
     Set<const GolgiTendon> _golgiSet;
     
+    mutable std::vector<Channel> _channels;
+    // the channels that have a spindle and those that have a Golgi organ
+    mutable std::vector<int> _spindleChannels;
+    mutable std::vector<int> _golgiChannels;
+    
+    // the reciprocal normalizers of each channel, laid out for
+    // computeReflexControls()
+    mutable AlignedArray _invOptimalFiberLength;
+    mutable AlignedArray _invMaxSpeed;
+    mutable AlignedArray _invTendonSlackLength;
+    
+    // the period of the neural update, or zero when it is not used, and the
+    // discrete state holding the controls of each channel between updates
+    double _neuralUpdateInterval;
+    mutable SimTK::DiscreteVariableIndex _heldControlsIndex;
+    
+    // the gains in the State
+    mutable SimTK::DiscreteVariableIndex _gainLengthIndex;
+    mutable SimTK::DiscreteVariableIndex _gainVelocityIndex;
+    
     
 protected:
     double _normalizedRestLength;
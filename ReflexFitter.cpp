@@ -0,0 +1,395 @@
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim:  ReflexFitter.cpp                            *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+
+//=============================================================================
+// INCLUDES
+//=============================================================================
+#include "ReflexFitter.h"
+#include <OpenSim/OpenSim.h>
+#include "CMAES.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+
+
+using namespace OpenSim;
+using namespace std;
+
+
+static const char* ParameterNames[ReflexFitter::NumParameters] = {
+    "gain_length", "gain_velocity", "normalized_rest_length", "delay",
+    "golgi_delay"
+};
+
+//=============================================================================
+// CONSTRUCTOR(S)
+//=============================================================================
+//_____________________________________________________________________________
+ReflexFitter::ReflexFitter(const ReflexReplay& replay, int numThreads) :
+    _replay(replay),
+    _pool(numThreads),
+    _outputs(_pool.getNumThreads()),
+    _numSamples(0)
+{
+    setBounds(GainLength, 0, 10);
+    setBounds(GainVelocity, 0, 10);
+    setBounds(NormalizedRestLength, 0.5, 1.5);
+    setBounds(Delay, 0, 0.1);
+    setBounds(GolgiDelay, 0, 0.1);
+    for (int p = 0; p < NumParameters; ++p)
+        _fixed[p] = p == NormalizedRestLength;
+}
+
+//=============================================================================
+// PARAMETERS
+//=============================================================================
+const char* ReflexFitter::getParameterName(Parameter p)
+{
+    return ParameterNames[p];
+}
+
+ReflexFitter::Parameter ReflexFitter::findParameter(const std::string& name)
+{
+    for (int p = 0; p < NumParameters; ++p)
+        if (name == ParameterNames[p])
+            return Parameter(p);
+    return NumParameters;
+}
+
+void ReflexFitter::setBounds(Parameter p, double lower, double upper)
+{
+    OPENSIM_THROW_IF(!(lower < upper), Exception,
+                     "Expected the lower bound of " +
+                     std::string(ParameterNames[p]) +
+                     " to be less than the upper.");
+    _lower[p] = lower;
+    _upper[p] = upper;
+}
+
+double ReflexFitter::get(const ReflexReplay::Parameters& p, Parameter which)
+{
+    switch (which) {
+    case GainLength:            return p.gainLength;
+    case GainVelocity:          return p.gainVelocity;
+    case NormalizedRestLength:  return p.normalizedRestLength;
+    case Delay:                 return p.delay;
+    default:                    return p.golgiDelay;
+    }
+}
+
+void ReflexFitter::set(ReflexReplay::Parameters& p, Parameter which,
+                       double value)
+{
+    switch (which) {
+    case GainLength:            p.gainLength = value; break;
+    case GainVelocity:          p.gainVelocity = value; break;
+    case NormalizedRestLength:  p.normalizedRestLength = value; break;
+    case Delay:                 p.delay = value; break;
+    default:                    p.golgiDelay = value; break;
+    }
+}
+
+//=============================================================================
+// DATA
+//=============================================================================
+/* The column of a channel's recording: its excitation, as a SignalRecorder
+ * labels it, or one named after the muscle, by name or by a path ending in
+ * the name. */
+static int findEmgColumn(const std::vector<std::string>& labels,
+                         const std::string& muscle)
+{
+    const std::string names[] = { muscle + "|excitation", muscle };
+    for (const std::string& name : names) {
+        for (size_t j = 0; j < labels.size(); ++j) {
+            const std::string& label = labels[j];
+            if (label == name)
+                return (int)j;
+            if (label.size() > name.size() &&
+                    label.compare(label.size() - name.size(), name.size(),
+                                  name) == 0 &&
+                    label[label.size() - name.size() - 1] == '/')
+                return (int)j;
+        }
+    }
+    return -1;
+}
+
+void ReflexFitter::addTrial(ReplayTrial trial, const TimeSeriesTable& emg)
+{
+    const std::vector<double>& emgTime = emg.getIndependentColumn();
+    OPENSIM_THROW_IF(emgTime.empty(), Exception,
+                     "Expected the EMG to have rows.");
+
+    Trial t;
+    t.trial = std::move(trial);
+
+    const std::vector<std::string> labels = emg.getColumnLabels();
+    std::vector<int> columns;
+    const std::vector<std::string>& names = _replay.getChannelNames();
+    for (int c = 0; c < (int)names.size(); ++c) {
+        int column = findEmgColumn(labels, names[c]);
+        if (column >= 0) {
+            t.channels.push_back(c);
+            columns.push_back(column);
+        }
+    }
+    OPENSIM_THROW_IF(t.channels.empty(), Exception,
+                     "The EMG has no column for any of the " +
+                     to_string(names.size()) + " muscles of the controller.");
+
+    // the frames within the recording
+    const std::vector<double>& time = t.trial.time;
+    t.firstFrame = 0;
+    while (t.firstFrame < t.trial.getNumFrames() &&
+           time[t.firstFrame] < emgTime.front())
+        ++t.firstFrame;
+    t.lastFrame = t.trial.getNumFrames() - 1;
+    while (t.lastFrame >= t.firstFrame && time[t.lastFrame] > emgTime.back())
+        --t.lastFrame;
+    OPENSIM_THROW_IF(t.lastFrame < t.firstFrame, Exception,
+                     "The EMG does not overlap the trial in time.");
+
+    const int m = (int)t.channels.size();
+    const auto& values = emg.getMatrix();
+    t.emg.resize((size_t)(t.lastFrame - t.firstFrame + 1)*m);
+    int row = 0;
+    for (int i = t.firstFrame; i <= t.lastFrame; ++i) {
+        while (row + 2 < (int)emgTime.size() && emgTime[row + 1] <= time[i])
+            ++row;
+        const int next = std::min(row + 1, (int)emgTime.size() - 1);
+        const double dt = emgTime[next] - emgTime[row];
+        const double w = dt > 0 ? (time[i] - emgTime[row])/dt : 0;
+        double* to = &t.emg[(size_t)(i - t.firstFrame)*m];
+        for (int j = 0; j < m; ++j)
+            to[j] = (1 - w)*values(row, columns[j]) +
+                    w*values(next, columns[j]);
+    }
+
+    _numSamples += (long long)(t.lastFrame - t.firstFrame + 1)*m;
+    _trials.push_back(std::move(t));
+}
+
+//=============================================================================
+// FITTING
+//=============================================================================
+/* The trials are replayed one at a time, so a candidate can be stopped
+ * between them. */
+double ReflexFitter::calcError(const ReflexReplay::Parameters& p,
+                               double limit, ReplayOutput& output,
+                               int& replays, bool& terminated) const
+{
+    double sse = 0;
+    terminated = false;
+    for (size_t n = 0; n < _trials.size(); ++n) {
+        const Trial& t = _trials[n];
+        _replay.evaluate(t.trial, p, output);
+        ++replays;
+
+        const int m = (int)t.channels.size();
+        for (int i = t.firstFrame; i <= t.lastFrame; ++i) {
+            const double* u = output.controls.data() + i*output.stride;
+            const double* e = &t.emg[(size_t)(i - t.firstFrame)*m];
+            for (int j = 0; j < m; ++j) {
+                const double d = u[t.channels[j]] - e[j];
+                sse += d*d;
+            }
+        }
+
+        if (sse > limit && n + 1 < _trials.size()) {
+            terminated = true;
+            break;
+        }
+    }
+    return sse;
+}
+
+double ReflexFitter::calcCost(const ReflexReplay::Parameters& p) const
+{
+    OPENSIM_THROW_IF(_numSamples == 0, Exception, "No trials to fit.");
+
+    ReplayOutput output;
+    int replays = 0;
+    bool terminated;
+    return calcError(p, numeric_limits<double>::infinity(), output, replays,
+                     terminated)/_numSamples;
+}
+
+/* The optimizer sees every free parameter scaled to [0, 1] between its
+ * bounds, so that one step size suits them all. A candidate outside the
+ * bounds is replayed at the nearest point within them and its cost
+ * increased by the squared distance to it, which leads the distribution
+ * back inside.
+ */
+ReflexFitter::Result
+ReflexFitter::fit(const ReflexReplay::Parameters& initial) const
+{
+    OPENSIM_THROW_IF(_numSamples == 0, Exception, "No trials to fit.");
+
+    std::vector<Parameter> free;
+    for (int p = 0; p < NumParameters; ++p)
+        if (!_fixed[p])
+            free.push_back(Parameter(p));
+    OPENSIM_THROW_IF(free.empty(), Exception, "Every parameter is fixed.");
+    const int n = (int)free.size();
+
+    auto toParameters = [&](const std::vector<double>& x, double& penalty) {
+        ReflexReplay::Parameters p = initial;
+        penalty = 0;
+        for (int j = 0; j < n; ++j) {
+            const double clamped = std::min(std::max(x[j], 0.0), 1.0);
+            penalty += (x[j] - clamped)*(x[j] - clamped);
+            const Parameter which = free[j];
+            set(p, which, _lower[which] +
+                          clamped*(_upper[which] - _lower[which]));
+        }
+        return p;
+    };
+
+    std::vector<double> x0(n);
+    for (int j = 0; j < n; ++j) {
+        const Parameter which = free[j];
+        x0[j] = std::min(std::max((get(initial, which) - _lower[which])/
+                                  (_upper[which] - _lower[which]), 0.0), 1.0);
+    }
+    CMAES cmaes(x0, _settings.initialStep, _settings.populationSize,
+                _settings.seed);
+    const int lambda = cmaes.getPopulationSize();
+
+    Result result;
+    result.converged = false;
+    result.generations = 0;
+    result.evaluations = 0;
+    result.terminated = 0;
+    result.replays = 0;
+
+    const int mu = cmaes.getNumParents();
+    std::vector<double> costs(lambda);
+    std::vector<double> errors(lambda);
+    std::vector<double> penalties(lambda);
+    std::vector<int> replays(lambda);
+    std::vector<char> terminated(lambda);
+    // whether the cost of a candidate is only a lower bound
+    std::vector<char> partial(lambda);
+    std::vector<int> order(lambda);
+    std::vector<int> unfinished;
+    // no candidate is stopped before a generation has set the limit
+    double limit = numeric_limits<double>::infinity();
+
+    const auto start = std::chrono::steady_clock::now();
+    auto last = start;
+    while (cmaes.getGeneration() < _settings.maxGenerations) {
+        const std::vector<std::vector<double>>& population = cmaes.ask();
+
+        _pool.run(lambda, [&](int worker, int k) {
+            const ReflexReplay::Parameters p =
+                    toParameters(population[k], penalties[k]);
+            replays[k] = 0;
+            bool stopped;
+            errors[k] = calcError(p, limit, _outputs[worker], replays[k],
+                                  stopped);
+            terminated[k] = stopped;
+            partial[k] = stopped;
+            costs[k] = errors[k]/_numSamples + penalties[k];
+        });
+
+        // the cost of a stopped candidate is a lower bound, so one that
+        // ranks among the parents is replayed in full, until the parents
+        // all have their full costs
+        for (;;) {
+            for (int k = 0; k < lambda; ++k)
+                order[k] = k;
+            // in the order in which CMAES::tell() ranks them
+            std::stable_sort(order.begin(), order.end(),
+                    [&](int a, int b) { return costs[a] < costs[b]; });
+            unfinished.clear();
+            for (int r = 0; r < mu; ++r)
+                if (partial[order[r]])
+                    unfinished.push_back(order[r]);
+            if (unfinished.empty())
+                break;
+
+            _pool.run((int)unfinished.size(), [&](int worker, int j) {
+                const int k = unfinished[j];
+                const ReflexReplay::Parameters p =
+                        toParameters(population[k], penalties[k]);
+                bool stopped;
+                errors[k] = calcError(p, numeric_limits<double>::infinity(),
+                                      _outputs[worker], replays[k], stopped);
+                partial[k] = false;
+                costs[k] = errors[k]/_numSamples + penalties[k];
+            });
+        }
+        cmaes.tell(costs);
+
+        int numTerminated = 0;
+        int numReplays = 0;
+        for (int k = 0; k < lambda; ++k) {
+            numTerminated += terminated[k];
+            numReplays += replays[k];
+        }
+        result.evaluations += lambda;
+        result.terminated += numTerminated;
+        result.replays += numReplays;
+
+        // the next generation's candidates are stopped once their error,
+        // without the bound penalty, exceeds that of the worst parent
+        if (_settings.earlyTermination) {
+            double worst = 0;
+            for (int r = 0; r < mu; ++r)
+                worst = std::max(worst, errors[order[r]]);
+            limit = worst;
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        const double seconds = std::chrono::duration<double>(now - last)
+                                .count();
+        last = now;
+        if (_settings.verbose)
+            log_info("Generation {}: best cost {}, step {}, {} of {} "
+                     "stopped early, {} evaluations/s, {} replays/s",
+                     cmaes.getGeneration(), cmaes.getBestCost(),
+                     cmaes.getSigma(), numTerminated, lambda,
+                     lambda/seconds, numReplays/seconds);
+
+        if (cmaes.hasConverged(_settings.parameterTolerance,
+                               _settings.costTolerance)) {
+            result.converged = true;
+            break;
+        }
+    }
+    result.generations = cmaes.getGeneration();
+    result.seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+
+    // the best candidate may have been stopped early, so its cost is
+    // computed in full
+    double penalty;
+    result.parameters = toParameters(cmaes.getBest(), penalty);
+    result.cost = calcCost(result.parameters);
+    return result;
+}
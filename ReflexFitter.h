@@ -0,0 +1,211 @@
+#ifndef OPENSIM_ReflexFitter_H_
+#define OPENSIM_ReflexFitter_H_
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim: ReflexFitter.h                               *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+//============================================================================
+// INCLUDE
+//============================================================================
+#include "ReflexReplay.h"
+#include "WorkStealingPool.h"
+#include <string>
+#include <vector>
+
+
+
+namespace OpenSim {
+
+//=============================================================================
+//=============================================================================
+/**
+ * ReflexFitter estimates the parameters of a ReflexController from recorded
+ * trials: the gains, the normalized rest length and the delays of the
+ * spindles and of the Golgi tendon organs that make its reflex controls
+ * best match recorded EMG or excitations. The cost of a parameter set is
+ * the mean squared difference between the controls and the recording over
+ * every channel that has a recording and every frame of every trial.
+ *
+ * The parameters are found with CMAES, in coordinates scaled to their
+ * bounds. Every candidate is evaluated by replaying the trials open loop
+ * with ReflexReplay, and the candidates of a generation are replayed in
+ * parallel by a WorkStealingPool, each worker into its own ReplayOutput.
+ * A candidate whose error after some of the trials already exceeds the
+ * error of the worst parent of the previous generation is not replayed
+ * further and ranked by that lower bound. If the bound still ranks it
+ * among the parents of its own generation, it is replayed in full, so
+ * that every parent is ranked by its full cost.
+ *
+ * @code
+ * ReflexFitter fitter(replay);
+ * fitter.addTrial(replay.createTrial(kinematics), emg);
+ * fitter.setFixed(ReflexFitter::NormalizedRestLength, true);
+ * ReflexFitter::Result result = fitter.fit(replay.getDefaultParameters());
+ * @endcode
+ *
+ * @author  Hjalti Hilmarsson
+ */
+class ReflexFitter {
+
+public:
+    /** The parameters that can be fitted. */
+    enum Parameter {
+        GainLength,
+        GainVelocity,
+        NormalizedRestLength,
+        Delay,
+        GolgiDelay,
+        NumParameters
+    };
+    /** The name of p as in ReflexController's properties, such as
+        "gain_length", or "golgi_delay". */
+    static const char* getParameterName(Parameter p);
+    /** The parameter named name, or NumParameters if there is none. */
+    static Parameter findParameter(const std::string& name);
+
+    /** How the optimizer runs. The step and tolerance are fractions of the
+        range between the bounds of the parameters. */
+    struct Settings {
+        int populationSize;
+        int maxGenerations;
+        double initialStep;
+        double parameterTolerance;
+        double costTolerance;
+        unsigned seed;
+        bool earlyTermination;
+        bool verbose;
+
+        Settings() :
+            populationSize(0),
+            maxGenerations(200),
+            initialStep(0.3),
+            parameterTolerance(1.0e-4),
+            costTolerance(1.0e-10),
+            seed(0),
+            earlyTermination(true),
+            verbose(true) {}
+    };
+
+    /** The outcome of fit(): the best parameters found and their cost, and
+        what it took to find them. */
+    struct Result {
+        ReflexReplay::Parameters parameters;
+        double cost;
+        bool converged;
+        int generations;
+        long long evaluations;
+        // the candidates stopped early and the trial replays run
+        long long terminated;
+        long long replays;
+        double seconds;
+    };
+
+    /** Fit with replay on numThreads threads, or on one per hardware thread
+        when numThreads is not positive. replay must outlive the fitter. */
+    explicit ReflexFitter(const ReflexReplay& replay, int numThreads = 0);
+
+    int getNumThreads() const { return _pool.getNumThreads(); }
+
+    //--------------------------------------------------------------------------
+    // DATA
+    //--------------------------------------------------------------------------
+    /** Fit to the recording emg of trial, which is kept; pass it with
+        std::move() when the caller is done with it. A channel is
+        matched by a column <muscle>|excitation, as a SignalRecorder names
+        it, or <muscle>, <muscle> being the path or the name of the muscle;
+        channels without a column are not fitted. emg is interpolated
+        linearly at the frames of trial, and frames outside its time range
+        are left out. */
+    void addTrial(ReplayTrial trial, const TimeSeriesTable& emg);
+    int getNumTrials() const { return (int)_trials.size(); }
+
+    //--------------------------------------------------------------------------
+    // PARAMETERS
+    //--------------------------------------------------------------------------
+    /** Bound p to [lower, upper]. */
+    void setBounds(Parameter p, double lower, double upper);
+    double getLowerBound(Parameter p) const { return _lower[p]; }
+    double getUpperBound(Parameter p) const { return _upper[p]; }
+    /** Keep p at its initial value instead of fitting it. By default the
+        gains and the delays are fitted and the rest length is not. */
+    void setFixed(Parameter p, bool fixed) { _fixed[p] = fixed; }
+    bool isFixed(Parameter p) const { return _fixed[p]; }
+
+    const Settings& getSettings() const { return _settings; }
+    Settings& updSettings() { return _settings; }
+
+    //--------------------------------------------------------------------------
+    // FITTING
+    //--------------------------------------------------------------------------
+    /** The cost of p over all trials. */
+    double calcCost(const ReflexReplay::Parameters& p) const;
+
+    /** Fit the parameters that are not fixed starting from initial, which
+        also gives the fixed ones, until the optimizer converges or
+        maxGenerations have run. */
+    Result fit(const ReflexReplay::Parameters& initial) const;
+
+private:
+    // a trial and the recording of the channels that have one, at each of
+    // the frames from firstFrame to lastFrame, frame-major
+    struct Trial {
+        ReplayTrial trial;
+        std::vector<int> channels;
+        int firstFrame;
+        int lastFrame;
+        std::vector<double> emg;
+    };
+
+    // the sum of squared errors of p over the trials, stopping with a lower
+    // bound once it exceeds limit after a trial, which sets terminated;
+    // counts the trials replayed
+    double calcError(const ReflexReplay::Parameters& p, double limit,
+                     ReplayOutput& output, int& replays,
+                     bool& terminated) const;
+
+    static double get(const ReflexReplay::Parameters& p, Parameter which);
+    static void set(ReflexReplay::Parameters& p, Parameter which,
+                    double value);
+
+    const ReflexReplay& _replay;
+    WorkStealingPool _pool;
+    // what each worker replays into
+    mutable std::vector<ReplayOutput> _outputs;
+
+    std::vector<Trial> _trials;
+    // the number of recorded samples of all trials
+    long long _numSamples;
+
+    double _lower[NumParameters];
+    double _upper[NumParameters];
+    bool _fixed[NumParameters];
+    Settings _settings;
+
+    //=========================================================================
+};  // END of class ReflexFitter
+
+}; //namespace
+//=============================================================================
+//=============================================================================
+
+#endif // OPENSIM_ReflexFitter_H_
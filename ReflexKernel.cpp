@@ -0,0 +1,112 @@
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim:  ReflexKernel.cpp                            *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+
+//=============================================================================
+// INCLUDES
+//=============================================================================
+#include "ReflexKernel.h"
+#include <algorithm>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+
+
+using namespace OpenSim;
+using namespace std;
+
+
+//=============================================================================
+// KERNELS
+//=============================================================================
+/* The arrays are padded to whole vectors, so every path below runs over
+ * complete vectors. FMA is not used, so the vector paths round exactly like
+ * the scalar one. */
+
+#if defined(__AVX512F__)
+
+void OpenSim::computeReflexControls(int n, double k_l, double k_v,
+        const double* stretch, const double* speed, const double* tendon,
+        const double* invLength, const double* invSpeed,
+        const double* invTendon, double* controls)
+{
+    const __m512d zero = _mm512_setzero_pd();
+    const __m512d kl = _mm512_set1_pd(k_l);
+    const __m512d kv = _mm512_set1_pd(k_v);
+    for (int i = 0; i < n; i += 8) {
+        __m512d a = _mm512_max_pd(_mm512_load_pd(stretch + i), zero);
+        __m512d b = _mm512_max_pd(_mm512_load_pd(speed + i), zero);
+        __m512d c = _mm512_max_pd(_mm512_load_pd(tendon + i), zero);
+        a = _mm512_mul_pd(_mm512_mul_pd(kl, a), _mm512_load_pd(invLength + i));
+        b = _mm512_mul_pd(_mm512_mul_pd(kv, b), _mm512_load_pd(invSpeed + i));
+        c = _mm512_mul_pd(_mm512_mul_pd(kl, c), _mm512_load_pd(invTendon + i));
+        _mm512_store_pd(controls + i, _mm512_add_pd(_mm512_add_pd(a, b), c));
+    }
+}
+
+const char* OpenSim::getReflexKernelName() { return "avx512"; }
+
+#elif defined(__AVX2__)
+
+void OpenSim::computeReflexControls(int n, double k_l, double k_v,
+        const double* stretch, const double* speed, const double* tendon,
+        const double* invLength, const double* invSpeed,
+        const double* invTendon, double* controls)
+{
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d kl = _mm256_set1_pd(k_l);
+    const __m256d kv = _mm256_set1_pd(k_v);
+    for (int i = 0; i < n; i += 4) {
+        __m256d a = _mm256_max_pd(_mm256_load_pd(stretch + i), zero);
+        __m256d b = _mm256_max_pd(_mm256_load_pd(speed + i), zero);
+        __m256d c = _mm256_max_pd(_mm256_load_pd(tendon + i), zero);
+        a = _mm256_mul_pd(_mm256_mul_pd(kl, a), _mm256_load_pd(invLength + i));
+        b = _mm256_mul_pd(_mm256_mul_pd(kv, b), _mm256_load_pd(invSpeed + i));
+        c = _mm256_mul_pd(_mm256_mul_pd(kl, c), _mm256_load_pd(invTendon + i));
+        _mm256_store_pd(controls + i, _mm256_add_pd(_mm256_add_pd(a, b), c));
+    }
+}
+
+const char* OpenSim::getReflexKernelName() { return "avx2"; }
+
+#else
+
+void OpenSim::computeReflexControls(int n, double k_l, double k_v,
+        const double* stretch, const double* speed, const double* tendon,
+        const double* invLength, const double* invSpeed,
+        const double* invTendon, double* controls)
+{
+    for (int i = 0; i < n; ++i) {
+        double a = k_l*max(stretch[i], 0.0)*invLength[i];
+        double b = k_v*max(speed[i], 0.0)*invSpeed[i];
+        double c = k_l*max(tendon[i], 0.0)*invTendon[i];
+        controls[i] = (a + b) + c;
+    }
+}
+
+const char* OpenSim::getReflexKernelName() { return "scalar"; }
+
+#endif
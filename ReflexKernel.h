@@ -0,0 +1,138 @@
+#ifndef OPENSIM_ReflexKernel_H_
+#define OPENSIM_ReflexKernel_H_
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim: ReflexKernel.h                               *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+//============================================================================
+// INCLUDE
+//============================================================================
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+
+namespace OpenSim {
+
+//=============================================================================
+//=============================================================================
+/**
+ * A resizable array of doubles whose data is aligned for the widest SIMD
+ * loads (64 bytes) and padded to a whole number of vectors.
+ */
+class AlignedArray {
+
+public:
+    static const int Alignment = 64;
+    static const int Width = Alignment/sizeof(double);
+
+    AlignedArray() : _size(0) {}
+
+    /** Copies hold the same values at their own aligned position. */
+    AlignedArray(const AlignedArray& other) : _size(0) { *this = other; }
+    AlignedArray& operator=(const AlignedArray& other)
+    {
+        if (this == &other)
+            return *this;
+        // a new buffer may sit at another offset from the alignment
+        if (_storage.size() != other._storage.size())
+            _storage.assign(other._storage.size(), 0.0);
+        _size = other._size;
+        std::copy(other.data(), other.data() + other.padded(), data());
+        return *this;
+    }
+    // moving keeps the buffer, and with it the offset
+    AlignedArray(AlignedArray&& other) = default;
+    AlignedArray& operator=(AlignedArray&& other) = default;
+
+    /** Resize to n values, all set to value. */
+    void assign(int n, double value)
+    {
+        _size = n;
+        int padded = (n + Width - 1)/Width*Width;
+        _storage.assign(padded + Width, 0.0);
+        double* p = data();
+        for (int i = 0; i < padded; ++i)
+            p[i] = i < n ? value : 0.0;
+    }
+
+    int size() const { return _size; }
+
+    // the storage is reallocated by resizes and copies, so align on every
+    // access
+    double* data() { return align(_storage.data()); }
+    const double* data() const {
+        return align(const_cast<double*>(_storage.data())); }
+
+    double& operator[](int i) { return data()[i]; }
+    double operator[](int i) const { return data()[i]; }
+
+private:
+    // the values and the zero padding after them
+    int padded() const
+    {   return _storage.empty() ? 0 : (int)_storage.size() - Width; }
+
+    static double* align(double* p)
+    {
+        std::uintptr_t a = reinterpret_cast<std::uintptr_t>(p);
+        a = (a + Alignment - 1) & ~std::uintptr_t(Alignment - 1);
+        return reinterpret_cast<double*>(a);
+    }
+
+    std::vector<double> _storage;
+    int _size;
+};
+
+/**
+ * The reflex law of ReflexController for n muscles at once:
+ *
+ *   control = k_l*max(stretch, 0)*invLength + k_v*max(speed, 0)*invSpeed
+ *           + k_l*max(tendon, 0)*invTendon
+ *
+ * where max(x, 0) = 0.5*(|x| + x) is the rectified afferent signal and the
+ * inv* arrays hold the reciprocal normalizers of each muscle. All arrays are
+ * structure-of-arrays, 64 byte aligned and padded to a multiple of
+ * AlignedArray::Width. The kernel uses AVX-512 or AVX2 when the library is
+ * compiled for them and a scalar loop otherwise; all paths round the same.
+ */
+void computeReflexControls(int n, double k_l, double k_v,
+                           const double* stretch,
+                           const double* speed,
+                           const double* tendon,
+                           const double* invLength,
+                           const double* invSpeed,
+                           const double* invTendon,
+                           double* controls);
+
+/** The instruction set computeReflexControls was compiled for. */
+const char* getReflexKernelName();
+
+}; //namespace
+//=============================================================================
+//=============================================================================
+
+#endif // OPENSIM_ReflexKernel_H_
+
+
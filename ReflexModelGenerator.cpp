@@ -0,0 +1,169 @@
+/* -------------------------------------------------------------------------- *
+ *                   OpenSim:  ReflexModelGenerator.cpp                       *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+
+//=============================================================================
+// INCLUDES
+//=============================================================================
+#include "ReflexModelGenerator.h"
+#include <OpenSim/OpenSim.h>
+#include "SimpleSpindle.h"
+#include "GolgiTendon.h"
+#include "DelayBank.h"
+#include "MuscleSensorSnapshot.h"
+#include "ReflexController.h"
+
+
+
+using namespace OpenSim;
+using namespace std;
+using namespace SimTK;
+
+
+//=============================================================================
+// TOPOLOGY
+//=============================================================================
+ReflexModelSpec::Topology ReflexModelSpec::parseTopology(const std::string& name)
+{
+    string lower = IO::Lowercase(name);
+    if (lower == "parallel")
+        return Parallel;
+    if (lower == "chain")
+        return Chain;
+    if (lower == "tree")
+        return Tree;
+    OPENSIM_THROW(Exception, "Unknown topology '" + name + "'; expected "
+                  "'parallel', 'chain' or 'tree'.");
+}
+
+std::string ReflexModelSpec::getTopologyName(Topology topology)
+{
+    switch (topology) {
+    case Chain:
+        return "chain";
+    case Tree:
+        return "tree";
+    default:
+        return "parallel";
+    }
+}
+
+//=============================================================================
+// GENERATOR
+//=============================================================================
+/* Every block slides along the z axis of what it slides on: both frames of
+ * its slider joint are rotated by Vec3(0, Pi/2, 0), which turns the joint's
+ * x axis onto z. A muscle runs from 0.35 m out along that axis to the near
+ * face of its block, so its path is as long as its optimal fiber length and
+ * tendon slack length together when the block is centered, and the muscles
+ * start near equilibrium.
+ */
+const ReflexController& OpenSim::generateReflexModel(
+        const ReflexModelSpec& spec, Model& model)
+{
+    OPENSIM_THROW_IF(spec.numBodies < 1 || spec.numMuscles < 1, Exception,
+                     "Expected at least one body and one muscle.");
+
+    model.setName("reflex_" + ReflexModelSpec::getTopologyName(spec.topology)
+                  + "_" + to_string(spec.numBodies) + "_bodies_"
+                  + to_string(spec.numMuscles) + "_muscles");
+    model.setUseVisualizer(false);
+
+    double blockMass = 20.0, blockSideLength = 0.1;
+    double halfLength = blockSideLength/2.0;
+    Inertia blockInertia = blockMass*Inertia::brick(blockSideLength, blockSideLength, blockSideLength);
+
+    vector<PhysicalFrame*> bodies;
+    bodies.reserve(spec.numBodies);
+    vector<PhysicalFrame*> parents;
+    parents.reserve(spec.numBodies);
+    for (int b = 0; b < spec.numBodies; b++) {
+        PhysicalFrame* parent = &model.updGround();
+        if (b > 0 && spec.topology == ReflexModelSpec::Chain)
+            parent = bodies[b-1];
+        else if (b > 0 && spec.topology == ReflexModelSpec::Tree)
+            parent = bodies[(b-1)/2];
+
+        OpenSim::Body* block = new OpenSim::Body("block" + to_string(b),
+                blockMass, Vec3(0), blockInertia);
+        SliderJoint* joint = new SliderJoint("slider" + to_string(b),
+                *parent, Vec3(0, halfLength, 0), Vec3(0, SimTK::Pi/2, 0),
+                *block, Vec3(0, halfLength, 0), Vec3(0, SimTK::Pi/2, 0));
+        model.addBody(block);
+        model.addJoint(joint);
+        bodies.push_back(block);
+        parents.push_back(parent);
+    }
+
+    if (spec.useDelayBank)
+        model.addComponent(new DelayBank());
+
+    double maxIsometricForce = 1000.0, optimalFiberLength = 0.2,
+    tendonSlackLength = 0.1, pennationAngle = 0.0;
+
+    ReflexController* controller = new ReflexController("reflex", 1.0, 1.0, 1.0);
+
+    for (int i = 0; i < spec.numMuscles; i++) {
+        string name = "muscle" + to_string(i);
+        int b = i % spec.numBodies;
+        int k = i / spec.numBodies;
+        int perBody = (spec.numMuscles - b + spec.numBodies - 1)/spec.numBodies;
+        // alternate sides and spread the origins of a block's muscles
+        double side = (k % 2 == 0) ? 1.0 : -1.0;
+        double angle = 2*SimTK::Pi*k/perBody;
+
+        Millard2012EquilibriumMuscle* muscle =
+            new Millard2012EquilibriumMuscle(name,
+                maxIsometricForce, optimalFiberLength, tendonSlackLength,
+                pennationAngle);
+        muscle->addNewPathPoint(name + "-point1", *parents[b],
+            Vec3(0.02*cos(angle), halfLength + 0.02*sin(angle), side*0.35));
+        muscle->addNewPathPoint(name + "-point2", *bodies[b],
+            Vec3(0.0, halfLength, side*halfLength));
+        muscle->setDefaultActivation(0.01);
+        muscle->setDefaultFiberLength(optimalFiberLength);
+        model.addForce(muscle);
+
+        if (spec.useSnapshots) {
+            MuscleSensorSnapshot* snapshot =
+                    new MuscleSensorSnapshot("snapshot_" + name, *muscle);
+            model.addComponent(snapshot);
+        }
+
+        SimpleSpindle* spindle = new SimpleSpindle("spindle_" + name, *muscle, 1.0, spec.delay);
+        GolgiTendon* golgi = new GolgiTendon("golgi_" + name, *muscle, spec.delay);
+        if (spec.useSnapshots) {
+            spindle->set_snapshot("../snapshot_" + name);
+            golgi->set_snapshot("../snapshot_" + name);
+        }
+        model.addComponent(spindle);
+        model.addComponent(golgi);
+        controller->addSpindle(*spindle);
+        controller->addGolgi(*golgi);
+    }
+
+    controller->setActuators(model.updActuators());
+    model.addController(controller);
+    return *controller;
+}
@@ -0,0 +1,80 @@
+#ifndef OPENSIM_ReflexModelGenerator_H_
+#define OPENSIM_ReflexModelGenerator_H_
+/* -------------------------------------------------------------------------- *
+ *                   OpenSim: ReflexModelGenerator.h                          *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+//============================================================================
+// INCLUDE
+//============================================================================
+#include "OpenSim/Simulation/Model/Model.h"
+#include <string>
+
+
+
+namespace OpenSim {
+
+class ReflexController;
+
+//=============================================================================
+//=============================================================================
+/**
+ * The description of a synthetic reflex model for scaling studies: blocks
+ * on sliders pulled by Millard2012EquilibriumMuscle muscles, every muscle
+ * with a SimpleSpindle and a GolgiTendon wired to one ReflexController.
+ *
+ * The topology decides what each block slides on: the ground (Parallel),
+ * the block before it (Chain) or its parent in a balanced binary tree
+ * (Tree). Muscle i pulls block i % numBodies against what that block slides
+ * on, with consecutive muscles of a block on opposite sides.
+ *
+ * @author  Hjalti Hilmarsson
+ */
+struct ReflexModelSpec {
+    enum Topology { Parallel, Chain, Tree };
+
+    int numBodies = 1;
+    int numMuscles = 1;
+    Topology topology = Parallel;
+    /** The delay of every spindle and Golgi tendon organ. */
+    double delay = 0.03;
+    /** Record the delay histories in one DelayBank. */
+    bool useDelayBank = false;
+    /** Give every muscle a MuscleSensorSnapshot. */
+    bool useSnapshots = false;
+
+    /** Parse "parallel", "chain" or "tree". Throws otherwise. */
+    static Topology parseTopology(const std::string& name);
+    static std::string getTopologyName(Topology topology);
+};
+
+/** Build the model described by spec into model, which should be empty, and
+    return its controller. */
+const ReflexController& generateReflexModel(const ReflexModelSpec& spec,
+                                            Model& model);
+
+}; //namespace
+//=============================================================================
+//=============================================================================
+
+#endif // OPENSIM_ReflexModelGenerator_H_
@@ -0,0 +1,413 @@
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim:  ReflexReplay.cpp                            *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+
+//=============================================================================
+// INCLUDES
+//=============================================================================
+#include "ReflexReplay.h"
+#include <OpenSim/OpenSim.h>
+#include "ReflexController.h"
+#include "SimpleSpindle.h"
+#include "GolgiTendon.h"
+#include "Delay.h"
+#include <algorithm>
+#include <cmath>
+
+
+
+using namespace OpenSim;
+using namespace std;
+
+
+//=============================================================================
+// CONSTRUCTOR(S)
+//=============================================================================
+//_____________________________________________________________________________
+ReflexReplay::ReflexReplay(const Model& model, const SimTK::State& s,
+                           const ReflexController& controller) :
+    _model(model),
+    _state(s),
+    _neuralUpdateInterval(0)
+{
+    const vector<ReflexController::Channel>& channels = controller.getChannels();
+    const int n = (int)channels.size();
+    OPENSIM_THROW_IF(n == 0, Exception, "ReflexController '" +
+                     controller.getName() + "' has no channels to replay; "
+                     "is the system built?");
+
+    _defaults.gainLength = controller.getGainLength(s);
+    _defaults.gainVelocity = controller.getGainVelocity(s);
+    _defaults.normalizedRestLength = controller.get_normalized_rest_length();
+    _defaults.delay = 0;
+    _defaults.golgiDelay = 0;
+    bool haveSpindle = false;
+    bool haveGolgi = false;
+
+    _invOptimalFiberLength.assign(n, 0.0);
+    _invMaxSpeed.assign(n, 0.0);
+    _invTendonSlackLength.assign(n, 0.0);
+    for (int c = 0; c < n; ++c) {
+        const ReflexController::Channel& from = channels[c];
+        Channel channel;
+        channel.muscle = from.muscle;
+        channel.hasSpindle = from.spindle != nullptr;
+        channel.hasGolgi = from.golgi != nullptr;
+        channel.optimalFiberLength = from.muscle->getOptimalFiberLength();
+        channel.tendonSlackLength = from.muscle->getTendonSlackLength();
+        _channels.push_back(channel);
+        _channelNames.push_back(from.muscle->getName());
+
+        // the same normalizers as the controller
+        _invOptimalFiberLength[c] = 1/channel.optimalFiberLength;
+        _invMaxSpeed[c] = 1/(channel.optimalFiberLength*
+                             from.muscle->getMaxContractionVelocity());
+        _invTendonSlackLength[c] = 1/channel.tendonSlackLength;
+
+        if (!haveSpindle && from.spindle) {
+            _defaults.normalizedRestLength =
+                    from.spindle->getNormalizedRestLength(s);
+            _defaults.delay = from.spindle->getDelay(s);
+            haveSpindle = true;
+        }
+        if (!haveGolgi && from.golgi) {
+            _defaults.golgiDelay = from.golgi->getDelay(s);
+            haveGolgi = true;
+        }
+    }
+
+    if (controller.get_neural_update_rate() > 0)
+        _neuralUpdateInterval = 1/controller.get_neural_update_rate();
+
+    // the Delay components fed by an afferent of a channel
+    for (const Delay& delay : model.getComponentList<Delay>()) {
+        const Input<double>& input = delay.getInput<double>("signal");
+        if (!input.isConnected())
+            continue;
+        const AbstractOutput& output = input.getChannel().getOutput();
+        const Component* owner = &output.getOwner();
+        for (int c = 0; c < n; ++c) {
+            DelayTap tap;
+            tap.channel = c;
+            tap.afferent = -1;
+            tap.delay = delay.get_delay();
+            if (owner == channels[c].spindle)
+                tap.afferent = output.getName() == "spindle_length" ? 0 :
+                               output.getName() == "spindle_speed" ? 1 : -1;
+            else if (owner == channels[c].golgi && output.getName() == "length")
+                tap.afferent = 2;
+            if (tap.afferent >= 0) {
+                _delays.push_back(tap);
+                _delayNames.push_back(delay.getAbsolutePathString());
+                break;
+            }
+        }
+    }
+}
+
+//=============================================================================
+// TRIALS
+//=============================================================================
+//_____________________________________________________________________________
+ReplayTrial ReflexReplay::createTrial(const TimeSeriesTable& table) const
+{
+    const ValueArrayDictionary& metaData = table.getTableMetaData();
+    OPENSIM_THROW_IF(metaData.hasKey("inDegrees") &&
+                     metaData.getValueForKey("inDegrees")
+                            .getValue<std::string>() == "yes", Exception,
+                     "Expected the trial's rotations in radians.");
+
+    const int n = getNumChannels();
+    const int width = AlignedArray::Width;
+
+    ReplayTrial trial;
+    trial.time = table.getIndependentColumn();
+    trial.stride = std::max(width, (n + width - 1)/width*width);
+    const int size = trial.getNumFrames()*trial.stride;
+    trial.length.assign(size, 0.0);
+    trial.speed.assign(size, 0.0);
+    trial.tendonLength.assign(size, 0.0);
+
+    if (!readMuscleColumns(table, trial))
+        computeFromStates(table, trial);
+    return trial;
+}
+
+/* A muscle column is looked up by the path of the muscle and then by its
+ * name. */
+static std::string findMuscleColumn(const TimeSeriesTable& table,
+                                    const Muscle& muscle,
+                                    const std::string& signal)
+{
+    std::string label = muscle.getAbsolutePathString() + "|" + signal;
+    if (table.hasColumn(label))
+        return label;
+    label = muscle.getName() + "|" + signal;
+    if (table.hasColumn(label))
+        return label;
+    return "";
+}
+
+bool ReflexReplay::readMuscleColumns(const TimeSeriesTable& table,
+                                     ReplayTrial& trial) const
+{
+    const int numFrames = trial.getNumFrames();
+    const int stride = trial.stride;
+
+    int found = 0;
+    for (const Channel& channel : _channels)
+        if (!findMuscleColumn(table, *channel.muscle, "length").empty())
+            ++found;
+    if (found == 0)
+        return false;
+    OPENSIM_THROW_IF(found < getNumChannels(), Exception,
+                     "The trial has the lengths of " + to_string(found) +
+                     " of the " + to_string(getNumChannels()) + " muscles.");
+
+    for (int c = 0; c < getNumChannels(); ++c) {
+        const Channel& channel = _channels[c];
+        const Muscle& muscle = *channel.muscle;
+
+        auto length = table.getDependentColumn(
+                findMuscleColumn(table, muscle, "length"));
+        for (int i = 0; i < numFrames; ++i)
+            trial.length[i*stride + c] = length[i];
+
+        const std::string speedLabel =
+                findMuscleColumn(table, muscle, "lengthening_speed");
+        if (!speedLabel.empty()) {
+            auto speed = table.getDependentColumn(speedLabel);
+            for (int i = 0; i < numFrames; ++i)
+                trial.speed[i*stride + c] = speed[i];
+        }
+        else {
+            // central differences, one-sided at the ends
+            const vector<double>& t = trial.time;
+            for (int i = 0; i < numFrames && numFrames > 1; ++i) {
+                int a = std::max(i - 1, 0);
+                int b = std::min(i + 1, numFrames - 1);
+                trial.speed[i*stride + c] = (length[b] - length[a])/(t[b] - t[a]);
+            }
+        }
+
+        const std::string tendonLabel =
+                findMuscleColumn(table, muscle, "tendon_length");
+        OPENSIM_THROW_IF(tendonLabel.empty() && channel.hasGolgi, Exception,
+                         "The trial has no tendon length of muscle '" +
+                         muscle.getName() + "', which has a Golgi tendon "
+                         "organ.");
+        if (!tendonLabel.empty()) {
+            auto tendonLength = table.getDependentColumn(tendonLabel);
+            for (int i = 0; i < numFrames; ++i)
+                trial.tendonLength[i*stride + c] = tendonLength[i];
+        }
+    }
+    return true;
+}
+
+/* The states are set through the model's state variable order, resolved
+ * once, and the muscles are evaluated at the Velocity stage of each frame.
+ */
+void ReflexReplay::computeFromStates(const TimeSeriesTable& table,
+                                     ReplayTrial& trial) const
+{
+    const int numFrames = trial.getNumFrames();
+    const int stride = trial.stride;
+
+    const Array<std::string> names = _model.getStateVariableNames();
+    vector<int> stateOfColumn;
+    vector<int> columnOfState;
+    for (int k = 0; k < names.getSize(); ++k) {
+        if (table.hasColumn(names[k])) {
+            stateOfColumn.push_back(k);
+            columnOfState.push_back((int)table.getColumnIndex(names[k]));
+        }
+    }
+    OPENSIM_THROW_IF(stateOfColumn.empty(), Exception,
+                     "The trial has neither muscle lengths nor states of "
+                     "the model.");
+
+    SimTK::State s = _state;
+    SimTK::Vector y = _model.getStateVariableValues(s);
+    const auto& values = table.getMatrix();
+    for (int i = 0; i < numFrames; ++i) {
+        for (size_t k = 0; k < stateOfColumn.size(); ++k)
+            y[stateOfColumn[k]] = values(i, columnOfState[k]);
+        s.setTime(trial.time[i]);
+        _model.setStateVariableValues(s, y);
+        _model.realizeVelocity(s);
+
+        for (int c = 0; c < getNumChannels(); ++c) {
+            const Muscle& muscle = *_channels[c].muscle;
+            trial.length[i*stride + c] = muscle.getLength(s);
+            trial.speed[i*stride + c] = muscle.getLengtheningSpeed(s);
+            trial.tendonLength[i*stride + c] = muscle.getTendonLength(s);
+        }
+    }
+}
+
+//=============================================================================
+// REPLAY
+//=============================================================================
+//_____________________________________________________________________________
+/* The delayed times increase with the frames, so the frame they fall after
+ * only moves forward: one pass over the series.
+ */
+void ReflexReplay::delaySeries(const std::vector<double>& time, double delay,
+                               const double* x, int stride,
+                               double* out, int outStride)
+{
+    const int numFrames = (int)time.size();
+    int j = 0;
+    for (int i = 0; i < numFrames; ++i) {
+        const double delayedTime = time[i] - delay;
+        double value = 0;
+        if (delayedTime >= time[0]) {
+            while (j + 1 < numFrames && time[j + 1] <= delayedTime)
+                ++j;
+            value = x[j*stride];
+            if (j + 1 < numFrames && delayedTime > time[j]) {
+                double w = (delayedTime - time[j])/(time[j + 1] - time[j]);
+                value += w*(x[(j + 1)*stride] - value);
+            }
+        }
+        out[i*outStride] = value;
+    }
+}
+
+/* Every afferent is delayed as a series, using the controls as scratch for
+ * the undelayed stretches; then the reflex law is evaluated frame by frame
+ * for all channels, exactly as the controller does.
+ */
+void ReflexReplay::evaluate(const ReplayTrial& trial, const Parameters& p,
+                            ReplayOutput& output) const
+{
+    const int numFrames = trial.getNumFrames();
+    const int stride = trial.stride;
+    const int size = numFrames*stride;
+    const vector<double>& time = trial.time;
+
+    if (output.numFrames != numFrames || output.stride != stride) {
+        output.numFrames = numFrames;
+        output.stride = stride;
+        output.spindleLength.assign(size, 0.0);
+        output.spindleSpeed.assign(size, 0.0);
+        output.tendonLength.assign(size, 0.0);
+        output.controls.assign(size, 0.0);
+    }
+    output.delaySignals.resize(_delays.size());
+    for (vector<double>& signal : output.delaySignals)
+        signal.resize(numFrames);
+
+    double* scratch = output.controls.data();
+    for (int c = 0; c < getNumChannels(); ++c) {
+        const Channel& channel = _channels[c];
+
+        if (channel.hasSpindle) {
+            const double restLength =
+                    p.normalizedRestLength*channel.optimalFiberLength;
+            for (int i = 0; i < numFrames; ++i)
+                scratch[i*stride + c] = trial.length[i*stride + c] - restLength;
+            delaySeries(time, p.delay, scratch + c, stride,
+                        output.spindleLength.data() + c, stride);
+            delaySeries(time, p.delay, trial.speed.data() + c, stride,
+                        output.spindleSpeed.data() + c, stride);
+        }
+
+        if (channel.hasGolgi) {
+            for (int i = 0; i < numFrames; ++i)
+                scratch[i*stride + c] = trial.tendonLength[i*stride + c] -
+                                        channel.tendonSlackLength;
+            delaySeries(time, p.golgiDelay, scratch + c, stride,
+                        output.tendonLength.data() + c, stride);
+        }
+    }
+
+    for (size_t k = 0; k < _delays.size(); ++k) {
+        const DelayTap& tap = _delays[k];
+        const AlignedArray& afferent = tap.afferent == 0 ? output.spindleLength
+                                     : tap.afferent == 1 ? output.spindleSpeed
+                                                         : output.tendonLength;
+        delaySeries(time, tap.delay, afferent.data() + tap.channel, stride,
+                    output.delaySignals[k].data(), 1);
+    }
+
+    const int n = getNumChannels();
+    for (int i = 0; i < numFrames; ++i) {
+        const int row = i*stride;
+        computeReflexControls(n, p.gainLength, p.gainVelocity,
+                              output.spindleLength.data() + row,
+                              output.spindleSpeed.data() + row,
+                              output.tendonLength.data() + row,
+                              _invOptimalFiberLength.data(),
+                              _invMaxSpeed.data(),
+                              _invTendonSlackLength.data(),
+                              output.controls.data() + row);
+    }
+
+    if (_neuralUpdateInterval > 0)
+        holdControls(time, output.controls.data(), stride);
+}
+
+/* The controller evaluates the reflexes at every update time and holds the
+ * controls until the next. Frames stand in for the update times: the frame
+ * at an update time, or the last frame before it.
+ */
+void ReflexReplay::holdControls(const std::vector<double>& time,
+                                double* controls, int stride) const
+{
+    const double tolerance = 1.0e-6*_neuralUpdateInterval;
+    vector<double> held(stride, 0.0);
+    vector<double> previous(stride, 0.0);
+    long long lastUpdate = -1;
+
+    for (size_t i = 0; i < time.size(); ++i) {
+        double* row = controls + i*stride;
+        long long update =
+                (long long)std::floor(time[i]/_neuralUpdateInterval + 1.0e-6);
+        if (update > lastUpdate) {
+            bool atUpdate = time[i] <= update*_neuralUpdateInterval + tolerance;
+            const double* from = atUpdate || i == 0 ? row : previous.data();
+            held.assign(from, from + stride);
+            lastUpdate = update;
+        }
+        previous.assign(row, row + stride);
+        std::copy(held.begin(), held.end(), row);
+    }
+}
+
+TimeSeriesTable ReflexReplay::createControlsTable(
+        const ReplayTrial& trial, const ReplayOutput& output) const
+{
+    TimeSeriesTable table;
+    table.setColumnLabels(_channelNames);
+
+    SimTK::RowVector row(getNumChannels());
+    for (int i = 0; i < output.numFrames; ++i) {
+        for (int c = 0; c < getNumChannels(); ++c)
+            row[c] = output.controls[i*output.stride + c];
+        table.appendRow(trial.time[i], row);
+    }
+    return table;
+}
@@ -0,0 +1,219 @@
+#ifndef OPENSIM_ReflexReplay_H_
+#define OPENSIM_ReflexReplay_H_
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim: ReflexReplay.h                               *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+//============================================================================
+// INCLUDE
+//============================================================================
+#include "OpenSim/Simulation/Model/Model.h"
+#include "OpenSim/Common/TimeSeriesTable.h"
+#include "ReflexKernel.h"
+#include <string>
+#include <vector>
+
+
+
+namespace OpenSim {
+
+class Muscle;
+class ReflexController;
+
+/**
+ * The recorded kinematics of one trial, as ReflexReplay needs them: the
+ * length, lengthening speed and tendon length of every muscle of the
+ * controller at every frame. The arrays are frame-major: the value of
+ * channel c at frame i is at [i*stride + c], stride being the number of
+ * channels padded for computeReflexControls().
+ */
+struct ReplayTrial {
+    std::vector<double> time;
+    int stride;
+    AlignedArray length;
+    AlignedArray speed;
+    AlignedArray tendonLength;
+
+    int getNumFrames() const { return (int)time.size(); }
+};
+
+/**
+ * The signals of one replay, laid out like a ReplayTrial: the delayed
+ * afferents of every channel, the reflex controls and the outputs of the
+ * Delay components that delay an afferent, one array of frames per Delay.
+ */
+struct ReplayOutput {
+    int numFrames;
+    int stride;
+    AlignedArray spindleLength;
+    AlignedArray spindleSpeed;
+    AlignedArray tendonLength;
+    AlignedArray controls;
+    std::vector<std::vector<double>> delaySignals;
+
+    ReplayOutput() : numFrames(0), stride(0) {}
+};
+
+//=============================================================================
+//=============================================================================
+/**
+ * ReflexReplay evaluates the reflex chain of a ReflexController open loop,
+ * on recorded kinematics instead of a simulation: the SimpleSpindle and
+ * GolgiTendon afferents, their delays, the Delay components fed by them and
+ * the reflex controls. Nothing is integrated. Each signal is delayed as a
+ * whole series by interpolating it at the delayed frame times, and the
+ * controls of each frame are computed for all channels at once with
+ * computeReflexControls(), so a replay costs a few passes over the trial.
+ *
+ * The delays are ideal: Pade delays are replayed as the delays they
+ * approximate, and recorded frames take the place of the accepted steps or
+ * sampling instants that fill the delay histories in a simulation. A
+ * controller with a neural_update_rate holds the controls of the last frame
+ * at or before each update.
+ *
+ * A ReflexReplay is created from a model whose system is built and a State
+ * that gives the defaults of the parameters. Trials and replays do not
+ * change it, so one ReflexReplay can replay on many threads.
+ *
+ * @code
+ * ReflexReplay replay(model, state, controller);
+ * ReplayTrial trial = replay.createTrial(TimeSeriesTable("trial.sto"));
+ * ReplayOutput output;
+ * replay.evaluate(trial, replay.getDefaultParameters(), output);
+ * @endcode
+ *
+ * @author  Hjalti Hilmarsson
+ */
+class ReflexReplay {
+
+public:
+    /** The parameters of a replay, applied to every channel: the delay is
+        that of the spindles and golgiDelay that of the Golgi tendon
+        organs. */
+    struct Parameters {
+        double gainLength;
+        double gainVelocity;
+        double normalizedRestLength;
+        double delay;
+        double golgiDelay;
+    };
+
+    /** Replay controller, a component of model, whose system is built. The
+        default parameters are the gains of controller, the rest length and
+        delay of its first spindle and the delay of its first Golgi tendon
+        organ in s. */
+    ReflexReplay(const Model& model, const SimTK::State& s,
+                 const ReflexController& controller);
+
+    const Parameters& getDefaultParameters() const { return _defaults; }
+
+    int getNumChannels() const { return (int)_channels.size(); }
+    /** The names of the muscles of the channels. */
+    const std::vector<std::string>& getChannelNames() const
+    {   return _channelNames; }
+    /** The paths of the Delay components whose outputs are replayed. */
+    const std::vector<std::string>& getDelayNames() const
+    {   return _delayNames; }
+
+    //--------------------------------------------------------------------------
+    // TRIALS
+    //--------------------------------------------------------------------------
+    /** The kinematics of the trial recorded in table. The muscles are read
+        from the columns <muscle>|length, <muscle>|lengthening_speed and
+        <muscle>|tendon_length, <muscle> being the path or the name of the
+        muscle; a missing speed is differentiated from the length. Without
+        those columns the table must hold states, such as the coordinate
+        values and speeds of a states table, which are set frame by frame
+        to compute the muscle lengths; states without a column keep their
+        values in the State given to the constructor. Rotations are
+        expected in radians. */
+    ReplayTrial createTrial(const TimeSeriesTable& table) const;
+
+    //--------------------------------------------------------------------------
+    // REPLAY
+    //--------------------------------------------------------------------------
+    /** Replay trial with parameters p into output, which is only
+        reallocated when the size of the trial changes. */
+    void evaluate(const ReplayTrial& trial, const Parameters& p,
+                  ReplayOutput& output) const;
+
+    /** The controls of output as a table with a column per channel. */
+    TimeSeriesTable createControlsTable(const ReplayTrial& trial,
+                                        const ReplayOutput& output) const;
+
+    /** Set out[i*outStride] to the value of the series x, whose frame i is
+        at x[i*stride], at time[i] - delay, interpolated linearly, or to
+        zero before the first frame, as a DelayLine does. */
+    static void delaySeries(const std::vector<double>& time, double delay,
+                            const double* x, int stride,
+                            double* out, int outStride);
+
+private:
+    // the muscle lengths, speeds and tendon lengths of table's columns
+    bool readMuscleColumns(const TimeSeriesTable& table,
+                           ReplayTrial& trial) const;
+    // the muscle lengths, speeds and tendon lengths of table's states
+    void computeFromStates(const TimeSeriesTable& table,
+                           ReplayTrial& trial) const;
+    // hold the controls between neural updates
+    void holdControls(const std::vector<double>& time, double* controls,
+                      int stride) const;
+
+    const Model& _model;
+    SimTK::State _state;
+
+    // what a channel needs from its muscle and sensors
+    struct Channel {
+        const Muscle* muscle;
+        bool hasSpindle;
+        bool hasGolgi;
+        double optimalFiberLength;
+        double tendonSlackLength;
+    };
+    std::vector<Channel> _channels;
+    std::vector<std::string> _channelNames;
+    AlignedArray _invOptimalFiberLength;
+    AlignedArray _invMaxSpeed;
+    AlignedArray _invTendonSlackLength;
+    double _neuralUpdateInterval;
+
+    // a Delay fed by an afferent: the channel, which afferent (0 spindle
+    // length, 1 spindle speed, 2 tendon length) and the delay
+    struct DelayTap {
+        int channel;
+        int afferent;
+        double delay;
+    };
+    std::vector<DelayTap> _delays;
+    std::vector<std::string> _delayNames;
+
+    Parameters _defaults;
+
+    //=========================================================================
+};  // END of class ReflexReplay
+
+}; //namespace
+//=============================================================================
+//=============================================================================
+
+#endif // OPENSIM_ReflexReplay_H_
@@ -0,0 +1,101 @@
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim:  ReflexReplayBatch.cpp                       *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+
+//=============================================================================
+// INCLUDES
+//=============================================================================
+#include "ReflexReplayBatch.h"
+
+
+
+using namespace OpenSim;
+using namespace std;
+
+
+//=============================================================================
+// CONTROLS
+//=============================================================================
+void ReplayControls::resize(int numChannels, const std::vector<int>& numFrames,
+                            int numSets)
+{
+    _numChannels = numChannels;
+    _numSets = numSets;
+    _numFrames = numFrames;
+    _firstFrame.resize(numFrames.size());
+
+    size_t frames = 0;
+    for (size_t n = 0; n < numFrames.size(); ++n) {
+        _firstFrame[n] = frames;
+        frames += numFrames[n];
+    }
+    size_t size = frames*numSets*numChannels;
+    if (_data.size() < size)
+        _data.resize(size);
+}
+
+
+//=============================================================================
+// BATCH
+//=============================================================================
+ReflexReplayBatch::ReflexReplayBatch(const ReflexReplay& replay,
+                                     int numThreads) :
+    _replay(replay),
+    _pool(numThreads),
+    _outputs(_pool.getNumThreads())
+{
+}
+
+/* A task is one trial with one parameter set. The tasks of a trial are
+ * next to each other, so a worker mostly goes on with the trial it has in
+ * cache, and its output only needs resizing when the trial changes size.
+ */
+void ReflexReplayBatch::evaluate(const std::vector<ReplayTrial>& trials,
+                                 const std::vector<ReflexReplay::Parameters>& sets,
+                                 ReplayControls& controls) const
+{
+    const int numChannels = _replay.getNumChannels();
+    const int numSets = (int)sets.size();
+
+    vector<int> numFrames;
+    for (const ReplayTrial& trial : trials)
+        numFrames.push_back(trial.getNumFrames());
+    controls.resize(numChannels, numFrames, numSets);
+
+    _pool.run((int)trials.size()*numSets, [&](int worker, int task) {
+        const int n = task/numSets;
+        const int k = task % numSets;
+        const ReplayTrial& trial = trials[n];
+        ReplayOutput& output = _outputs[worker];
+
+        _replay.evaluate(trial, sets[k], output);
+
+        double* to = controls.updControls(n, k);
+        for (int i = 0; i < trial.getNumFrames(); ++i) {
+            const double* from = output.controls.data() + i*output.stride;
+            for (int c = 0; c < numChannels; ++c)
+                to[i*numChannels + c] = from[c];
+        }
+    });
+}
@@ -0,0 +1,131 @@
+#ifndef OPENSIM_ReflexReplayBatch_H_
+#define OPENSIM_ReflexReplayBatch_H_
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim: ReflexReplayBatch.h                          *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+//============================================================================
+// INCLUDE
+//============================================================================
+#include "ReflexReplay.h"
+#include "WorkStealingPool.h"
+#include <cstddef>
+#include <vector>
+
+
+
+namespace OpenSim {
+
+//=============================================================================
+//=============================================================================
+/**
+ * The reflex controls of a batch of replays: for every trial and parameter
+ * set, the controls of every frame and channel. They are one array, trial
+ * after trial, each trial holding its parameter sets one after the other
+ * and each set its frames, so the controls of trial n with set k at frame i
+ * are at getControls(n, k)[i*getNumChannels() + c].
+ */
+class ReplayControls {
+
+public:
+    ReplayControls() : _numChannels(0), _numSets(0) {}
+
+    /** Lay out the controls of numChannels channels for trials with the
+        given numbers of frames and numSets parameter sets each. Memory is
+        only taken when the batch is larger than any before. */
+    void resize(int numChannels, const std::vector<int>& numFrames,
+                int numSets);
+
+    int getNumChannels() const { return _numChannels; }
+    int getNumTrials() const { return (int)_numFrames.size(); }
+    int getNumSets() const { return _numSets; }
+    int getNumFrames(int trial) const { return _numFrames[trial]; }
+
+    const double* getControls(int trial, int set) const
+    {   return _data.data() + getOffset(trial, set); }
+    double* updControls(int trial, int set)
+    {   return _data.data() + getOffset(trial, set); }
+
+private:
+    std::size_t getOffset(int trial, int set) const
+    {   return (_firstFrame[trial]*_numSets +
+                (std::size_t)set*_numFrames[trial])*_numChannels; }
+
+    int _numChannels;
+    int _numSets;
+    std::vector<int> _numFrames;
+    // the frames of the trials before each, counted once per set
+    std::vector<std::size_t> _firstFrame;
+    std::vector<double> _data;
+
+    //=========================================================================
+};  // END of class ReplayControls
+
+//=============================================================================
+//=============================================================================
+/**
+ * ReflexReplayBatch replays every trial of a batch with every one of a list
+ * of parameter sets, on all cores. The trials are shared by the workers and
+ * only read, and each worker keeps its own ReplayOutput to replay into, so
+ * repeated batches reuse the memory of the first. The
+ * replays are balanced over the workers by a WorkStealingPool.
+ *
+ * @code
+ * ReflexReplayBatch batch(replay);
+ * ReplayControls controls;
+ * batch.evaluate(trials, parameterSets, controls);
+ * @endcode
+ *
+ * @author  Hjalti Hilmarsson
+ */
+class ReflexReplayBatch {
+
+public:
+    /** Replay with replay on numThreads threads, or on one per hardware
+        thread when numThreads is not positive. replay must outlive the
+        batch. */
+    explicit ReflexReplayBatch(const ReflexReplay& replay,
+                               int numThreads = 0);
+
+    int getNumThreads() const { return _pool.getNumThreads(); }
+
+    /** Replay every trial with every parameter set into controls, which
+        is resized for them. */
+    void evaluate(const std::vector<ReplayTrial>& trials,
+                  const std::vector<ReflexReplay::Parameters>& sets,
+                  ReplayControls& controls) const;
+
+private:
+    const ReflexReplay& _replay;
+    WorkStealingPool _pool;
+    // what each worker replays into
+    mutable std::vector<ReplayOutput> _outputs;
+
+    //=========================================================================
+};  // END of class ReflexReplayBatch
+
+}; //namespace
+//=============================================================================
+//=============================================================================
+
+#endif // OPENSIM_ReflexReplayBatch_H_
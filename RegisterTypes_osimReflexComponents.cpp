@@ -0,0 +1,67 @@
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim:  RegisterTypes_osimReflexComponents.cpp      *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+
+//=============================================================================
+// INCLUDES
+//=============================================================================
+#include "RegisterTypes_osimReflexComponents.h"
+#include <OpenSim/OpenSim.h>
+#include "SimpleSpindle.h"
+#include "GolgiTendon.h"
+#include "Delay.h"
+#include "DelayBank.h"
+#include "MuscleSensorSnapshot.h"
+#include "ReflexController.h"
+#include "StreamingReporter.h"
+#include "SignalRecorder.h"
+
+
+
+using namespace OpenSim;
+
+static dllObjectInstantiator instantiator;
+
+//_____________________________________________________________________________
+void RegisterTypes_osimReflexComponents()
+{
+    Object::registerType(SimpleSpindle());
+    Object::registerType(GolgiTendon());
+    Object::registerType(Delay());
+    Object::registerType(DelayBank());
+    Object::registerType(MuscleSensorSnapshot());
+    Object::registerType(ReflexController());
+    Object::registerType(StreamingReporter());
+    Object::registerType(SignalRecorder());
+}
+
+dllObjectInstantiator::dllObjectInstantiator()
+{
+    registerDllClasses();
+}
+
+void dllObjectInstantiator::registerDllClasses()
+{
+    RegisterTypes_osimReflexComponents();
+}
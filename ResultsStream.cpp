@@ -0,0 +1,298 @@
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim:  ResultsStream.cpp                           *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+
+//=============================================================================
+// INCLUDES
+//=============================================================================
+#include "ResultsStream.h"
+#include "OpenSim/Common/Exception.h"
+#include <cstring>
+
+
+
+using namespace OpenSim;
+using namespace std;
+
+static const char Magic[8] = {'R', 'F', 'X', 'S', 'T', 'R', 'M', '1'};
+
+// the doubles and counts are written as they are in memory
+static bool isLittleEndian()
+{
+    const uint16_t one = 1;
+    return *reinterpret_cast<const unsigned char*>(&one) == 1;
+}
+
+
+//=============================================================================
+// WRITER
+//=============================================================================
+//_____________________________________________________________________________
+ResultsStreamWriter::ResultsStreamWriter(const std::string& fileName,
+                                         const std::vector<std::string>& labels,
+                                         int blockRows, int numBuffers) :
+    _file(fileName, ios::binary | ios::trunc),
+    _numColumns((int)labels.size()),
+    _blockRows(blockRows),
+    _numRows(0),
+    _current(-1),
+    _closing(false)
+{
+    OPENSIM_THROW_IF(!isLittleEndian(), Exception,
+                     "Results streams are written on little-endian hosts only.");
+    OPENSIM_THROW_IF(blockRows < 1 || numBuffers < 1, Exception,
+                     "Expected a positive number of rows and buffers.");
+    OPENSIM_THROW_IF(!_file, Exception,
+                     "Could not open '" + fileName + "' for writing.");
+
+    _file.write(Magic, sizeof(Magic));
+    uint32_t numColumns = _numColumns;
+    _file.write(reinterpret_cast<const char*>(&numColumns), sizeof(numColumns));
+    for (const string& label : labels) {
+        uint32_t length = (uint32_t)label.size();
+        _file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        _file.write(label.data(), length);
+    }
+    OPENSIM_THROW_IF(!_file, Exception,
+                     "Could not write to '" + fileName + "'.");
+
+    // all memory is taken here, so appending rows allocates nothing
+    _blocks.resize(numBuffers);
+    for (int b = 0; b < numBuffers; ++b) {
+        _blocks[b].data.resize((size_t)(_numColumns + 1)*_blockRows);
+        _blocks[b].numRows = 0;
+        _free.push_back(b);
+    }
+
+    _writer = thread(&ResultsStreamWriter::writeBlocks, this);
+}
+
+ResultsStreamWriter::~ResultsStreamWriter()
+{
+    try {
+        close();
+    }
+    catch (...) {
+        // a destructor must not throw; call close() to see the error
+    }
+}
+
+//_____________________________________________________________________________
+void ResultsStreamWriter::appendRow(double time, const double* values)
+{
+    OPENSIM_THROW_IF(_closing, Exception, "The results stream is closed.");
+
+    if (_current < 0) {
+        unique_lock<mutex> lock(_mutex);
+        // wait for the writer thread when every block is full
+        _blockFree.wait(lock, [this] { return !_free.empty() || _error; });
+        if (_error)
+            rethrow_exception(_error);
+        _current = _free.front();
+        _free.pop_front();
+    }
+
+    Block& block = _blocks[_current];
+    double* data = block.data.data() + block.numRows;
+    data[0] = time;
+    for (int c = 0; c < _numColumns; ++c)
+        data[(size_t)(c + 1)*_blockRows] = values[c];
+    ++_numRows;
+
+    if (++block.numRows == _blockRows)
+        submitCurrentBlock();
+}
+
+void ResultsStreamWriter::submitCurrentBlock()
+{
+    {
+        lock_guard<mutex> lock(_mutex);
+        _full.push_back(_current);
+    }
+    _current = -1;
+    _blockFull.notify_one();
+}
+
+//_____________________________________________________________________________
+void ResultsStreamWriter::close()
+{
+    if (!_writer.joinable())
+        return;
+
+    if (_current >= 0 && _blocks[_current].numRows > 0)
+        submitCurrentBlock();
+    {
+        lock_guard<mutex> lock(_mutex);
+        _closing = true;
+    }
+    _blockFull.notify_one();
+    _writer.join();
+
+    if (!_error) {
+        uint32_t end = 0;
+        _file.write(reinterpret_cast<const char*>(&end), sizeof(end));
+        _file.close();
+        if (!_file)
+            _error = make_exception_ptr(
+                    Exception("Could not complete the results stream."));
+    }
+    checkError();
+}
+
+void ResultsStreamWriter::checkError()
+{
+    lock_guard<mutex> lock(_mutex);
+    if (_error)
+        rethrow_exception(_error);
+}
+
+//_____________________________________________________________________________
+/* Runs on the writer thread: write the full blocks in the order they were
+ * filled and give them back, until the stream is closed and none are left.
+ */
+void ResultsStreamWriter::writeBlocks()
+{
+    for (;;) {
+        int b;
+        {
+            unique_lock<mutex> lock(_mutex);
+            _blockFull.wait(lock, [this] { return !_full.empty() || _closing; });
+            if (_full.empty())
+                return;
+            b = _full.front();
+            _full.pop_front();
+        }
+
+        Block& block = _blocks[b];
+        uint32_t numRows = block.numRows;
+        _file.write(reinterpret_cast<const char*>(&numRows), sizeof(numRows));
+        for (int c = 0; c <= _numColumns; ++c)
+            _file.write(reinterpret_cast<const char*>(
+                    block.data.data() + (size_t)c*_blockRows),
+                    numRows*sizeof(double));
+
+        {
+            lock_guard<mutex> lock(_mutex);
+            if (!_file) {
+                _error = make_exception_ptr(
+                        Exception("Could not write the results stream."));
+                _blockFree.notify_all();
+                return;
+            }
+            block.numRows = 0;
+            _free.push_back(b);
+        }
+        _blockFree.notify_one();
+    }
+}
+
+
+//=============================================================================
+// READER
+//=============================================================================
+//_____________________________________________________________________________
+ResultsStreamReader::ResultsStreamReader(const std::string& fileName) :
+    _file(fileName, ios::binary),
+    _fileName(fileName),
+    _complete(false)
+{
+    OPENSIM_THROW_IF(!isLittleEndian(), Exception,
+                     "Results streams are read on little-endian hosts only.");
+    OPENSIM_THROW_IF(!_file, Exception,
+                     "Could not open '" + fileName + "'.");
+    _file.seekg(0, ios::end);
+    _fileSize = _file.tellg();
+    _file.seekg(0, ios::beg);
+
+    char magic[sizeof(Magic)];
+    uint32_t numColumns = 0;
+    _file.read(magic, sizeof(magic));
+    _file.read(reinterpret_cast<char*>(&numColumns), sizeof(numColumns));
+    OPENSIM_THROW_IF(!_file || memcmp(magic, Magic, sizeof(Magic)) != 0,
+                     Exception, "'" + fileName + "' is not a results stream.");
+
+    _labels.resize(numColumns);
+    for (string& label : _labels) {
+        uint32_t length = 0;
+        _file.read(reinterpret_cast<char*>(&length), sizeof(length));
+        if (_file) {
+            label.resize(length);
+            _file.read(&label[0], length);
+        }
+        OPENSIM_THROW_IF(!_file, Exception,
+                         "The header of '" + fileName + "' is cut short.");
+    }
+}
+
+//_____________________________________________________________________________
+bool ResultsStreamReader::readBlock(std::vector<double>& time,
+                                    std::vector<std::vector<double>>& columns)
+{
+    uint32_t numRows = nextBlockRows();
+    if (numRows == 0)
+        return false;
+
+    time.resize(numRows);
+    _file.read(reinterpret_cast<char*>(time.data()), numRows*sizeof(double));
+    columns.resize(_labels.size());
+    for (vector<double>& column : columns) {
+        column.resize(numRows);
+        _file.read(reinterpret_cast<char*>(column.data()),
+                   numRows*sizeof(double));
+    }
+    OPENSIM_THROW_IF(!_file, Exception,
+                     "Could not read '" + _fileName + "'.");
+    return true;
+}
+
+long long ResultsStreamReader::countRows()
+{
+    long long numRows = 0;
+    while (uint32_t blockRows = nextBlockRows()) {
+        _file.seekg(blockBytes(blockRows), ios::cur);
+        numRows += blockRows;
+    }
+    return numRows;
+}
+
+/* Read the row count of the next block, or return zero at the end marker
+ * and when the rest of the file is shorter than the block, which is what a
+ * run that died while writing leaves behind.
+ */
+uint32_t ResultsStreamReader::nextBlockRows()
+{
+    uint32_t numRows = 0;
+    if (!_file.read(reinterpret_cast<char*>(&numRows), sizeof(numRows)))
+        return 0;
+    if (numRows == 0)
+        _complete = true;
+    else if (_file.tellg() + blockBytes(numRows) > _fileSize)
+        return 0;
+    return numRows;
+}
+
+std::streamoff ResultsStreamReader::blockBytes(uint32_t numRows) const
+{
+    return ((streamoff)_labels.size() + 1)*numRows*(streamoff)sizeof(double);
+}
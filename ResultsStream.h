@@ -0,0 +1,193 @@
+#ifndef OPENSIM_ResultsStream_H_
+#define OPENSIM_ResultsStream_H_
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim: ResultsStream.h                              *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+//============================================================================
+// INCLUDE
+//============================================================================
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+
+namespace OpenSim {
+
+/* A results stream is a binary file of double columns written while a
+ * simulation runs. All numbers are little endian:
+ *
+ *   char     magic[8]        "RFXSTRM1"
+ *   uint32   numColumns      not counting the time column
+ *   for every column:
+ *     uint32 labelLength
+ *     char   label[labelLength]
+ *   blocks, each:
+ *     uint32 numRows         greater than zero
+ *     double time[numRows]
+ *     double values[numRows] for every column in turn
+ *   uint32   0               written when the stream is closed
+ *
+ * Every block holds its rows column by column, so a reader can pick the
+ * columns it wants out of a block without parsing the others. A stream
+ * whose run died has no end marker; its complete blocks are still read.
+ */
+
+//=============================================================================
+//=============================================================================
+/**
+ * ResultsStreamWriter writes rows of doubles to a results stream while the
+ * simulation goes on. Rows are gathered into blocks in memory and a
+ * background thread writes the full blocks to the file, so the simulation
+ * does not wait on the disk. There is a fixed number of blocks: when the
+ * disk falls behind and all of them are full, appendRow() waits for one to
+ * be written, which bounds the memory to numBuffers blocks whatever the
+ * length of the run.
+ *
+ * The stream is completed by close() or the destructor. An error writing
+ * the file is thrown from the next appendRow() or from close().
+ *
+ * @author  Hjalti Hilmarsson
+ */
+class ResultsStreamWriter {
+
+public:
+    /** Create fileName and write the header of a stream with a time column
+        and one column for each of labels. Rows are written in blocks of
+        blockRows rows, numBuffers of which are kept in memory. */
+    ResultsStreamWriter(const std::string& fileName,
+                        const std::vector<std::string>& labels,
+                        int blockRows = 1024, int numBuffers = 4);
+    ~ResultsStreamWriter();
+
+    ResultsStreamWriter(const ResultsStreamWriter&) = delete;
+    ResultsStreamWriter& operator=(const ResultsStreamWriter&) = delete;
+
+    int getNumColumns() const { return _numColumns; }
+    long long getNumRows() const { return _numRows; }
+
+    /** Append the row at time with getNumColumns() values. */
+    void appendRow(double time, const double* values);
+
+    /** Write the rows appended so far and the end marker, and close the
+        file. Does nothing when the stream is already closed. */
+    void close();
+    bool isClosed() const { return _closing; }
+
+private:
+    // a block of rows, laid out as a stream block: the times, then the
+    // values of every column in turn, each blockRows long
+    struct Block {
+        std::vector<double> data;
+        int numRows;
+    };
+
+    // hand the current block to the writer thread
+    void submitCurrentBlock();
+    // write the submitted blocks until the stream is closed
+    void writeBlocks();
+    // rethrow an error of the writer thread
+    void checkError();
+
+    std::ofstream _file;
+    int _numColumns;
+    int _blockRows;
+    long long _numRows;
+
+    std::vector<Block> _blocks;
+    // the block being filled, or -1
+    int _current;
+
+    // the blocks ready to be filled and those ready to be written, guarded
+    // by _mutex
+    std::mutex _mutex;
+    std::condition_variable _blockFree;
+    std::condition_variable _blockFull;
+    std::deque<int> _free;
+    std::deque<int> _full;
+    bool _closing;
+    std::exception_ptr _error;
+
+    std::thread _writer;
+
+    //=========================================================================
+};  // END of class ResultsStreamWriter
+
+//=============================================================================
+//=============================================================================
+/**
+ * ResultsStreamReader reads a results stream block by block.
+ *
+ * @author  Hjalti Hilmarsson
+ */
+class ResultsStreamReader {
+
+public:
+    /** Open fileName and read its header. Throws if it is not a results
+        stream. */
+    explicit ResultsStreamReader(const std::string& fileName);
+
+    const std::vector<std::string>& getColumnLabels() const
+    {   return _labels; }
+
+    /** Read the next block into time and columns, one vector per column,
+        and return true, or return false at the end of the stream. A last
+        block that is cut short is taken as the end. */
+    bool readBlock(std::vector<double>& time,
+                   std::vector<std::vector<double>>& columns);
+
+    /** Read the rest of the stream and return the number of rows in it. */
+    long long countRows();
+
+    /** Whether the stream ended with the end marker rather than in the
+        middle, when the run writing it did not close it. Known once
+        readBlock() returned false. */
+    bool isComplete() const { return _complete; }
+
+private:
+    // the number of rows in the next block, or zero at the end
+    uint32_t nextBlockRows();
+    // the size of a block of numRows rows after its row count
+    std::streamoff blockBytes(uint32_t numRows) const;
+
+    std::ifstream _file;
+    std::string _fileName;
+    std::streamoff _fileSize;
+    std::vector<std::string> _labels;
+    bool _complete;
+
+    //=========================================================================
+};  // END of class ResultsStreamReader
+
+}; //namespace
+//=============================================================================
+//=============================================================================
+
+#endif // OPENSIM_ResultsStream_H_
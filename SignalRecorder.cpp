@@ -0,0 +1,235 @@
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim:  SignalRecorder.cpp                          *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+
+//=============================================================================
+// INCLUDES
+//=============================================================================
+#include "SignalRecorder.h"
+#include <OpenSim/OpenSim.h>
+#include <algorithm>
+#include <cmath>
+
+
+
+// This allows us to use OpenSim functions, classes, etc., without having to
+// prefix the names of those things with "OpenSim::".
+using namespace OpenSim;
+using namespace std;
+using namespace SimTK;
+
+
+//=============================================================================
+// CONSTRUCTOR(S) AND DESTRUCTOR
+//=============================================================================
+//_____________________________________________________________________________
+/* Default constructor. */
+SignalRecorder::SignalRecorder()
+{
+    constructProperties();
+}
+
+/* Convenience constructor. */
+SignalRecorder::SignalRecorder(const std::string& name, double samplingRate)
+{
+    OPENSIM_THROW_IF(name.empty(), ComponentHasNoName, getClassName());
+
+    setName(name);
+    constructProperties();
+    set_sampling_rate(samplingRate);
+}
+
+void SignalRecorder::constructProperties()
+{
+    constructProperty_sampling_rate(1000.0);
+    constructProperty_max_samples(100000);
+
+    _samplingInterval = 1.0e-3;
+    _numSamples = 0;
+    _warnedFull = false;
+    _nextSample = 0;
+    _hasPrevious = false;
+    _previousTime = 0;
+}
+
+//=============================================================================
+// SETUP
+//=============================================================================
+void SignalRecorder::addToRecord(const AbstractOutput& output,
+                                 const std::string& alias)
+{
+    connectInput_inputs(output, alias);
+}
+
+void SignalRecorder::extendConnectToModel(Model& model)
+{
+    Super::extendConnectToModel(model);
+
+    OPENSIM_THROW_IF_FRMOBJ(get_sampling_rate() <= 0, Exception,
+                            "Expected sampling_rate to be positive.");
+    OPENSIM_THROW_IF_FRMOBJ(get_max_samples() < 1, Exception,
+                            "Expected max_samples to be positive.");
+
+    _samplingInterval = 1.0/get_sampling_rate();
+}
+
+/* All the memory of the recording is taken here, so sampling allocates
+ * nothing. Columns are labeled like those of a StreamingReporter.
+ */
+void SignalRecorder::extendRealizeTopology(SimTK::State& s) const
+{
+    Super::extendRealizeTopology(s);
+
+    const Input<double>& input = getInput<double>("inputs");
+    _labels.clear();
+    for (unsigned i = 0; i < input.getNumConnectees(); ++i) {
+        const string& alias = input.getAlias(i);
+        _labels.push_back(alias.empty() ? input.getChannel(i).getPathName()
+                                        : alias);
+    }
+
+    _buffer.assign((_labels.size() + 1)*get_max_samples(), 0.0);
+    _previous.assign(_labels.size(), 0.0);
+    _current.assign(_labels.size(), 0.0);
+    clear();
+}
+
+//=============================================================================
+// SAMPLING
+//=============================================================================
+/* The Manager realizes the Report stage once for every accepted step. The
+ * sample times are whole multiples of the sampling interval; those since
+ * the previous step are interpolated, and the first step of a recording
+ * is sampled only if it falls on one.
+ */
+void SignalRecorder::extendRealizeReport(const SimTK::State& s) const
+{
+    Super::extendRealizeReport(s);
+
+    const double time = s.getTime();
+    // a new simulation
+    if (_hasPrevious && time < _previousTime)
+        clear();
+
+    const Input<double>& input = getInput<double>("inputs");
+    for (size_t i = 0; i < _current.size(); ++i)
+        _current[i] = input.getValue(s, (unsigned)i);
+
+    // tolerate round-off in the step times
+    const double tolerance = 1.0e-6*_samplingInterval;
+    if (!_hasPrevious)
+        _nextSample = (long long)std::ceil(time/_samplingInterval - 1.0e-6);
+
+    const double stepLength = _hasPrevious ? time - _previousTime : 0;
+    for (double sampleTime = _nextSample*_samplingInterval;
+         sampleTime <= time + tolerance;
+         sampleTime = ++_nextSample*_samplingInterval) {
+        double w = 1;
+        if (stepLength > 0)
+            w = std::min(1.0, std::max(0.0,
+                    (sampleTime - _previousTime)/stepLength));
+        appendSample(sampleTime, w);
+    }
+
+    _previous.swap(_current);
+    _previousTime = time;
+    _hasPrevious = true;
+}
+
+void SignalRecorder::appendSample(double time, double w) const
+{
+    const int maxSamples = get_max_samples();
+    if (_numSamples == maxSamples) {
+        if (!_warnedFull)
+            log_warn("SignalRecorder '{}' is full after {} samples; later "
+                     "samples are dropped.", getName(), maxSamples);
+        _warnedFull = true;
+        return;
+    }
+
+    _buffer[_numSamples] = time;
+    for (size_t c = 0; c < _current.size(); ++c)
+        _buffer[(c + 1)*maxSamples + _numSamples] =
+                (1 - w)*_previous[c] + w*_current[c];
+    ++_numSamples;
+}
+
+void SignalRecorder::clear() const
+{
+    _numSamples = 0;
+    _warnedFull = false;
+    _nextSample = 0;
+    _hasPrevious = false;
+}
+
+//=============================================================================
+// SAMPLES
+//=============================================================================
+ColumnSpan SignalRecorder::getTime() const
+{
+    ColumnSpan span = {_buffer.data(), (size_t)_numSamples};
+    return span;
+}
+
+ColumnSpan SignalRecorder::getSamples(int column) const
+{
+    OPENSIM_THROW_IF_FRMOBJ(column < 0 || column >= (int)_labels.size(),
+                            Exception, "There is no column " +
+                            to_string(column) + ".");
+    ColumnSpan span = {_buffer.data() + (size_t)(column + 1)*get_max_samples(),
+                       (size_t)_numSamples};
+    return span;
+}
+
+ColumnSpan SignalRecorder::getSamples(const std::string& label) const
+{
+    auto it = std::find(_labels.begin(), _labels.end(), label);
+    OPENSIM_THROW_IF_FRMOBJ(it == _labels.end(), Exception,
+                            "There is no column '" + label + "'.");
+    return getSamples(int(it - _labels.begin()));
+}
+
+TimeSeriesTable SignalRecorder::getTable() const
+{
+    TimeSeriesTable table;
+    table.setColumnLabels(_labels);
+
+    const int maxSamples = get_max_samples();
+    RowVector row((int)_labels.size());
+    for (int r = 0; r < _numSamples; ++r) {
+        for (int c = 0; c < row.size(); ++c)
+            row[c] = _buffer[(size_t)(c + 1)*maxSamples + r];
+        table.appendRow(_buffer[r], row);
+    }
+    return table;
+}
+
+void SignalRecorder::writeColumnFile(const std::string& fileName) const
+{
+    ColumnFileWriter writer(fileName, _labels, _numSamples);
+    for (int c = 0; c <= (int)_labels.size(); ++c)
+        writer.write(c, 0, _buffer.data() + (size_t)c*get_max_samples(),
+                     _numSamples);
+    writer.close();
+}
@@ -0,0 +1,165 @@
+#ifndef OPENSIM_SignalRecorder_H_
+#define OPENSIM_SignalRecorder_H_
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim: SignalRecorder.h                             *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+//============================================================================
+// INCLUDE
+//============================================================================
+#include "osimSignalRecorderDLL.h"
+#include "OpenSim/Simulation/Model/ModelComponent.h"
+#include "ColumnFile.h"
+#include <vector>
+
+
+
+namespace OpenSim {
+
+//=============================================================================
+//=============================================================================
+/**
+ * SignalRecorder samples the Outputs connected to its inputs at a fixed
+ * rate, such as the spindle_length and spindle_speed of spindles, the
+ * length of Golgi tendon organs, the delaySignal of delays and the
+ * excitation of muscles. Nothing else is kept, so the memory and the
+ * files grow with the signals analyzed and their rate rather than with
+ * the number of integrator steps.
+ *
+ * The inputs are read at every accepted step (the Report stage) and the
+ * samples in between two steps are interpolated linearly, so recording
+ * does not make the integrator stop at the sample times and a model
+ * simulates the same with and without recorders. Samples are kept in
+ * buffers allocated for max_samples samples when the system is built;
+ * samples past those are dropped with a warning.
+ *
+ * A simulation that starts at an earlier time than the last sample starts
+ * the recording over. The samples are kept by the component rather than
+ * in the State, so a recorder records one simulation at a time.
+ *
+ * @code
+ * SignalRecorder* recorder = new SignalRecorder("recorder", 1000);
+ * recorder->addToRecord(spindle->getOutput("spindle_length"));
+ * recorder->addToRecord(muscle->getOutput("excitation"));
+ * model.addComponent(recorder);
+ * ...
+ * manager.integrate(finalTime);
+ * recorder->writeColumnFile("signals.rxc");
+ * @endcode
+ *
+ * @author  Hjalti Hilmarsson
+ */
+class OSIMSIGNALRECORDER_API SignalRecorder : public ModelComponent {
+OpenSim_DECLARE_CONCRETE_OBJECT(SignalRecorder, ModelComponent);
+
+public:
+//=============================================================================
+// INPUT
+//=============================================================================
+    OpenSim_DECLARE_LIST_INPUT(inputs, double, SimTK::Stage::Acceleration,
+        "The signals that are sampled");
+
+//=============================================================================
+// PROPERTIES
+//=============================================================================
+    OpenSim_DECLARE_PROPERTY(sampling_rate, double, "The rate (Hz) at which the inputs are sampled");
+    OpenSim_DECLARE_PROPERTY(max_samples, int, "The number of samples the buffers are allocated for; later samples are dropped");
+
+//=============================================================================
+// METHODS
+//=============================================================================
+    //--------------------------------------------------------------------------
+    // CONSTRUCTION AND DESTRUCTION
+    //--------------------------------------------------------------------------
+    /** Default constructor. */
+    SignalRecorder();
+    SignalRecorder(const std::string& name, double samplingRate);
+
+    // Uses default (compiler-generated) destructor, copy constructor and copy
+    // assignment operator.
+
+    /** Connect output to the inputs, so that it is sampled as a column
+        labeled with its path or with alias. */
+    void addToRecord(const AbstractOutput& output,
+                     const std::string& alias = "");
+
+//--------------------------------------------------------------------------
+// SAMPLES
+//--------------------------------------------------------------------------
+    /** The labels of the sampled columns, without the time. */
+    const std::vector<std::string>& getColumnLabels() const
+    {   return _labels; }
+    int getNumSamples() const { return _numSamples; }
+
+    /** The sample times, in the recorder's buffer. */
+    ColumnSpan getTime() const;
+    /** The samples of a column, in the recorder's buffer. */
+    ColumnSpan getSamples(int column) const;
+    ColumnSpan getSamples(const std::string& label) const;
+
+    /** A copy of the samples as a table. */
+    TimeSeriesTable getTable() const;
+    /** Write the samples to a column file (see ColumnFile). */
+    void writeColumnFile(const std::string& fileName) const;
+
+    /** Drop the samples and record anew from the next accepted step. */
+    void clear() const;
+
+private:
+    // Connect properties to local pointers.  */
+    void constructProperties();
+    // ModelComponent interface to connect this component to its model
+    void extendConnectToModel(Model& aModel) override;
+    // label the columns and allocate the buffers
+    void extendRealizeTopology(SimTK::State& s) const override;
+    // sample the inputs up to the accepted step
+    void extendRealizeReport(const SimTK::State& s) const override;
+
+    // append the sample at time, interpolated between the previous step
+    // (weight 1-w) and the current one (weight w)
+    void appendSample(double time, double w) const;
+
+    double _samplingInterval;
+    mutable std::vector<std::string> _labels;
+
+    // the time column, then every input column, max_samples long each
+    mutable std::vector<double> _buffer;
+    mutable int _numSamples;
+    mutable bool _warnedFull;
+
+    // the index of the next sample time and the inputs at the previous and
+    // current accepted steps
+    mutable long long _nextSample;
+    mutable bool _hasPrevious;
+    mutable double _previousTime;
+    mutable std::vector<double> _previous;
+    mutable std::vector<double> _current;
+
+    //=========================================================================
+};  // END of class SignalRecorder
+
+}; //namespace
+//=============================================================================
+//=============================================================================
+
+#endif // OPENSIM_SignalRecorder_H_
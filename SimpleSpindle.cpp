@@ -90,97 +90,338 @@ void SimpleSpindle::constructProperties()
 
     constructProperty_normalized_rest_length(1.0);
     constructProperty_delay(0.0);
+    constructProperty_history_resolution(1.0e-4);
+    constructProperty_record_accepted_steps_only(true);
+    constructProperty_sampling_rate(0.0);
+    constructProperty_delay_mode("history");
+    constructProperty_pade_order(4);
+    constructProperty_snapshot("");
+    
+    _padeMode = false;
+    stretchChannel = -1;
+    speedChannel = -1;
+    _optimalFiberLength = 1;
+    _normalizedRestLength = 1;
+    _recordAcceptedStepsOnly = true;
+    _samplingInterval = 0;
 }
 
-void SimpleSpindle::addToSystem(SimTK::MultibodySystem& system) const
+void SimpleSpindle::extendAddToSystem(SimTK::MultibodySystem& system) const
 {
-    Super::addToSystem(system);
-    SimpleSpindle* mutableThis = const_cast<SimpleSpindle *>(this);
+    Super::extendAddToSystem(system);
+    
+    // the Pade delay filters integrate with the rest of the system
+    for (const std::string& name : stretchStateNames)
+        addStateVariable(name);
+    for (const std::string& name : speedStateNames)
+        addStateVariable(name);
+    
+    if (_samplingInterval > 0) {
+        system.updDefaultSubsystem().addEventHandler(
+            new PeriodicSampler(_samplingInterval,
+                [this](SimTK::State& s) { recordSample(s); }));
+    }
     
+    // the delayed signals are valid for as long as the stage of their output
+    _spindleLengthCV = addCacheVariable("spindle_length", 0.0,
+                                        SimTK::Stage::Position);
+    _spindleSpeedCV = addCacheVariable("spindle_speed", 0.0,
+                                       SimTK::Stage::Velocity);
 }
 
 void SimpleSpindle::extendConnectToModel(Model &model)
 {
     Super::extendConnectToModel(model);
     
-    muscleStretchHistory.setSize(0);
-    muscleStretchHistory.setMemoryOwner(true);
-    muscleSpeedHistory.setSize(0);
-    muscleSpeedHistory.setMemoryOwner(true);
+    OPENSIM_THROW_IF_FRMOBJ(get_delay() < 0, Exception,
+                            "Expected delay to be non-negative.");
+    OPENSIM_THROW_IF_FRMOBJ(get_history_resolution() <= 0, Exception,
+                            "Expected history_resolution to be positive.");
+    OPENSIM_THROW_IF_FRMOBJ(get_sampling_rate() < 0, Exception,
+                            "Expected sampling_rate to be non-negative.");
+    OPENSIM_THROW_IF_FRMOBJ(
+            get_delay_mode() != "history" && get_delay_mode() != "pade",
+            Exception, "Expected delay_mode to be 'history' or 'pade', "
+            "but got '" + get_delay_mode() + "'.");
+    OPENSIM_THROW_IF_FRMOBJ(
+            get_pade_order() < 1 || get_pade_order() > PadeDelay::MaxOrder,
+            Exception, "Expected pade_order to be between 1 and " +
+            std::to_string(PadeDelay::MaxOrder) + ".");
+    
+    // cache what the signals need so evaluating them does no lookups
+    _muscle = &getSocket<Muscle>("muscle").getConnectee();
+    _optimalFiberLength = _muscle->getOptimalFiberLength();
+    _normalizedRestLength = get_normalized_rest_length();
+    _recordAcceptedStepsOnly = get_record_accepted_steps_only();
+    
+    _padeMode = get_delay_mode() == "pade";
+    stretchStateNames.clear();
+    speedStateNames.clear();
+    
+    if (_padeMode) {
+        stretchPade.setDelay(get_delay(), get_pade_order());
+        speedPade.setDelay(get_delay(), get_pade_order());
+        for (int i = 0; i < stretchPade.getNumStates(); ++i) {
+            stretchStateNames.push_back("stretch_delay_" + std::to_string(i));
+            speedStateNames.push_back("speed_delay_" + std::to_string(i));
+        }
+    }
     
-    const Muscle& musc = getMuscle();
+    // a sampled history is recorded by its own periodic event
+    _samplingInterval = 0;
+    if (!_padeMode && get_sampling_rate() > 0)
+        _samplingInterval = 1/get_sampling_rate();
     
-    PiecewiseLinearFunction muscleStretch;
-    muscleStretch.setName(musc.getName());
-    muscleStretchHistory.cloneAndAppend(muscleStretch);
+    // record in the model's DelayBank if it has one
+    _bank.clear();
+    if (!_padeMode && _samplingInterval == 0 &&
+            get_record_accepted_steps_only()) {
+        if (DelayBank* bank = DelayBank::findInModel(model)) {
+            stretchChannel = bank->addChannel(*this, "stretch", get_delay(),
+                [this](const SimTK::State& s) { return calcMuscleStretch(s); });
+            speedChannel = bank->addChannel(*this, "speed", get_delay(),
+                [this](const SimTK::State& s) { return calcMuscleSpeed(s); });
+            _bank = bank;
+        }
+    }
     
-    PiecewiseLinearFunction muscleSpeed;
-    muscleSpeed.setName(musc.getName());
-    muscleSpeedHistory.cloneAndAppend(muscleSpeed);
+    if (!_padeMode && _bank.empty() && _samplingInterval > 0) {
+        // uniformly sampled histories are indexed directly
+        muscleStretchHistory.updPrototype().allocateUniform(get_delay(),
+                                                            _samplingInterval);
+        muscleSpeedHistory.updPrototype().allocateUniform(get_delay(),
+                                                          _samplingInterval);
+    }
+    else if (!_padeMode && _bank.empty()) {
+        // size the histories for the delay so nothing is allocated while simulating
+        muscleStretchHistory.updPrototype().allocate(get_delay(),
+                                                     get_history_resolution());
+        muscleSpeedHistory.updPrototype().allocate(get_delay(),
+                                                   get_history_resolution());
+    }
+    
+}
+
+//=============================================================================
+// SIMULATION
+//=============================================================================
+void SimpleSpindle::extendInitStateFromProperties(SimTK::State& s) const
+{
+    Super::extendInitStateFromProperties(s);
+    
+    setNormalizedRestLength(s, get_normalized_rest_length());
+    if (!_padeMode && _bank.empty()) {
+        muscleStretchHistory.reset(s, get_delay());
+        muscleSpeedHistory.reset(s, get_delay());
+    }
+}
+
+void SimpleSpindle::extendSetPropertiesFromState(const SimTK::State& s)
+{
+    Super::extendSetPropertiesFromState(s);
+    
+    set_normalized_rest_length(getNormalizedRestLength(s));
+    set_delay(getDelay(s));
+}
+
+/* The Manager realizes the Report stage once for every accepted step, so
+ * recording here keeps integrator trial stages and rejected steps out of the
+ * histories. A step that restarts at an earlier time rewinds them.
+ */
+void SimpleSpindle::extendRealizeReport(const SimTK::State& s) const
+{
+    Super::extendRealizeReport(s);
     
+    if (_padeMode || !_bank.empty() || !_recordAcceptedStepsOnly ||
+            _samplingInterval > 0)
+        return;
+    
+    double time = s.getTime();
+    muscleStretchHistory.record(s, time, calcMuscleStretch(s));
+    muscleSpeedHistory.record(s, time, calcMuscleSpeed(s));
+}
+
+/* Called by the periodic event every sampling interval, so the histories
+ * hold uniformly spaced samples.
+ */
+void SimpleSpindle::recordSample(SimTK::State& s) const
+{
+    getSystem().realize(s, SimTK::Stage::Velocity);
+    
+    double time = s.getTime();
+    double stretch = calcMuscleStretch(s);
+    double speed = calcMuscleSpeed(s);
+    muscleStretchHistory.updValue(s).push(time, stretch);
+    muscleSpeedHistory.updValue(s).push(time, speed);
+}
+
+void SimpleSpindle::extendRealizeTopology(SimTK::State& s) const
+{
+    Super::extendRealizeTopology(s);
+    
+    // every State gets its own delay histories and rest length; the
+    // delay of a history is kept in the history
+    const SimTK::Subsystem& subsystem = getSystem().getDefaultSubsystem();
+    if (!_padeMode && _bank.empty()) {
+        muscleStretchHistory.allocate(subsystem, s);
+        muscleSpeedHistory.allocate(subsystem, s);
+    }
+    _restLengthIndex = subsystem.allocateDiscreteVariable(s,
+            SimTK::Stage::Position,
+            new SimTK::Value<double>(get_normalized_rest_length()));
+    
+    stretchStates.clear();
+    speedStates.clear();
+    for (const std::string& name : stretchStateNames)
+        stretchStates.push_back(traverseToStateVariable(name));
+    for (const std::string& name : speedStateNames)
+        speedStates.push_back(traverseToStateVariable(name));
+    
+    // read the muscle through its snapshot if one is given
+    _snapshot.clear();
+    if (!get_snapshot().empty()) {
+        const MuscleSensorSnapshot& snapshot =
+                getComponent<MuscleSensorSnapshot>(get_snapshot());
+        OPENSIM_THROW_IF_FRMOBJ(&snapshot.getMuscle() != _muscle.get(),
+                Exception, "Expected snapshot '" + get_snapshot() +
+                "' to measure muscle '" + _muscle->getName() + "'.");
+        _snapshot = &snapshot;
+    }
+}
+
+/* In Pade mode the delayed signals are outputs of linear filters driven by
+ * the undelayed ones. The filter states start at zero.
+ */
+void SimpleSpindle::computeStateVariableDerivatives(const SimTK::State& s) const
+{
+    if (!_padeMode)
+        return;
+    
+    double x[PadeDelay::MaxOrder];
+    double xdot[PadeDelay::MaxOrder];
+    
+    getPadeStates(s, stretchStates, x);
+    stretchPade.calcDerivatives(x, calcMuscleStretch(s), xdot);
+    for (size_t i = 0; i < stretchStates.size(); ++i)
+        stretchStates[i]->setDerivative(s, xdot[i]);
+    
+    getPadeStates(s, speedStates, x);
+    speedPade.calcDerivatives(x, calcMuscleSpeed(s), xdot);
+    for (size_t i = 0; i < speedStates.size(); ++i)
+        speedStates[i]->setDerivative(s, xdot[i]);
+}
+
+void SimpleSpindle::getPadeStates(const SimTK::State& s,
+                                  const std::vector<const StateVariable*>& states,
+                                  double* x) const
+{
+    for (size_t i = 0; i < states.size(); ++i)
+        x[i] = states[i]->getValue(s);
 }
 
 //=============================================================================
 // SIGNALS
 //=============================================================================
 
+double SimpleSpindle::calcMuscleStretch(const SimTK::State& s) const
+{
+    // muscle length
+    double length = _snapshot.empty() ? _muscle->getLength(s)
+                                      : _snapshot->getLength(s);
+    // Compute stretch, the muscle spindle only monitors the muscle fiber length not the muscle-tendon length
+    return length-getNormalizedRestLength(s)*_optimalFiberLength;
+}
+
+double SimpleSpindle::calcMuscleSpeed(const SimTK::State& s) const
+{
+    // muscle lengthening speed
+    if (!_snapshot.empty())
+        return _snapshot->getLengtheningSpeed(s);
+    return _muscle->getLengtheningSpeed(s);
+}
+
+/* The delayed signals are computed once per realized state and cached. In
+ * Pade mode they also depend on the filter states, which do not invalidate
+ * the cache, so they are recomputed on every call; that is only the filter
+ * output and records nothing.
+ */
 double SimpleSpindle::getSpindleLength(const SimTK::State& s) const
+{
+    if (_padeMode)
+        return calcSpindleLength(s);
+    if (!isCacheVariableValid(s, _spindleLengthCV))
+        setCacheVariableValue(s, _spindleLengthCV, calcSpindleLength(s));
+    return getCacheVariableValue(s, _spindleLengthCV);
+}
+
+double SimpleSpindle::getSpindleSpeed(const SimTK::State& s) const
+{
+    if (_padeMode)
+        return calcSpindleSpeed(s);
+    if (!isCacheVariableValid(s, _spindleSpeedCV))
+        setCacheVariableValue(s, _spindleSpeedCV, calcSpindleSpeed(s));
+    return getCacheVariableValue(s, _spindleSpeedCV);
+}
+
+double SimpleSpindle::calcSpindleLength(const SimTK::State& s) const
 {
     // get the time
     double time = s.getTime();
     
     double spindle_length = 0;
-    double rest_length = get_normalized_rest_length();
-    // optimal fiber length
-    double f_o = 1;
-    // muscle length
-    double length = 0;
     // muscle stretsch
-    double stretch = 0;
+    double stretch = calcMuscleStretch(s);
 
-    // get a reference to the muscle
-    const Muscle& musc = getMuscle();
-    // get optimal fiber length and muscle length
-    f_o = musc.getOptimalFiberLength();
-    length = musc.getLength(s);
-    // Compute stretch, the muscle spindle only monitors the muscle fiber length not the muscle-tendon length
-    stretch = length-rest_length*f_o;
-    muscleStretchHistory.get(musc.getName()).addPoint(time, stretch);
-    
-    if ((time-get_delay()) < muscleStretchHistory.get(musc.getName()).getXValues()[0])
-    {
-        spindle_length = 0;
+    if (_padeMode) {
+        double x[PadeDelay::MaxOrder];
+        getPadeStates(s, stretchStates, x);
+        spindle_length = stretchPade.calcOutput(x, stretch);
+    }
+    else if (!_bank.empty()) {
+        spindle_length = _bank->getDelayedValue(s, stretchChannel, stretch);
+    }
+    else if (_recordAcceptedStepsOnly || _samplingInterval > 0) {
+        // the current sample stays pending until it is recorded
+        spindle_length = muscleStretchHistory.getValue(s)
+                .getDelayedValue(time, stretch);
     }
     else {
-    spindle_length = muscleStretchHistory.get(musc.getName()).calcValue(SimTK::Vector(1,time-get_delay()));
+        muscleStretchHistory.record(s, time, stretch);
+        // zero until the history reaches back a full delay
+        spindle_length = muscleStretchHistory.getRecordedValue(s)
+                .getDelayedValue(time);
     }
     
     return spindle_length;
 }
 
-double SimpleSpindle::getSpindleSpeed(const SimTK::State& s) const
+double SimpleSpindle::calcSpindleSpeed(const SimTK::State& s) const
 {
     // get the time
     double time = s.getTime();
     // initiate the spindle speed variable
     double spindle_speed = 0;
     // muscle speed
-    double speed = 0;
-    // get a reference to the muscle
-    const Muscle& musc = getMuscle();
-    // muscle lengthening speed
-    speed = musc.getLengtheningSpeed(s);
-    
-    // create a delay component instead of implementing it through properties
-    muscleSpeedHistory.get(musc.getName()).addPoint(time, speed);
+    double speed = calcMuscleSpeed(s);
     
-    if ((time-get_delay()) < muscleSpeedHistory.get(musc.getName()).getXValues()[0])
-    {
-        spindle_speed = 0;
+    if (_padeMode) {
+        double x[PadeDelay::MaxOrder];
+        getPadeStates(s, speedStates, x);
+        spindle_speed = speedPade.calcOutput(x, speed);
+    }
+    else if (!_bank.empty()) {
+        spindle_speed = _bank->getDelayedValue(s, speedChannel, speed);
     }
-    else
-    {
-    spindle_speed = muscleSpeedHistory.get(musc.getName()).calcValue(SimTK::Vector(1,time-get_delay()));
+    else if (_recordAcceptedStepsOnly || _samplingInterval > 0) {
+        // the current sample stays pending until it is recorded
+        spindle_speed = muscleSpeedHistory.getValue(s)
+                .getDelayedValue(time, speed);
+    }
+    else {
+        muscleSpeedHistory.record(s, time, speed);
+        // zero until the history reaches back a full delay
+        spindle_speed = muscleSpeedHistory.getRecordedValue(s)
+                .getDelayedValue(time);
     }
     
     return spindle_speed;
@@ -190,11 +431,73 @@ double SimpleSpindle::getSpindleSpeed(const SimTK::State& s) const
 // GET AND SET
 //=============================================================================
 
+//-----------------------------------------------------------------------------
+// Parameters in the State
+//-----------------------------------------------------------------------------
+double SimpleSpindle::getNormalizedRestLength(const SimTK::State& s) const
+{
+    return SimTK::Value<double>::downcast(getSystem().getDefaultSubsystem()
+            .getDiscreteVariable(s, _restLengthIndex)).get();
+}
+
+void SimpleSpindle::setNormalizedRestLength(SimTK::State& s,
+                                            double rest_length) const
+{
+    SimTK::Value<double>::updDowncast(getSystem().getDefaultSubsystem()
+            .updDiscreteVariable(s, _restLengthIndex)).upd() = rest_length;
+}
+
+double SimpleSpindle::getDelay(const SimTK::State& s) const
+{
+    if (_padeMode || !_bank.empty())
+        return get_delay();
+    return muscleStretchHistory.getValue(s).getDelay();
+}
+
+void SimpleSpindle::setDelay(SimTK::State& s, double delay) const
+{
+    OPENSIM_THROW_IF_FRMOBJ(delay < 0, Exception,
+                            "Expected delay to be non-negative.");
+    OPENSIM_THROW_IF_FRMOBJ(_padeMode || !_bank.empty(), Exception,
+            "The delay can only be set in the State in the 'history' "
+            "delay_mode without a DelayBank; set the delay property and "
+            "rebuild the system instead.");
+    muscleStretchHistory.reset(s, delay);
+    muscleSpeedHistory.reset(s, delay);
+}
+
+//-----------------------------------------------------------------------------
+// Checkpoints
+//-----------------------------------------------------------------------------
+void SimpleSpindle::writeCheckpoint(std::ostream& out,
+                                    const SimTK::State& s) const
+{
+    out << getNormalizedRestLength(s) << "\n";
+    if (!_padeMode && _bank.empty()) {
+        muscleStretchHistory.write(out, s);
+        muscleSpeedHistory.write(out, s);
+    }
+}
+
+void SimpleSpindle::readCheckpoint(std::istream& in, SimTK::State& s) const
+{
+    double rest_length;
+    OPENSIM_THROW_IF_FRMOBJ(!(in >> rest_length), Exception,
+                            "Malformed checkpoint.");
+    setNormalizedRestLength(s, rest_length);
+    if (!_padeMode && _bank.empty()) {
+        muscleStretchHistory.read(in, s);
+        muscleSpeedHistory.read(in, s);
+    }
+}
+
 //-----------------------------------------------------------------------------
 // Spindle frame
 //-----------------------------------------------------------------------------
 const Muscle& SimpleSpindle::getMuscle() const
 {
+    if (!_muscle.empty())
+        return *_muscle;
     return getSocket<Muscle>("muscle").getConnectee();
 }
 
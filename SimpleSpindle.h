@@ -31,7 +31,11 @@
 #include "OpenSim/Simulation/Model/Muscle.h"
 #include "OpenSim/Simulation/Model/ModelComponent.h"
 #include "OpenSim/Simulation/Control/Controller.h"
-#include "OpenSim/Common/PiecewiseLinearFunction.h"
+#include "DelayLineVariable.h"
+#include "PadeDelay.h"
+#include "DelayBank.h"
+#include "PeriodicSampler.h"
+#include "MuscleSensorSnapshot.h"
 #include "OpenSim/Simulation/Model/Model.h"
 
 
@@ -60,6 +64,18 @@ public:
         "The intended rest length of the spindle");
     OpenSim_DECLARE_PROPERTY(delay, double,
                             "The time delay (seconds) between the muscle stretch and the stretch reflex signal");
+    OpenSim_DECLARE_PROPERTY(history_resolution, double,
+                            "The minimum time (seconds) between samples kept in the delay history");
+    OpenSim_DECLARE_PROPERTY(record_accepted_steps_only, bool,
+                            "Record the delay history only at accepted integration steps (when the Report stage is realized) instead of at every evaluation");
+    OpenSim_DECLARE_PROPERTY(sampling_rate, double,
+                            "The rate (Hz) at which a periodic event samples the delay history; 0 records at every accepted integration step");
+    OpenSim_DECLARE_PROPERTY(delay_mode, std::string,
+                            "How the delay is computed: 'history' interpolates the recorded signal, 'pade' integrates a Pade approximation of the delay as continuous states");
+    OpenSim_DECLARE_PROPERTY(pade_order, int,
+                            "The order (number of states) of the Pade approximation used when delay_mode is 'pade'");
+    OpenSim_DECLARE_PROPERTY(snapshot, std::string,
+                            "The path of the MuscleSensorSnapshot of the muscle, read instead of the muscle; none when empty");
 //==============================================================================
 // SOCKETS
 //==============================================================================
@@ -113,20 +129,99 @@ public:
     void setSpindleSpeed(SimTK::State& s, double spindle_velocity) const;
     double getSpindleSpeed(const SimTK::State& s) const;
     
+//--------------------------------------------------------------------------
+// SPINDLE PARAMETERS IN THE STATE
+//--------------------------------------------------------------------------
+/** @name Spindle Parameters in the State
+    The rest length and the delay are kept in the State and initialized from
+    the properties, so a State copy can be given other values without
+    rebuilding the system. */
+    double getNormalizedRestLength(const SimTK::State& s) const;
+    void setNormalizedRestLength(SimTK::State& s, double rest_length) const;
+    
+    double getDelay(const SimTK::State& s) const;
+    /** Set the delay in s and clear the delay histories in s. Only the
+        'history' delay_mode without a DelayBank supports this; the others
+        need the system rebuilt. */
+    void setDelay(SimTK::State& s, double delay) const;
+
+//--------------------------------------------------------------------------
+// CHECKPOINTS
+//--------------------------------------------------------------------------
+    /** Write what this spindle keeps in s besides its continuous states: its rest length and delay histories.
+        Used by StateCheckpoint. */
+    void writeCheckpoint(std::ostream& out, const SimTK::State& s) const;
+    /** Read what writeCheckpoint() wrote into s. */
+    void readCheckpoint(std::istream& in, SimTK::State& s) const;
+    
 private:
     // Connect properties to local pointers.  */
     void constructProperties();
     // ModelComponent interface to connect this component to its model
     void extendConnectToModel(Model& aModel) override;
     // ModelComponent interface to add computational elemetns to the SimTK system
-    void addToSystem(SimTK::MultibodySystem& system) const;
+    void extendAddToSystem(SimTK::MultibodySystem& system) const override;
+    // integrate the Pade delay states
+    void computeStateVariableDerivatives(const SimTK::State& s) const override;
+    // clear the delay histories for a new simulation
+    void extendInitStateFromProperties(SimTK::State& s) const override;
+    // copy the parameters in the State back to the properties
+    void extendSetPropertiesFromState(const SimTK::State& s) override;
+    // commit the current samples to the delay histories at accepted steps
+    void extendRealizeReport(const SimTK::State& s) const override;
+    // record the histories at the periodic sampling event
+    void recordSample(SimTK::State& s) const;
+    // look up the Pade delay state variables once the system is built
+    void extendRealizeTopology(SimTK::State& s) const override;
+    
+    // the undelayed stretch and lengthening speed of the muscle
+    double calcMuscleStretch(const SimTK::State& s) const;
+    double calcMuscleSpeed(const SimTK::State& s) const;
+    // the delayed signals, before they are cached
+    double calcSpindleLength(const SimTK::State& s) const;
+    double calcSpindleSpeed(const SimTK::State& s) const;
+    // read the Pade delay filter states
+    void getPadeStates(const SimTK::State& s,
+                       const std::vector<const StateVariable*>& states,
+                       double* x) const;
     
     //=============================================================================
     // Private Members
     //=============================================================================
     
-    mutable OpenSim::Set<PiecewiseLinearFunction> muscleStretchHistory;
-    mutable OpenSim::Set<PiecewiseLinearFunction> muscleSpeedHistory;
+    // the delay histories, kept in the State
+    mutable DelayLineVariable muscleStretchHistory;
+    mutable DelayLineVariable muscleSpeedHistory;
+    
+    // Pade delay filters and the names of their state variables
+    bool _padeMode;
+    PadeDelay stretchPade;
+    PadeDelay speedPade;
+    std::vector<std::string> stretchStateNames;
+    std::vector<std::string> speedStateNames;
+    mutable std::vector<const StateVariable*> stretchStates;
+    mutable std::vector<const StateVariable*> speedStates;
+    
+    // the model's DelayBank and the channels of the signals, when it is used
+    SimTK::ReferencePtr<const DelayBank> _bank;
+    int stretchChannel;
+    int speedChannel;
+    
+    // the connected muscle and the constants read on every evaluation
+    SimTK::ReferencePtr<const Muscle> _muscle;
+    // the muscle's sensor snapshot, when the model has one
+    mutable SimTK::ReferencePtr<const MuscleSensorSnapshot> _snapshot;
+    double _optimalFiberLength;
+    // the rest length in the State
+    mutable SimTK::DiscreteVariableIndex _restLengthIndex;
+    bool _recordAcceptedStepsOnly;
+    // the period of the sampling event, or zero when it is not used
+    double _samplingInterval;
+    
+    // the delayed signals of the current state, so that repeated queries
+    // neither recompute them nor record them again
+    mutable CacheVariable<double> _spindleLengthCV;
+    mutable CacheVariable<double> _spindleSpeedCV;
     
 protected:
     double _normalizedRestLength;
@@ -0,0 +1,182 @@
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim:  StateCheckpoint.cpp                         *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+
+//=============================================================================
+// INCLUDES
+//=============================================================================
+#include "StateCheckpoint.h"
+#include <OpenSim/OpenSim.h>
+#include "SimpleSpindle.h"
+#include "GolgiTendon.h"
+#include "Delay.h"
+#include "DelayBank.h"
+#include "ReflexController.h"
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+
+
+using namespace OpenSim;
+using namespace std;
+
+/* The text is a header with the time and the continuous states followed by
+ * one section per reflex component, each headed by its path:
+ *
+ *   StateCheckpoint 1
+ *   time <t>
+ *   y <ny> <y_0> ... <y_ny-1>
+ *   component <path>
+ *   <what the component's writeCheckpoint() wrote>
+ *   ...
+ *   end
+ *
+ * Every double is written with max_digits10 digits, so it reads back
+ * exactly.
+ */
+static const char* Header = "StateCheckpoint";
+static const int Version = 1;
+
+
+//=============================================================================
+// CONSTRUCTOR(S)
+//=============================================================================
+StateCheckpoint::StateCheckpoint() : _time(0)
+{
+}
+
+StateCheckpoint::StateCheckpoint(const Model& model, const SimTK::State& s) :
+    _time(s.getTime())
+{
+    ostringstream out;
+    out.precision(numeric_limits<double>::max_digits10);
+
+    out << Header << " " << Version << "\n";
+    out << "time " << s.getTime() << "\n";
+    const SimTK::Vector& y = s.getY();
+    out << "y " << y.size();
+    for (int i = 0; i < y.size(); ++i)
+        out << " " << y[i];
+    out << "\n";
+
+    for (const SimpleSpindle& c : model.getComponentList<SimpleSpindle>()) {
+        out << "component " << c.getAbsolutePathString() << "\n";
+        c.writeCheckpoint(out, s);
+    }
+    for (const GolgiTendon& c : model.getComponentList<GolgiTendon>()) {
+        out << "component " << c.getAbsolutePathString() << "\n";
+        c.writeCheckpoint(out, s);
+    }
+    for (const Delay& c : model.getComponentList<Delay>()) {
+        out << "component " << c.getAbsolutePathString() << "\n";
+        c.writeCheckpoint(out, s);
+    }
+    for (const DelayBank& c : model.getComponentList<DelayBank>()) {
+        out << "component " << c.getAbsolutePathString() << "\n";
+        c.writeCheckpoint(out, s);
+    }
+    for (const ReflexController& c : model.getComponentList<ReflexController>()) {
+        out << "component " << c.getAbsolutePathString() << "\n";
+        c.writeCheckpoint(out, s);
+    }
+    out << "end\n";
+
+    _text = out.str();
+}
+
+StateCheckpoint::StateCheckpoint(const std::string& fileName) : _time(0)
+{
+    ifstream in(fileName, ios::binary);
+    OPENSIM_THROW_IF(!in, Exception,
+                     "Could not open checkpoint '" + fileName + "'.");
+    ostringstream text;
+    text << in.rdbuf();
+    _text = text.str();
+
+    istringstream header(_text);
+    string tag, timeTag;
+    int version;
+    OPENSIM_THROW_IF(!(header >> tag >> version >> timeTag >> _time) ||
+            tag != Header || timeTag != "time", Exception,
+            "'" + fileName + "' is not a checkpoint.");
+    OPENSIM_THROW_IF(version != Version, Exception,
+            "Checkpoint '" + fileName + "' has unsupported version " +
+            to_string(version) + ".");
+}
+
+//=============================================================================
+// FILES
+//=============================================================================
+void StateCheckpoint::print(const std::string& fileName) const
+{
+    ofstream out(fileName, ios::binary);
+    OPENSIM_THROW_IF(!out, Exception,
+                     "Could not open '" + fileName + "' for writing.");
+    out << _text;
+}
+
+//=============================================================================
+// RESTORE
+//=============================================================================
+void StateCheckpoint::restore(const Model& model, SimTK::State& s) const
+{
+    OPENSIM_THROW_IF(isEmpty(), Exception, "The checkpoint is empty.");
+
+    istringstream in(_text);
+    string tag;
+    int version, ny;
+    double time;
+    in >> tag >> version >> tag >> time >> tag >> ny;
+    OPENSIM_THROW_IF(!in || ny != s.getNY(), Exception,
+            "The checkpoint has " + to_string(ny) + " continuous states but "
+            "the State has " + to_string(s.getNY()) + ".");
+
+    SimTK::Vector y(ny);
+    for (int i = 0; i < ny; ++i)
+        OPENSIM_THROW_IF(!(in >> y[i]), Exception, "Malformed checkpoint.");
+    s.setTime(time);
+    s.updY() = y;
+
+    while (in >> tag && tag == "component") {
+        string path;
+        in >> path;
+        const Component& component = model.getComponent(path);
+
+        if (auto c = dynamic_cast<const SimpleSpindle*>(&component))
+            c->readCheckpoint(in, s);
+        else if (auto c = dynamic_cast<const GolgiTendon*>(&component))
+            c->readCheckpoint(in, s);
+        else if (auto c = dynamic_cast<const Delay*>(&component))
+            c->readCheckpoint(in, s);
+        else if (auto c = dynamic_cast<const DelayBank*>(&component))
+            c->readCheckpoint(in, s);
+        else if (auto c = dynamic_cast<const ReflexController*>(&component))
+            c->readCheckpoint(in, s);
+        else
+            OPENSIM_THROW(Exception, "'" + path + "' in the checkpoint is "
+                          "not a reflex component.");
+    }
+    OPENSIM_THROW_IF(tag != "end", Exception, "Malformed checkpoint.");
+}
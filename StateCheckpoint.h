@@ -0,0 +1,96 @@
+#ifndef OPENSIM_StateCheckpoint_H_
+#define OPENSIM_StateCheckpoint_H_
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim: StateCheckpoint.h                            *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+//============================================================================
+// INCLUDE
+//============================================================================
+#include "OpenSim/Simulation/Model/Model.h"
+#include <string>
+
+
+
+namespace OpenSim {
+
+//=============================================================================
+//=============================================================================
+/**
+ * StateCheckpoint captures a simulation at one instant so that any number of
+ * continuations can start from it without simulating the prefix again. It
+ * holds the time, the continuous states and everything the reflex components
+ * keep in the State: the delay histories of the SimpleSpindle, GolgiTendon,
+ * Delay and DelayBank components and the gains, rest lengths and held
+ * controls. Samples recorded at the last accepted step are included even
+ * though the integrator commits them only at the next step.
+ *
+ * A checkpoint is kept as text, so it is copied and written to a file as
+ * is, and restored into a State of any model built the same way, such as a
+ * clone owned by another thread. Other discrete variables, such as the
+ * modeling options, keep the values of the State restored into.
+ *
+ * @code
+ * StateCheckpoint checkpoint(model, manager.integrate(tBranch));
+ * SimTK::State s = initialState;
+ * checkpoint.restore(model, s);
+ * @endcode
+ *
+ * @author  Hjalti Hilmarsson
+ */
+class StateCheckpoint {
+
+public:
+    //--------------------------------------------------------------------------
+    // CONSTRUCTION
+    //--------------------------------------------------------------------------
+    /** An empty checkpoint, which cannot be restored. */
+    StateCheckpoint();
+    /** Capture s, a State of model's system. */
+    StateCheckpoint(const Model& model, const SimTK::State& s);
+    /** Read a checkpoint written by print(). */
+    explicit StateCheckpoint(const std::string& fileName);
+
+    bool isEmpty() const { return _text.empty(); }
+    double getTime() const { return _time; }
+
+    /** Write the checkpoint to a file. */
+    void print(const std::string& fileName) const;
+
+    /** Set s, a State of model's system realized at least to Topology, to
+        the captured instant. Throws if model does not have the captured
+        components or states. */
+    void restore(const Model& model, SimTK::State& s) const;
+
+private:
+    double _time;
+    std::string _text;
+
+    //=========================================================================
+};  // END of class StateCheckpoint
+
+}; //namespace
+//=============================================================================
+//=============================================================================
+
+#endif // OPENSIM_StateCheckpoint_H_
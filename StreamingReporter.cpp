@@ -0,0 +1,138 @@
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim:  StreamingReporter.cpp                       *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+
+//=============================================================================
+// INCLUDES
+//=============================================================================
+#include "StreamingReporter.h"
+#include <OpenSim/OpenSim.h>
+
+
+
+// This allows us to use OpenSim functions, classes, etc., without having to
+// prefix the names of those things with "OpenSim::".
+using namespace OpenSim;
+using namespace std;
+using namespace SimTK;
+
+
+//=============================================================================
+// CONSTRUCTOR(S) AND DESTRUCTOR
+//=============================================================================
+//_____________________________________________________________________________
+/* Default constructor. */
+StreamingReporter::StreamingReporter()
+{
+    constructProperties();
+}
+
+/* Convenience constructor. */
+StreamingReporter::StreamingReporter(const std::string& name,
+                                     const std::string& fileName)
+{
+    OPENSIM_THROW_IF(name.empty(), ComponentHasNoName, getClassName());
+
+    setName(name);
+    constructProperties();
+    set_file_name(fileName);
+}
+
+void StreamingReporter::constructProperties()
+{
+    constructProperty_file_name("results.rxs");
+    constructProperty_block_rows(1024);
+    constructProperty_num_buffers(4);
+}
+
+//=============================================================================
+// SETUP
+//=============================================================================
+void StreamingReporter::addToReport(const AbstractOutput& output,
+                                    const std::string& alias)
+{
+    connectInput_inputs(output, alias);
+}
+
+void StreamingReporter::extendConnectToModel(Model& model)
+{
+    Super::extendConnectToModel(model);
+
+    OPENSIM_THROW_IF_FRMOBJ(get_file_name().empty(), Exception,
+                            "Expected a file_name.");
+    OPENSIM_THROW_IF_FRMOBJ(get_block_rows() < 1 || get_num_buffers() < 1,
+                            Exception, "Expected block_rows and num_buffers "
+                            "to be positive.");
+}
+
+/* Columns are labeled with the alias of the connection when it has one and
+ * with the path of the output otherwise, so they are unique in the model.
+ */
+void StreamingReporter::extendRealizeTopology(SimTK::State& s) const
+{
+    Super::extendRealizeTopology(s);
+
+    const Input<double>& input = getInput<double>("inputs");
+    vector<string> labels;
+    for (unsigned i = 0; i < input.getNumConnectees(); ++i) {
+        const string& alias = input.getAlias(i);
+        labels.push_back(alias.empty() ? input.getChannel(i).getPathName()
+                                       : alias);
+    }
+    _row.assign(labels.size(), 0.0);
+
+    // complete the stream of the previous system before starting over
+    _writer.reset();
+    _writer.reset(new ResultsStreamWriter(get_file_name(), labels,
+                                          get_block_rows(),
+                                          get_num_buffers()));
+}
+
+//=============================================================================
+// REPORTING
+//=============================================================================
+/* The Manager realizes the Report stage once for every accepted step. */
+void StreamingReporter::extendRealizeReport(const SimTK::State& s) const
+{
+    Super::extendRealizeReport(s);
+
+    if (!_writer || _writer->isClosed())
+        return;
+
+    const Input<double>& input = getInput<double>("inputs");
+    for (size_t i = 0; i < _row.size(); ++i)
+        _row[i] = input.getValue(s, (unsigned)i);
+    _writer->appendRow(s.getTime(), _row.data());
+}
+
+long long StreamingReporter::getNumRows() const
+{
+    return _writer ? _writer->getNumRows() : 0;
+}
+
+void StreamingReporter::close() const
+{
+    if (_writer)
+        _writer->close();
+}
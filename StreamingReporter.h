@@ -0,0 +1,131 @@
+#ifndef OPENSIM_StreamingReporter_H_
+#define OPENSIM_StreamingReporter_H_
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim: StreamingReporter.h                          *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+//============================================================================
+// INCLUDE
+//============================================================================
+#include "osimStreamingReporterDLL.h"
+#include "OpenSim/Simulation/Model/ModelComponent.h"
+#include "ResultsStream.h"
+#include <memory>
+
+
+
+namespace OpenSim {
+
+//=============================================================================
+//=============================================================================
+/**
+ * StreamingReporter writes the Outputs connected to its inputs to a results
+ * stream (see ResultsStreamWriter) at every accepted step, while the
+ * simulation runs. Only the connected columns are kept, and they are kept
+ * on disk rather than in memory, so long simulations of large models cost
+ * a few blocks of rows instead of a states table. A background thread
+ * writes the file, so formatting and disk waits stay off the simulation.
+ *
+ * The stream is started over whenever the system is built, and completed by
+ * close() or when the model is destroyed. The program convertReflexResults
+ * turns it into a .sto file when the text is wanted.
+ *
+ * @code
+ * StreamingReporter* reporter = new StreamingReporter("results", "run.rxs");
+ * reporter->addToReport(muscle->getOutput("activation"));
+ * model.addComponent(reporter);
+ * ...
+ * manager.integrate(finalTime);
+ * reporter->close();
+ * @endcode
+ *
+ * A copy of the model gets its own stream when its system is built, so
+ * copies that simulate at the same time need different file names.
+ *
+ * @author  Hjalti Hilmarsson
+ */
+class OSIMSTREAMINGREPORTER_API StreamingReporter : public ModelComponent {
+OpenSim_DECLARE_CONCRETE_OBJECT(StreamingReporter, ModelComponent);
+
+public:
+//=============================================================================
+// INPUT
+//=============================================================================
+    OpenSim_DECLARE_LIST_INPUT(inputs, double, SimTK::Stage::Acceleration,
+        "The signals written to the results stream");
+
+//=============================================================================
+// PROPERTIES
+//=============================================================================
+    OpenSim_DECLARE_PROPERTY(file_name, std::string, "The results stream the inputs are written to");
+    OpenSim_DECLARE_PROPERTY(block_rows, int, "The number of rows gathered in memory before they are handed to the writer thread");
+    OpenSim_DECLARE_PROPERTY(num_buffers, int, "The number of blocks of rows kept in memory; the simulation waits for the disk when all are full");
+
+//=============================================================================
+// METHODS
+//=============================================================================
+    //--------------------------------------------------------------------------
+    // CONSTRUCTION AND DESTRUCTION
+    //--------------------------------------------------------------------------
+    /** Default constructor. */
+    StreamingReporter();
+    StreamingReporter(const std::string& name, const std::string& fileName);
+
+    // Uses default (compiler-generated) destructor, copy constructor and copy
+    // assignment operator. A copy does not share the stream.
+
+    /** Connect output to the inputs, so that it is written as a column
+        labeled with its path or with alias. */
+    void addToReport(const AbstractOutput& output,
+                     const std::string& alias = "");
+
+    /** The number of rows written since the system was built. */
+    long long getNumRows() const;
+
+    /** Write the rows of the simulation and complete the stream. Rows
+        reported afterwards are dropped until the system is built again. */
+    void close() const;
+
+private:
+    // Connect properties to local pointers.  */
+    void constructProperties();
+    // ModelComponent interface to connect this component to its model
+    void extendConnectToModel(Model& aModel) override;
+    // start the stream with a column for every connected output
+    void extendRealizeTopology(SimTK::State& s) const override;
+    // write a row at every accepted step
+    void extendRealizeReport(const SimTK::State& s) const override;
+
+    // the stream of the current system
+    mutable SimTK::ResetOnCopy<std::unique_ptr<ResultsStreamWriter>> _writer;
+    // the row being written
+    mutable std::vector<double> _row;
+
+    //=========================================================================
+};  // END of class StreamingReporter
+
+}; //namespace
+//=============================================================================
+//=============================================================================
+
+#endif // OPENSIM_StreamingReporter_H_
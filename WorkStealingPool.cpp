@@ -0,0 +1,208 @@
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim:  WorkStealingPool.cpp                        *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+
+//=============================================================================
+// INCLUDES
+//=============================================================================
+#include "WorkStealingPool.h"
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+
+using namespace OpenSim;
+using namespace std;
+
+
+namespace {
+
+// the tasks queued on one worker
+struct TaskQueue {
+    mutex lock;
+    deque<int> tasks;
+
+    bool popFront(int& task)
+    {
+        lock_guard<mutex> guard(lock);
+        if (tasks.empty())
+            return false;
+        task = tasks.front();
+        tasks.pop_front();
+        return true;
+    }
+
+    bool popBack(int& task)
+    {
+        lock_guard<mutex> guard(lock);
+        if (tasks.empty())
+            return false;
+        task = tasks.back();
+        tasks.pop_back();
+        return true;
+    }
+};
+
+}
+
+
+// the queues of one batch and the first exception its tasks threw
+struct WorkStealingPool::Batch {
+    const Task* task;
+    int numWorkers;
+    vector<unique_ptr<TaskQueue>> queues;
+    mutex errorLock;
+    exception_ptr error;
+
+    // run tasks as worker w until every queue is empty
+    void work(int w)
+    {
+        int i;
+        for (;;) {
+            bool found = queues[w]->popFront(i);
+            for (int k = 1; !found && k < numWorkers; ++k)
+                found = queues[(w + k) % numWorkers]->popBack(i);
+            if (!found)
+                return;
+
+            try {
+                (*task)(w, i);
+            }
+            catch (...) {
+                lock_guard<mutex> guard(errorLock);
+                if (!error)
+                    error = current_exception();
+            }
+        }
+    }
+};
+
+
+//=============================================================================
+// CONSTRUCTOR(S)
+//=============================================================================
+WorkStealingPool::WorkStealingPool(int numThreads) :
+    _numThreads(numThreads),
+    _batch(nullptr),
+    _generation(0),
+    _numBusy(0),
+    _stopping(false)
+{
+    if (_numThreads <= 0)
+        _numThreads = static_cast<int>(thread::hardware_concurrency());
+    if (_numThreads <= 0)
+        _numThreads = 1;
+
+    // the calling thread of run() is the first worker
+    for (int w = 1; w < _numThreads; ++w)
+        _threads.emplace_back(&WorkStealingPool::serve, this, w);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        lock_guard<mutex> guard(_lock);
+        _stopping = true;
+    }
+    _started.notify_all();
+    for (thread& t : _threads)
+        t.join();
+}
+
+//=============================================================================
+// RUN
+//=============================================================================
+/* No task is added while the batch runs, so a worker that finds every queue
+ * empty is done. Every thread of the pool takes part in every batch, those
+ * beyond its number of workers without work, so that the batch outlives
+ * all of them.
+ */
+void WorkStealingPool::run(int numTasks, const Task& task) const
+{
+    if (numTasks <= 0)
+        return;
+
+    lock_guard<mutex> turn(_runLock);
+
+    Batch batch;
+    batch.task = &task;
+    batch.numWorkers = min(_numThreads, numTasks);
+    for (int w = 0; w < batch.numWorkers; ++w) {
+        batch.queues.emplace_back(new TaskQueue());
+        int begin = static_cast<int>(static_cast<long long>(numTasks)*w/batch.numWorkers);
+        int end = static_cast<int>(static_cast<long long>(numTasks)*(w+1)/batch.numWorkers);
+        for (int i = begin; i < end; ++i)
+            batch.queues[w]->tasks.push_back(i);
+    }
+
+    if (batch.numWorkers > 1) {
+        {
+            lock_guard<mutex> guard(_lock);
+            _batch = &batch;
+            _numBusy = static_cast<int>(_threads.size());
+            ++_generation;
+        }
+        _started.notify_all();
+    }
+
+    batch.work(0);
+
+    if (batch.numWorkers > 1) {
+        unique_lock<mutex> guard(_lock);
+        _finished.wait(guard, [this] { return _numBusy == 0; });
+        _batch = nullptr;
+    }
+
+    if (batch.error)
+        rethrow_exception(batch.error);
+}
+
+void WorkStealingPool::serve(int w)
+{
+    long long generation = 0;
+    for (;;) {
+        Batch* batch;
+        {
+            unique_lock<mutex> guard(_lock);
+            _started.wait(guard, [&] {
+                return _stopping || _generation != generation;
+            });
+            if (_stopping)
+                return;
+            generation = _generation;
+            batch = _batch;
+        }
+
+        if (w < batch->numWorkers)
+            batch->work(w);
+
+        lock_guard<mutex> guard(_lock);
+        if (--_numBusy == 0)
+            _finished.notify_one();
+    }
+}
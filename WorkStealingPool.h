@@ -0,0 +1,110 @@
+#ifndef OPENSIM_WorkStealingPool_H_
+#define OPENSIM_WorkStealingPool_H_
+/* -------------------------------------------------------------------------- *
+ *                      OpenSim: WorkStealingPool.h                           *
+ * -------------------------------------------------------------------------- *
+ * The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+ * See http://opensim.stanford.edu and the NOTICE file for more information.  *
+ * OpenSim is developed at Stanford University and supported by the US        *
+ * National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+ * through the Warrior Web program.                                           *
+ *                                                                            *
+ * Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+ * Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+ * not use this file except in compliance with the License. You may obtain a  *
+ * copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ * -------------------------------------------------------------------------- */
+
+
+//============================================================================
+// INCLUDE
+//============================================================================
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+
+namespace OpenSim {
+
+//=============================================================================
+//=============================================================================
+/**
+ * WorkStealingPool runs a batch of independent tasks on a fixed number of
+ * threads. Every worker starts with a contiguous share of the tasks in its
+ * own queue and takes them from the front; a worker whose queue is empty
+ * steals from the back of another's. Long and short tasks therefore balance
+ * out without a shared queue that every task has to contend on.
+ *
+ * Tasks are told which worker runs them, so that each worker can own state
+ * that is expensive to build, such as a Model and its System, and reuse it
+ * for all of its tasks.
+ *
+ * The worker threads are started with the pool and wait for the batches
+ * given to run(), so that a run costs a wake-up rather than starting and
+ * joining threads. They are joined when the pool is destroyed.
+ *
+ * @author  Hjalti Hilmarsson
+ */
+class WorkStealingPool {
+
+public:
+    /** A task: called with the index of the worker that runs it and the
+        index of the task. */
+    typedef std::function<void(int worker, int task)> Task;
+
+    /** Create a pool of numThreads workers, or of one per hardware thread
+        when numThreads is not positive. */
+    explicit WorkStealingPool(int numThreads = 0);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    int getNumThreads() const { return _numThreads; }
+
+    /** Run task for the task indices 0 to numTasks-1 and return when all
+        are done. The calling thread is worker 0. The tasks of one worker
+        run one after the other. If tasks throw, the remaining tasks still
+        run and the first exception is rethrown here. Runs from several
+        threads take turns; a task must not run the pool it runs on. */
+    void run(int numTasks, const Task& task) const;
+
+private:
+    struct Batch;
+
+    // wait for batches and work on them as worker w until the pool stops
+    void serve(int w);
+
+    int _numThreads;
+    std::vector<std::thread> _threads;
+
+    // the batch being run, handed to the workers under _lock; every batch
+    // gets a new generation, and run() waits until no worker is busy on it
+    mutable std::mutex _runLock;
+    mutable std::mutex _lock;
+    mutable std::condition_variable _started;
+    mutable std::condition_variable _finished;
+    mutable Batch* _batch;
+    mutable long long _generation;
+    mutable int _numBusy;
+    bool _stopping;
+
+    //=========================================================================
+};  // END of class WorkStealingPool
+
+}; //namespace
+//=============================================================================
+//=============================================================================
+
+#endif // OPENSIM_WorkStealingPool_H_
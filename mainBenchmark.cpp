@@ -0,0 +1,178 @@
+/* -------------------------------------------------------------------------- *
+*                         OpenSim:  mainBenchmark.cpp                        *
+* -------------------------------------------------------------------------- *
+* The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+* See http://opensim.stanford.edu and the NOTICE file for more information.  *
+* OpenSim is developed at Stanford University and supported by the US        *
+* National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+* through the Warrior Web program.                                           *
+*                                                                            *
+* Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+* Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+*                                                                            *
+* Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+* not use this file except in compliance with the License. You may obtain a  *
+* copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+*                                                                            *
+* Unless required by applicable law or agreed to in writing, software        *
+* distributed under the License is distributed on an "AS IS" BASIS,          *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+* See the License for the specific language governing permissions and        *
+* limitations under the License.                                             *
+* -------------------------------------------------------------------------- */
+
+//=============================================================================
+//=============================================================================
+#include <OpenSim/OpenSim.h>
+#include "GolgiTendon.h"
+#include "ReflexController.h"
+#include "ReflexModelGenerator.h"
+#include "SimpleSpindle.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <string>
+
+using namespace OpenSim;
+using namespace SimTK;
+
+//_____________________________________________________________________________
+/**
+ * Add the reflex controls into controls the way the controller did before
+ * it resolved its lookups once: every evaluation finds the muscle through
+ * the spindle's socket and the Golgi tendon organ by name, re-reads the
+ * muscle constants and adds in through a temporary Vector per muscle.
+ */
+static void computeControlsByLookup(const Model& model,
+                                    const ReflexController& controller,
+                                    const SimTK::State& s,
+                                    SimTK::Vector& controls)
+{
+    double k_l = controller.getGainLength(s);
+    double k_v = controller.getGainVelocity(s);
+
+    const Set<const SimpleSpindle>& spindles = controller.getSpindleSet();
+    for (int i = 0; i < spindles.getSize(); i++) {
+        const SimpleSpindle& spindle = spindles.get(i);
+        const Muscle& musc = spindle.getConnectee<Muscle>("muscle");
+        const GolgiTendon& golgi =
+                model.getComponent<GolgiTendon>("golgi_" + musc.getName());
+
+        double stretch = spindle.getSpindleLength(s);
+        double speed = spindle.getSpindleSpeed(s);
+        double tendon_length = golgi.getTendonLength(s);
+
+        double f_o = musc.getOptimalFiberLength();
+        double t_o = musc.getTendonSlackLength();
+        double max_speed = f_o*musc.getMaxContractionVelocity();
+
+        double control = 0.5*k_l*(fabs(stretch)+stretch)/f_o;
+        control += 0.5*k_v*(fabs(speed)+speed)/max_speed;
+        control += 0.5*k_l*(fabs(tendon_length)+tendon_length)/t_o;
+
+        SimTK::Vector actControls(1, control);
+        musc.addInControls(actControls, controls);
+    }
+}
+
+//_____________________________________________________________________________
+/**
+ * Time the reflex controls for models with increasing numbers of muscles,
+ * both through ReflexController::computeControls and through the lookups
+ * it replaced, and report the cost per call and per muscle of each and the
+ * speed-up. Every timed call first invalidates the state's Position cache
+ * and realizes Velocity again, so the afferents and the controls are
+ * computed anew as in a simulation; the time of realizing alone is measured
+ * the same way and subtracted.
+ *
+ * Usage: benchReflexController [iterations] [muscles...]
+ */
+int main(int argc, char* argv[]) {
+
+    try {
+        int iterations = argc > 1 ? std::atoi(argv[1]) : 10000;
+        std::vector<int> muscleCounts;
+        for (int i = 2; i < argc; i++)
+            muscleCounts.push_back(std::atoi(argv[i]));
+        if (muscleCounts.empty())
+            muscleCounts = {1, 10, 100, 1000};
+
+        std::cout << "reflex kernel: " << getReflexKernelName() << std::endl;
+        std::cout << "muscles\trealize_ns\tindexed_ns/call\tindexed_ns/muscle"
+                  << "\tlookup_ns/call\tlookup_ns/muscle\tspeedup" << std::endl;
+        for (int nMuscles : muscleCounts) {
+            // a block pulled by nMuscles muscles
+            ReflexModelSpec spec;
+            spec.numMuscles = nMuscles;
+            Model osimModel;
+            const ReflexController& controller =
+                    generateReflexModel(spec, osimModel);
+
+            SimTK::State& si = osimModel.initSystem();
+            osimModel.equilibrateMuscles(si);
+            const MultibodySystem& system = osimModel.getMultibodySystem();
+
+            SimTK::Vector controls(osimModel.getNumControls(), 0.0);
+            SimTK::Vector expected(osimModel.getNumControls(), 0.0);
+
+            auto realizeAgain = [&]() {
+                si.invalidateAllCacheAtOrAbove(Stage::Position);
+                system.realize(si, Stage::Velocity);
+            };
+            auto indexed = [&]() {
+                realizeAgain();
+                controller.computeControls(si, controls);
+            };
+            auto lookup = [&]() {
+                realizeAgain();
+                computeControlsByLookup(osimModel, controller, si, expected);
+            };
+
+            // both paths must add in the same controls
+            controls = 0;
+            expected = 0;
+            indexed();
+            lookup();
+            for (int i = 0; i < controls.size(); i++) {
+                if (std::abs(controls[i] - expected[i]) >
+                        1e-12*std::max(1.0, std::abs(expected[i])))
+                    throw Exception("The indexed and looked up controls "
+                                    "differ for control " + std::to_string(i));
+            }
+
+            // ns per call of f, after warming up the caches and histories
+            auto time = [&](const std::function<void()>& f) {
+                for (int i = 0; i < 100; i++)
+                    f();
+                auto start = std::chrono::steady_clock::now();
+                for (int i = 0; i < iterations; i++)
+                    f();
+                auto stop = std::chrono::steady_clock::now();
+                return std::chrono::duration<double, std::nano>(stop - start)
+                        .count()/iterations;
+            };
+            double realizeNs = time(realizeAgain);
+            double indexedNs = std::max(0.0, time(indexed) - realizeNs);
+            double lookupNs = std::max(0.0, time(lookup) - realizeNs);
+
+            std::cout << nMuscles << "\t" << realizeNs
+                      << "\t" << indexedNs << "\t" << indexedNs/nMuscles
+                      << "\t" << lookupNs << "\t" << lookupNs/nMuscles
+                      << "\t" << (indexedNs > 0 ? lookupNs/indexedNs : 0.0)
+                      << std::endl;
+        }
+    }
+
+    catch(const std::exception& ex){
+        std::cout << ex.what() << std::endl;
+        return 1;
+    }
+
+    catch(...){
+        std::cout << "UNRECOGNIZED EXCEPTION" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,198 @@
+/* -------------------------------------------------------------------------- *
+*                      OpenSim:  mainConvert.cpp                             *
+* -------------------------------------------------------------------------- *
+* The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+* See http://opensim.stanford.edu and the NOTICE file for more information.  *
+* OpenSim is developed at Stanford University and supported by the US        *
+* National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+* through the Warrior Web program.                                           *
+*                                                                            *
+* Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+* Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+*                                                                            *
+* Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+* not use this file except in compliance with the License. You may obtain a  *
+* copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+*                                                                            *
+* Unless required by applicable law or agreed to in writing, software        *
+* distributed under the License is distributed on an "AS IS" BASIS,          *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+* See the License for the specific language governing permissions and        *
+* limitations under the License.                                             *
+* -------------------------------------------------------------------------- */
+
+//=============================================================================
+//=============================================================================
+#include <OpenSim/OpenSim.h>
+#include "OpenSim/Common/STOFileAdapter.h"
+#include "ColumnFile.h"
+#include "ResultsStream.h"
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+using namespace OpenSim;
+
+static bool hasExtension(const std::string& name, const std::string& ext)
+{
+    return name.size() >= ext.size() &&
+           name.compare(name.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+/* The indices in labels of the comma separated columnList, or of all labels
+ * when it is empty. */
+static std::vector<int> selectColumns(const std::vector<std::string>& labels,
+                                      const std::string& columnList,
+                                      const std::string& fileName)
+{
+    std::vector<int> kept;
+    if (columnList.empty()) {
+        for (int c = 0; c < (int)labels.size(); ++c)
+            kept.push_back(c);
+        return kept;
+    }
+    std::stringstream list(columnList);
+    std::string label;
+    while (std::getline(list, label, ',')) {
+        auto it = std::find(labels.begin(), labels.end(), label);
+        if (it == labels.end())
+            throw Exception("'" + fileName + "' has no column '" + label +
+                            "'.");
+        kept.push_back(int(it - labels.begin()));
+    }
+    return kept;
+}
+
+static TimeSeriesTable createTable(const std::vector<std::string>& labels,
+                                   const std::vector<int>& kept)
+{
+    std::vector<std::string> keptLabels;
+    for (int c : kept)
+        keptLabels.push_back(labels[c]);
+    TimeSeriesTable table;
+    table.setColumnLabels(keptLabels);
+    return table;
+}
+
+/* Every n-th row of the kept columns of a results stream. */
+static TimeSeriesTable readStream(const std::string& fileName,
+                                  const std::string& columnList, int every)
+{
+    ResultsStreamReader reader(fileName);
+    const std::vector<std::string>& labels = reader.getColumnLabels();
+    const std::vector<int> kept = selectColumns(labels, columnList, fileName);
+    TimeSeriesTable table = createTable(labels, kept);
+
+    std::vector<double> time;
+    std::vector<std::vector<double>> columns;
+    SimTK::RowVector row((int)kept.size());
+    long long r = 0;
+    while (reader.readBlock(time, columns)) {
+        for (size_t k = 0; k < time.size(); ++k, ++r) {
+            if (r % every != 0)
+                continue;
+            for (size_t j = 0; j < kept.size(); ++j)
+                row[(int)j] = columns[kept[j]][k];
+            table.appendRow(time[k], row);
+        }
+    }
+    if (!reader.isComplete())
+        std::cout << "'" << fileName << "' was not completed; converted "
+                  << "the rows written before it stopped." << std::endl;
+    return table;
+}
+
+/* Every n-th row of the kept columns of a column file, which are the only
+ * ones read. */
+static TimeSeriesTable readColumns(const std::string& fileName,
+                                   const std::string& columnList, int every)
+{
+    ColumnFile file(fileName);
+    // the time is not one of the columns of a table
+    std::vector<std::string> labels(file.getColumnLabels().begin() + 1,
+                                    file.getColumnLabels().end());
+    const std::vector<int> kept = selectColumns(labels, columnList, fileName);
+    TimeSeriesTable table = createTable(labels, kept);
+
+    std::vector<ColumnSpan> columns;
+    for (int c : kept)
+        columns.push_back(file.getColumn(c + 1));
+    const ColumnSpan time = file.getTime();
+
+    SimTK::RowVector row((int)kept.size());
+    for (size_t r = 0; r < time.size; r += every) {
+        for (size_t j = 0; j < columns.size(); ++j)
+            row[(int)j] = columns[j][r];
+        table.appendRow(time[r], row);
+    }
+    return table;
+}
+
+//_____________________________________________________________________________
+/**
+ * Convert the results streams written by a StreamingReporter. A stream
+ * becomes a column file (.rxc, see ColumnFile) for fast access or a .sto
+ * file, and a column file becomes a .sto file. For .sto files --columns
+ * keeps only the listed columns and --every keeps every n-th row.
+ *
+ * Usage: convertReflexResults in.rxs|in.rxc out.sto|out.rxc
+ *            [--columns label,...] [--every n]
+ */
+int main(int argc, char* argv[]) {
+
+    try {
+        if (argc < 3)
+            throw Exception("Usage: convertReflexResults in.rxs|in.rxc "
+                            "out.sto|out.rxc [--columns label,...] "
+                            "[--every n]");
+        std::string inName = argv[1];
+        std::string outName = argv[2];
+        std::string columnList;
+        int every = 1;
+
+        for (int i = 3; i < argc; i++) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc)
+                throw Exception("Missing value for " + arg);
+            std::string value = argv[++i];
+            if (arg == "--columns")
+                columnList = value;
+            else if (arg == "--every")
+                every = std::atoi(value.c_str());
+            else
+                throw Exception("Unknown option " + arg);
+        }
+        if (every < 1)
+            throw Exception("Expected --every to be positive.");
+
+        const bool fromColumns = hasExtension(inName, ".rxc");
+        if (hasExtension(outName, ".rxc")) {
+            if (fromColumns)
+                throw Exception("'" + inName + "' is a column file already.");
+            if (!columnList.empty() || every != 1)
+                throw Exception("--columns and --every are for .sto files.");
+            convertResultsStream(inName, outName);
+            std::cout << "Wrote " << outName << std::endl;
+            return 0;
+        }
+
+        TimeSeriesTable table = fromColumns
+                ? readColumns(inName, columnList, every)
+                : readStream(inName, columnList, every);
+        STOFileAdapter_<double>::write(table, outName);
+        std::cout << "Wrote " << table.getNumRows() << " rows to "
+                  << outName << std::endl;
+    }
+
+    catch(const std::exception& ex){
+        std::cout << ex.what() << std::endl;
+        return 1;
+    }
+
+    catch(...){
+        std::cout << "UNRECOGNIZED EXCEPTION" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,174 @@
+/* -------------------------------------------------------------------------- *
+*                      OpenSim:  mainFit.cpp                                 *
+* -------------------------------------------------------------------------- *
+* The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+* See http://opensim.stanford.edu and the NOTICE file for more information.  *
+* OpenSim is developed at Stanford University and supported by the US        *
+* National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+* through the Warrior Web program.                                           *
+*                                                                            *
+* Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+* Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+*                                                                            *
+* Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+* not use this file except in compliance with the License. You may obtain a  *
+* copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+*                                                                            *
+* Unless required by applicable law or agreed to in writing, software        *
+* distributed under the License is distributed on an "AS IS" BASIS,          *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+* See the License for the specific language governing permissions and        *
+* limitations under the License.                                             *
+* -------------------------------------------------------------------------- */
+
+//=============================================================================
+//=============================================================================
+#include <OpenSim/OpenSim.h>
+#include "RegisterTypes_osimReflexComponents.h"
+#include "ReflexController.h"
+#include "ReflexFitter.h"
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+using namespace OpenSim;
+
+//_____________________________________________________________________________
+/**
+ * Fit the parameters of the ReflexController of a model to recorded EMG or
+ * excitations (see ReflexFitter). Every trial is a pair of tables: its
+ * kinematics, as replayReflexController reads them, and its recording.
+ * --fit lists the parameters to fit, separated by commas, from gain_length,
+ * gain_velocity, normalized_rest_length, delay and golgi_delay; the others
+ * keep the values of the model. The fitted parameters are written as a
+ * parameter set that batchReplayReflex --sets reads.
+ *
+ * Usage: fitReflexController model.osim kinematics.sto emg.sto
+ *            [kinematics.sto emg.sto ...] [--fit names] [--threads n]
+ *            [--generations n] [--population n] [--seed n]
+ *            [--early-stop on|off] [--out parameters.txt]
+ */
+int main(int argc, char* argv[]) {
+
+    try {
+        if (argc < 4)
+            throw Exception("Usage: fitReflexController model.osim "
+                            "kinematics.sto emg.sto [kinematics.sto emg.sto "
+                            "...] [--fit names] [--threads n] "
+                            "[--generations n] [--population n] [--seed n] "
+                            "[--early-stop on|off] [--out parameters.txt]");
+        RegisterTypes_osimReflexComponents();
+
+        std::string modelName = argv[1];
+        std::vector<std::string> trialNames;
+        std::string fitNames = "gain_length,gain_velocity,delay,golgi_delay";
+        std::string outName = "fitted_parameters.txt";
+        int numThreads = 0;
+        ReflexFitter::Settings settings;
+
+        int i = 2;
+        for (; i < argc && std::string(argv[i]).compare(0, 2, "--") != 0; ++i)
+            trialNames.push_back(argv[i]);
+        for (; i < argc; i++) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc)
+                throw Exception("Missing value for " + arg);
+            std::string value = argv[++i];
+            if (arg == "--fit")
+                fitNames = value;
+            else if (arg == "--threads")
+                numThreads = std::atoi(value.c_str());
+            else if (arg == "--generations")
+                settings.maxGenerations = std::atoi(value.c_str());
+            else if (arg == "--population")
+                settings.populationSize = std::atoi(value.c_str());
+            else if (arg == "--seed")
+                settings.seed = (unsigned)std::atol(value.c_str());
+            else if (arg == "--early-stop")
+                settings.earlyTermination = value != "off";
+            else if (arg == "--out")
+                outName = value;
+            else
+                throw Exception("Unknown option " + arg);
+        }
+        if (trialNames.empty() || trialNames.size() % 2 != 0)
+            throw Exception("Expected pairs of kinematics and EMG tables.");
+
+        Model model(modelName);
+        model.setUseVisualizer(false);
+        SimTK::State& s = model.initSystem();
+        const ReflexController* controller = nullptr;
+        for (const ReflexController& c :
+                model.getComponentList<ReflexController>()) {
+            controller = &c;
+            break;
+        }
+        if (!controller)
+            throw Exception("'" + modelName + "' has no ReflexController.");
+
+        ReflexReplay replay(model, s, *controller);
+        ReflexFitter fitter(replay, numThreads);
+        fitter.updSettings() = settings;
+
+        for (int p = 0; p < ReflexFitter::NumParameters; ++p)
+            fitter.setFixed(ReflexFitter::Parameter(p), true);
+        std::istringstream names(fitNames);
+        std::string name;
+        while (std::getline(names, name, ',')) {
+            ReflexFitter::Parameter p = ReflexFitter::findParameter(name);
+            if (p == ReflexFitter::NumParameters)
+                throw Exception("Unknown parameter '" + name + "'");
+            fitter.setFixed(p, false);
+        }
+
+        for (size_t n = 0; n < trialNames.size(); n += 2)
+            fitter.addTrial(replay.createTrial(TimeSeriesTable(trialNames[n])),
+                            TimeSeriesTable(trialNames[n + 1]));
+
+        const ReflexReplay::Parameters& initial =
+                replay.getDefaultParameters();
+        std::cout << "Fitting " << fitNames << " to "
+                  << fitter.getNumTrials() << " trials on "
+                  << fitter.getNumThreads() << " threads; initial cost "
+                  << fitter.calcCost(initial) << std::endl;
+
+        ReflexFitter::Result result = fitter.fit(initial);
+        const ReflexReplay::Parameters& p = result.parameters;
+
+        std::ofstream out(outName);
+        if (!out)
+            throw Exception("Could not open '" + outName + "' for writing.");
+        out << "# gain_length gain_velocity normalized_rest_length delay "
+               "golgi_delay\n"
+            << p.gainLength << " " << p.gainVelocity << " "
+            << p.normalizedRestLength << " " << p.delay << " "
+            << p.golgiDelay << "\n";
+
+        std::cout << (result.converged ? "Converged" : "Stopped")
+                  << " after " << result.generations << " generations, "
+                  << result.evaluations << " evaluations ("
+                  << result.terminated << " stopped early) in "
+                  << result.seconds << " s: "
+                  << result.evaluations/result.seconds << " evaluations/s, "
+                  << result.replays/result.seconds << " replays/s\n"
+                  << "  cost " << result.cost << "\n"
+                  << "  gain_length " << p.gainLength
+                  << ", gain_velocity " << p.gainVelocity
+                  << ", normalized_rest_length " << p.normalizedRestLength
+                  << ", delay " << p.delay
+                  << ", golgi_delay " << p.golgiDelay << "\n"
+                  << "Wrote " << outName << std::endl;
+    }
+
+    catch(const std::exception& ex){
+        std::cout << ex.what() << std::endl;
+        return 1;
+    }
+
+    catch(...){
+        std::cout << "UNRECOGNIZED EXCEPTION" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
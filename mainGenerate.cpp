@@ -0,0 +1,93 @@
+/* -------------------------------------------------------------------------- *
+*                         OpenSim:  mainGenerate.cpp                         *
+* -------------------------------------------------------------------------- *
+* The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+* See http://opensim.stanford.edu and the NOTICE file for more information.  *
+* OpenSim is developed at Stanford University and supported by the US        *
+* National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+* through the Warrior Web program.                                           *
+*                                                                            *
+* Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+* Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+*                                                                            *
+* Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+* not use this file except in compliance with the License. You may obtain a  *
+* copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+*                                                                            *
+* Unless required by applicable law or agreed to in writing, software        *
+* distributed under the License is distributed on an "AS IS" BASIS,          *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+* See the License for the specific language governing permissions and        *
+* limitations under the License.                                             *
+* -------------------------------------------------------------------------- */
+
+//=============================================================================
+//=============================================================================
+#include <OpenSim/OpenSim.h>
+#include "ReflexModelGenerator.h"
+#include <cstdlib>
+
+using namespace OpenSim;
+
+//_____________________________________________________________________________
+/**
+ * Write a synthetic reflex model (see ReflexModelSpec) to an .osim file.
+ *
+ * Usage: generateReflexModel [--bodies n] [--muscles m]
+ *            [--topology parallel|chain|tree] [--delay d] [--bank]
+ *            [--snapshots] [--out file.osim]
+ */
+int main(int argc, char* argv[]) {
+
+    try {
+        ReflexModelSpec spec;
+        std::string outName;
+
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--bank") {
+                spec.useDelayBank = true;
+                continue;
+            }
+            if (arg == "--snapshots") {
+                spec.useSnapshots = true;
+                continue;
+            }
+            if (i + 1 >= argc)
+                throw Exception("Missing value for " + arg);
+            std::string value = argv[++i];
+            if (arg == "--bodies")
+                spec.numBodies = std::atoi(value.c_str());
+            else if (arg == "--muscles")
+                spec.numMuscles = std::atoi(value.c_str());
+            else if (arg == "--topology")
+                spec.topology = ReflexModelSpec::parseTopology(value);
+            else if (arg == "--delay")
+                spec.delay = std::atof(value.c_str());
+            else if (arg == "--out")
+                outName = value;
+            else
+                throw Exception("Unknown option " + arg);
+        }
+
+        Model model;
+        generateReflexModel(spec, model);
+        model.finalizeConnections();
+        if (outName.empty())
+            outName = model.getName() + ".osim";
+        model.print(outName);
+        std::cout << "Wrote " << outName << std::endl;
+    }
+
+    catch(const std::exception& ex){
+        std::cout << ex.what() << std::endl;
+        return 1;
+    }
+
+    catch(...){
+        std::cout << "UNRECOGNIZED EXCEPTION" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
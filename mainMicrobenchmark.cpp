@@ -0,0 +1,413 @@
+/* -------------------------------------------------------------------------- *
+*                       OpenSim:  mainMicrobenchmark.cpp                     *
+* -------------------------------------------------------------------------- *
+* The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+* See http://opensim.stanford.edu and the NOTICE file for more information.  *
+* OpenSim is developed at Stanford University and supported by the US        *
+* National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+* through the Warrior Web program.                                           *
+*                                                                            *
+* Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+* Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+*                                                                            *
+* Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+* not use this file except in compliance with the License. You may obtain a  *
+* copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+*                                                                            *
+* Unless required by applicable law or agreed to in writing, software        *
+* distributed under the License is distributed on an "AS IS" BASIS,          *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+* See the License for the specific language governing permissions and        *
+* limitations under the License.                                             *
+* -------------------------------------------------------------------------- */
+
+//=============================================================================
+//=============================================================================
+#include <OpenSim/OpenSim.h>
+#include "SimpleSpindle.h"
+#include "GolgiTendon.h"
+#include "Delay.h"
+#include "DelayLine.h"
+#include "ReflexController.h"
+#include "ReflexModelGenerator.h"
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <thread>
+
+using namespace OpenSim;
+using namespace SimTK;
+
+// the spacing of the recorded samples; a history of n samples spans a delay
+// of n*resolution
+static const double resolution = 1.0e-4;
+
+// keeps the benchmarked results alive
+static volatile double sink;
+
+struct Result {
+    std::string name;
+    std::string family;
+    long long historyLength;
+    long long iterations;
+    double realTime;
+    double cpuTime;
+    // the cost of the setup every iteration repeats, already subtracted
+    double baselineTime;
+};
+
+struct Timing {
+    long long iterations;
+    double realTime;
+    double cpuTime;
+};
+
+//_____________________________________________________________________________
+/**
+ * Time f per call in ns, repeating it until the batch takes at least minTime
+ * seconds, as Google Benchmark does.
+ */
+template <class F>
+static Timing measure(F f, double minTime)
+{
+    long long iterations = 1;
+    for (;;) {
+        std::clock_t cpuStart = std::clock();
+        auto start = std::chrono::steady_clock::now();
+        for (long long i = 0; i < iterations; ++i)
+            f();
+        double elapsed = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+        double cpu = double(std::clock() - cpuStart)/CLOCKS_PER_SEC;
+
+        if (elapsed >= minTime || iterations >= 1000000000LL) {
+            Timing timing;
+            timing.iterations = iterations;
+            timing.realTime = 1.0e9*elapsed/iterations;
+            timing.cpuTime = 1.0e9*cpu/iterations;
+            return timing;
+        }
+        double scale = elapsed > 0 ? 1.4*minTime/elapsed : 10.0;
+        iterations = std::max(iterations + 1,
+                static_cast<long long>(iterations*std::min(scale, 10.0)));
+    }
+}
+
+class Suite {
+public:
+    Suite(const std::string& filter, double minTime) :
+        _filter(filter), _minTime(minTime) {}
+
+    bool selected(const std::string& name) const
+    {
+        return _filter.empty() || name.find(_filter) != std::string::npos;
+    }
+
+    // time f, less the time of baseline if there is one
+    template <class F>
+    void run(const std::string& family, long long historyLength, F f,
+             const Timing* baseline = nullptr)
+    {
+        std::string name = family + "/" + std::to_string(historyLength);
+        if (!selected(name))
+            return;
+
+        Timing timing = measure(f, _minTime);
+        Result result;
+        result.name = name;
+        result.family = family;
+        result.historyLength = historyLength;
+        result.iterations = timing.iterations;
+        result.realTime = timing.realTime;
+        result.cpuTime = timing.cpuTime;
+        result.baselineTime = 0;
+        if (baseline) {
+            result.realTime = std::max(0.0, timing.realTime - baseline->realTime);
+            result.cpuTime = std::max(0.0, timing.cpuTime - baseline->cpuTime);
+            result.baselineTime = baseline->realTime;
+        }
+        _results.push_back(result);
+
+        std::cout << name << "\t" << result.realTime << "\t"
+                  << result.cpuTime << "\t" << result.iterations << std::endl;
+    }
+
+    Timing time(std::function<void()> f) const { return measure(f, _minTime); }
+
+    const std::vector<Result>& getResults() const { return _results; }
+
+private:
+    std::string _filter;
+    double _minTime;
+    std::vector<Result> _results;
+};
+
+//_____________________________________________________________________________
+/**
+ * Benchmark pushing to and querying a DelayLine holding historyLength
+ * samples, with samples pushed in time order and with every other push
+ * stepping back half a sample, as an integrator retrying a step does.
+ */
+static void benchmarkDelayLine(Suite& suite, long long historyLength)
+{
+    double delay = historyLength*resolution;
+    int n = static_cast<int>(historyLength) + 2;
+
+    DelayLine line;
+    line.allocate(delay, resolution);
+    for (int k = 0; k < n; ++k)
+        line.push(k*resolution, std::sin(k*resolution));
+
+    long long k = n;
+    suite.run("DelayLine::push/in_order", historyLength, [&]() {
+        line.push(k*resolution, 1.0);
+        ++k;
+    });
+
+    long long j = 0;
+    double t0 = line.getNewestTime();
+    suite.run("DelayLine::push/out_of_order", historyLength, [&]() {
+        double step = (j % 2 == 0) ? j + 2.0 : j + 0.5;
+        line.push(t0 + step*resolution, 1.0);
+        ++j;
+    });
+
+    double t = line.getNewestTime();
+    suite.run("DelayLine::getDelayedValue/search", historyLength, [&]() {
+        sink = line.getDelayedValue(t - 0.37*resolution, 1.0);
+    });
+
+    DelayLine uniform;
+    uniform.allocateUniform(delay, resolution);
+    for (int i = 0; i < n; ++i)
+        uniform.push(i*resolution, std::sin(i*resolution));
+    double tu = uniform.getNewestTime() + 0.63*resolution;
+    suite.run("DelayLine::getDelayedValue/uniform", historyLength, [&]() {
+        sink = uniform.getDelayedValue(tu, 1.0);
+    });
+}
+
+//_____________________________________________________________________________
+/**
+ * Benchmark the afferent getters, Delay::getSignal and computeControls on a
+ * one muscle model whose delay histories hold historyLength samples.
+ *
+ * The getters cache their values in the State, so every iteration
+ * invalidates the cache and realizes the stage again. The time of that
+ * alone is measured first and subtracted.
+ */
+static void benchmarkComponents(Suite& suite, long long historyLength)
+{
+    const char* families[] = {
+        "SimpleSpindle::getSpindleLength", "SimpleSpindle::getSpindleSpeed",
+        "GolgiTendon::getTendonLength", "Delay::getSignal",
+        "ReflexController::computeControls"};
+    bool any = false;
+    for (const char* family : families)
+        any = any || suite.selected(family + std::string("/") +
+                                    std::to_string(historyLength));
+    if (!any)
+        return;
+
+    ReflexModelSpec spec;
+    spec.delay = historyLength*resolution;
+    std::unique_ptr<Model> model(new Model());
+    generateReflexModel(spec, *model);
+    model->finalizeFromProperties();
+    for (SimpleSpindle& spindle : model->updComponentList<SimpleSpindle>())
+        spindle.set_history_resolution(resolution);
+    for (GolgiTendon& golgi : model->updComponentList<GolgiTendon>())
+        golgi.set_history_resolution(resolution);
+
+    const Muscle& muscle = dynamic_cast<const Muscle&>(model->getForceSet().get(0));
+    const SimpleSpindle& source = model->getComponent<SimpleSpindle>("spindle_" + muscle.getName());
+    Delay* delay = new Delay("delay_" + muscle.getName(), muscle, spec.delay);
+    delay->set_history_resolution(resolution);
+    delay->connectInput_signal(source.getOutput("spindle_length"));
+    model->addComponent(delay);
+
+    SimTK::State& s = model->initSystem();
+    model->equilibrateMuscles(s);
+    const MultibodySystem& system = model->getMultibodySystem();
+
+    // record the histories as accepted steps would
+    long long n = historyLength + 2;
+    for (long long k = 0; k < n; ++k) {
+        s.setTime(k*resolution);
+        system.realize(s, Stage::Report);
+        s.autoUpdateDiscreteVariables();
+    }
+    s.setTime(n*resolution);
+    system.realize(s, Stage::Velocity);
+
+    const SimpleSpindle& spindle = model->getComponent<SimpleSpindle>("spindle_" + muscle.getName());
+    const GolgiTendon& golgi = model->getComponent<GolgiTendon>("golgi_" + muscle.getName());
+    const Delay& delayed = model->getComponent<Delay>("delay_" + muscle.getName());
+    const ReflexController& controller = *model->getComponentList<ReflexController>().begin();
+    SimTK::Vector controls(model->getNumControls(), 0.0);
+
+    auto realizeAgain = [&](Stage stage) {
+        s.invalidateAllCacheAtOrAbove(Stage::Position);
+        system.realize(s, stage);
+    };
+    Timing position = suite.time([&]() { realizeAgain(Stage::Position); });
+    Timing velocity = suite.time([&]() { realizeAgain(Stage::Velocity); });
+
+    suite.run(families[0], historyLength, [&]() {
+        realizeAgain(Stage::Position);
+        sink = spindle.getSpindleLength(s);
+    }, &position);
+    suite.run(families[1], historyLength, [&]() {
+        realizeAgain(Stage::Velocity);
+        sink = spindle.getSpindleSpeed(s);
+    }, &velocity);
+    suite.run(families[2], historyLength, [&]() {
+        realizeAgain(Stage::Position);
+        sink = golgi.getTendonLength(s);
+    }, &position);
+
+    // the delay reads its input, the cached spindle length, on every call
+    system.realize(s, Stage::Velocity);
+    suite.run(families[3], historyLength, [&]() {
+        sink = delayed.getSignal(s);
+    });
+
+    suite.run(families[4], historyLength, [&]() {
+        realizeAgain(Stage::Velocity);
+        controller.computeControls(s, controls);
+        sink = controls[0];
+    }, &velocity);
+}
+
+//_____________________________________________________________________________
+/**
+ * Write the results in the JSON layout of Google Benchmark, so its tools
+ * can compare two runs.
+ */
+static void writeJson(std::ostream& out, const std::vector<Result>& results,
+                      const std::string& executable)
+{
+    char date[64];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+    out << "{\n  \"context\": {\n"
+        << "    \"date\": \"" << date << "\",\n"
+        << "    \"executable\": \"" << executable << "\",\n"
+        << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+        << "    \"reflex_kernel\": \"" << getReflexKernelName() << "\",\n"
+#ifdef NDEBUG
+        << "    \"library_build_type\": \"release\"\n"
+#else
+        << "    \"library_build_type\": \"debug\"\n"
+#endif
+        << "  },\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        out << (i ? ",\n" : "\n")
+            << "    {\n"
+            << "      \"name\": \"" << r.name << "\",\n"
+            << "      \"run_name\": \"" << r.name << "\",\n"
+            << "      \"run_type\": \"iteration\",\n"
+            << "      \"iterations\": " << r.iterations << ",\n"
+            << "      \"real_time\": " << r.realTime << ",\n"
+            << "      \"cpu_time\": " << r.cpuTime << ",\n"
+            << "      \"time_unit\": \"ns\",\n"
+            << "      \"history_length\": " << r.historyLength << ",\n"
+            << "      \"baseline_time\": " << r.baselineTime << "\n"
+            << "    }";
+    }
+    out << "\n  ]\n}\n";
+}
+
+//_____________________________________________________________________________
+/**
+ * Time the delay histories and the functions that read them for history
+ * lengths from 10 to maxLength samples, print the time per call in ns and
+ * how it grows from the shortest to the longest history, and optionally
+ * write the results as JSON.
+ *
+ * Usage: microbenchReflex [--filter substring] [--min-time seconds]
+ *            [--max-length n] [--out results.json]
+ */
+int main(int argc, char* argv[]) {
+
+    try {
+        std::string filter, outName;
+        double minTime = 0.1;
+        long long maxLength = 1000000;
+
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc)
+                throw Exception("Missing value for " + arg);
+            std::string value = argv[++i];
+            if (arg == "--filter")
+                filter = value;
+            else if (arg == "--min-time")
+                minTime = std::atof(value.c_str());
+            else if (arg == "--max-length")
+                maxLength = std::atoll(value.c_str());
+            else if (arg == "--out")
+                outName = value;
+            else
+                throw Exception("Unknown option " + arg);
+        }
+
+        Logger::setLevel(Logger::Level::Warn);
+
+        Suite suite(filter, minTime);
+        std::cout << "benchmark\treal_ns\tcpu_ns\titerations" << std::endl;
+        for (long long length = 10; length <= maxLength; length *= 10) {
+            benchmarkDelayLine(suite, length);
+            benchmarkComponents(suite, length);
+        }
+
+        // a constant cost stays near 1 however long the history grows
+        std::cout << "\nbenchmark\tshortest\tlongest\tratio" << std::endl;
+        const std::vector<Result>& results = suite.getResults();
+        for (size_t i = 0; i < results.size(); ++i) {
+            const Result* shortest = nullptr;
+            const Result* longest = nullptr;
+            bool first = true;
+            for (size_t j = 0; j < results.size(); ++j) {
+                if (results[j].family != results[i].family)
+                    continue;
+                if (j < i)
+                    first = false;
+                if (!shortest || results[j].historyLength < shortest->historyLength)
+                    shortest = &results[j];
+                if (!longest || results[j].historyLength > longest->historyLength)
+                    longest = &results[j];
+            }
+            if (!first || shortest == longest)
+                continue;
+            std::cout << results[i].family << "\t" << shortest->historyLength
+                      << "\t" << longest->historyLength << "\t"
+                      << (shortest->realTime > 0 ? longest->realTime/shortest->realTime : 0.0)
+                      << std::endl;
+        }
+
+        if (!outName.empty()) {
+            std::ofstream out(outName);
+            if (!out)
+                throw Exception("Could not open " + outName);
+            writeJson(out, results, argv[0]);
+        }
+    }
+
+    catch(const std::exception& ex){
+        std::cout << ex.what() << std::endl;
+        return 1;
+    }
+
+    catch(...){
+        std::cout << "UNRECOGNIZED EXCEPTION" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
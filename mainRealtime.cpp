@@ -0,0 +1,328 @@
+/* -------------------------------------------------------------------------- *
+*                      OpenSim:  mainRealtime.cpp                            *
+* -------------------------------------------------------------------------- *
+* The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+* See http://opensim.stanford.edu and the NOTICE file for more information.  *
+* OpenSim is developed at Stanford University and supported by the US        *
+* National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+* through the Warrior Web program.                                           *
+*                                                                            *
+* Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+* Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+*                                                                            *
+* Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+* not use this file except in compliance with the License. You may obtain a  *
+* copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+*                                                                            *
+* Unless required by applicable law or agreed to in writing, software        *
+* distributed under the License is distributed on an "AS IS" BASIS,          *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+* See the License for the specific language governing permissions and        *
+* limitations under the License.                                             *
+* -------------------------------------------------------------------------- */
+
+//=============================================================================
+//=============================================================================
+#include <OpenSim/OpenSim.h>
+#include "SimpleSpindle.h"
+#include "GolgiTendon.h"
+#include "Delay.h"
+#include "DelayBank.h"
+#include "ReflexController.h"
+#include "ReflexModelGenerator.h"
+#include "LatencyHistogram.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <thread>
+
+using namespace OpenSim;
+using namespace SimTK;
+
+// Every heap allocation of the process is counted, so that the loop can
+// report the allocations made while stepping.
+static std::atomic<long long> numAllocations(0);
+
+void* operator new(std::size_t size)
+{
+    ++numAllocations;
+    if (void* p = std::malloc(size > 0 ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+//_____________________________________________________________________________
+/**
+ * A fixed-step integrator by name: euler, rk2, rk3 or merson.
+ */
+static std::unique_ptr<Integrator> createIntegrator(const std::string& name,
+        const MultibodySystem& system, double step)
+{
+    std::unique_ptr<Integrator> integrator;
+    if (name == "euler")
+        integrator.reset(new ExplicitEulerIntegrator(system));
+    else if (name == "rk2")
+        integrator.reset(new RungeKutta2Integrator(system));
+    else if (name == "rk3")
+        integrator.reset(new RungeKutta3Integrator(system));
+    else if (name == "merson")
+        integrator.reset(new RungeKuttaMersonIntegrator(system));
+    else
+        throw Exception("Unknown integrator '" + name + "'");
+    integrator->setFixedStepSize(step);
+    integrator->setAllowInterpolation(false);
+    integrator->setReturnEveryInternalStep(true);
+    return integrator;
+}
+
+static void printLatency(const std::string& name,
+                         const LatencyHistogram& histogram)
+{
+    std::cout << "  " << name << ": p50 "
+              << 1.e-3*histogram.getPercentile(50) << " us, p99 "
+              << 1.e-3*histogram.getPercentile(99) << " us, max "
+              << 1.e-3*histogram.getMax() << " us, mean "
+              << 1.e-3*histogram.getMean() << " us\n";
+}
+
+//_____________________________________________________________________________
+/**
+ * Run a tug of war, a block pulled by reflex controlled muscles (see
+ * ReflexModelSpec), in real time: one fixed integration step per tick of a
+ * wall clock at the given rate, as when the model drives a haptic rig. Each
+ * tick first takes the path the rig's input takes to the muscles: it
+ * realizes a copy of the tick's state whose Position and Velocity stages
+ * were invalidated, as new kinematics invalidate them, and evaluates
+ * ReflexController::computeControls on it. Then it takes the step, which
+ * evaluates the controls again at the integrator's stages. The copy is made
+ * after the previous tick is timed.
+ *
+ * The latency of the controls path and of the whole tick are recorded in
+ * histograms, and a tick that ends after the next one should have started
+ * misses its deadline. Ticks that fall behind are not skipped, so the
+ * simulated time stays locked to the clock. --pace off runs the ticks back
+ * to back to measure the latencies alone.
+ *
+ * The delay histories record one sample per step, so their resolution is
+ * set to half a step: they never merge samples and each holds at most
+ * delay*2*rate + 3 of them, allocated when the system is built. The heap
+ * allocations made while ticking, after the warmup, are counted; any
+ * allocation fails the run with exit code 2.
+ *
+ * Usage: realtimeReflexController [--rate Hz] [--duration s]
+ *            [--muscles n] [--delay s] [--integrator euler|rk2|rk3|merson]
+ *            [--warmup ticks] [--pace on|off] [--histogram latency.tsv]
+ */
+int main(int argc, char* argv[]) {
+
+    try {
+        double rate = 1000;
+        double duration = 5;
+        double delay = 0.03;
+        int numMuscles = 2;
+        int warmup = 100;
+        bool pace = true;
+        std::string integratorName = "merson";
+        std::string histogramName;
+
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc)
+                throw Exception("Missing value for " + arg);
+            std::string value = argv[++i];
+            if (arg == "--rate")
+                rate = std::atof(value.c_str());
+            else if (arg == "--duration")
+                duration = std::atof(value.c_str());
+            else if (arg == "--muscles")
+                numMuscles = std::atoi(value.c_str());
+            else if (arg == "--delay")
+                delay = std::atof(value.c_str());
+            else if (arg == "--integrator")
+                integratorName = value;
+            else if (arg == "--warmup")
+                warmup = std::max(0, std::atoi(value.c_str()));
+            else if (arg == "--pace")
+                pace = value != "off";
+            else if (arg == "--histogram")
+                histogramName = value;
+            else
+                throw Exception("Unknown option " + arg);
+        }
+        if (rate <= 0 || duration <= 0 || numMuscles < 1)
+            throw Exception("Expected a positive rate, duration and number "
+                            "of muscles.");
+        const double step = 1/rate;
+        const long long numTicks = (long long)std::ceil(duration*rate - 1e-9);
+
+        // the tug of war: one block pulled by muscles on opposite sides
+        ReflexModelSpec spec;
+        spec.numBodies = 1;
+        spec.numMuscles = numMuscles;
+        spec.delay = delay;
+        Model model;
+        const ReflexController& controller = generateReflexModel(spec, model);
+        model.setUseVisualizer(false);
+
+        // size the delay histories for one sample per step
+        model.finalizeFromProperties();
+        const double resolution = 0.5*step;
+        for (SimpleSpindle& spindle : model.updComponentList<SimpleSpindle>())
+            spindle.set_history_resolution(resolution);
+        for (GolgiTendon& golgi : model.updComponentList<GolgiTendon>())
+            golgi.set_history_resolution(resolution);
+        for (Delay& component : model.updComponentList<Delay>())
+            component.set_history_resolution(resolution);
+        for (DelayBank& bank : model.updComponentList<DelayBank>())
+            bank.set_history_resolution(resolution);
+
+        SimTK::State& si = model.initSystem();
+        for (const Coordinate& coordinate :
+                model.getComponentList<Coordinate>())
+            coordinate.setValue(si, 0.02);
+        model.equilibrateMuscles(si);
+
+        const MultibodySystem& system = model.getMultibodySystem();
+        std::unique_ptr<Integrator> integrator =
+                createIntegrator(integratorName, system, step);
+        TimeStepper stepper(system, *integrator);
+        stepper.initialize(si);
+        const double initialTime = stepper.getTime();
+
+        SimTK::Vector controls(model.getNumControls(), 0.0);
+        LatencyHistogram controlsLatency;
+        LatencyHistogram tickLatency;
+        long long misses = 0;
+        long long controlsAllocations = 0;
+        long long tickAllocations = 0;
+        long long allocatingTicks = 0;
+        long long firstAllocatingTick = -1;
+        std::chrono::nanoseconds maxLateness(0);
+
+        // the step times are multiples of the step, so they do not drift
+        long long numSteps = 0;
+        auto takeStep = [&]() {
+            ++numSteps;
+            stepper.stepTo(initialTime + numSteps*step);
+            system.realize(stepper.getState(), Stage::Report);
+        };
+
+        // the state the controls path evaluates, with what new kinematics
+        // would invalidate invalidated; copying it is not timed
+        SimTK::State controlsState;
+        auto prepareControlsState = [&]() {
+            controlsState = stepper.getState();
+            controlsState.invalidateAllCacheAtOrAbove(Stage::Position);
+        };
+
+        // the first steps fill the caches and the delay histories
+        for (int k = 0; k < warmup; ++k)
+            takeStep();
+        prepareControlsState();
+
+        typedef std::chrono::steady_clock Clock;
+        const Clock::duration period =
+                std::chrono::duration_cast<Clock::duration>(
+                        std::chrono::duration<double>(step));
+        const Clock::time_point start = Clock::now();
+        for (long long k = 0; k < numTicks; ++k) {
+            Clock::time_point release = start + k*period;
+            if (pace)
+                std::this_thread::sleep_until(release);
+
+            const long long allocations = numAllocations;
+            const Clock::time_point begin = Clock::now();
+            if (!pace)
+                release = begin;
+
+            controls = 0;
+            system.realize(controlsState, Stage::Velocity);
+            controller.computeControls(controlsState, controls);
+            const Clock::time_point computed = Clock::now();
+            const long long computedAllocations = numAllocations;
+
+            takeStep();
+            const Clock::time_point end = Clock::now();
+
+            controlsLatency.record(std::chrono::duration_cast<
+                    std::chrono::nanoseconds>(computed - begin).count());
+            tickLatency.record(std::chrono::duration_cast<
+                    std::chrono::nanoseconds>(end - begin).count());
+            const long long tickAllocated = numAllocations - allocations;
+            controlsAllocations += computedAllocations - allocations;
+            tickAllocations += tickAllocated;
+            if (tickAllocated > 0) {
+                if (allocatingTicks == 0)
+                    firstAllocatingTick = k;
+                ++allocatingTicks;
+            }
+
+            const Clock::time_point deadline = release + period;
+            if (end > deadline) {
+                ++misses;
+                maxLateness = std::max(maxLateness,
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                end - deadline));
+            }
+
+            prepareControlsState();
+        }
+        const double wallTime =
+                std::chrono::duration<double>(Clock::now() - start).count();
+
+        std::cout << "Ran " << numTicks << " ticks of " << 1.e3*step
+                  << " ms (" << integratorName << ", " << numMuscles
+                  << " muscles, delay " << delay << " s) "
+                  << (pace ? "paced at " : "unpaced, budget of ") << rate
+                  << " Hz in " << wallTime << " s\n";
+        printLatency("computeControls", controlsLatency);
+        printLatency("tick", tickLatency);
+        std::cout << "  deadline misses: " << misses << " ("
+                  << 100.0*misses/numTicks << "%), latest by "
+                  << 1.e-3*maxLateness.count() << " us\n"
+                  << "  heap allocations: computeControls "
+                  << controlsAllocations << ", tick " << tickAllocations
+                  << std::endl;
+
+        if (!histogramName.empty()) {
+            std::ofstream out(histogramName);
+            if (!out)
+                throw Exception("Could not open '" + histogramName +
+                                "' for writing.");
+            out << "# computeControls\n";
+            controlsLatency.write(out);
+            out << "# tick\n";
+            tickLatency.write(out);
+            std::cout << "Wrote " << histogramName << std::endl;
+        }
+
+        if (tickAllocations > 0) {
+            std::cout << "FAILED: " << allocatingTicks << " of " << numTicks
+                      << " ticks allocated after the warmup, the first "
+                      << "being tick " << firstAllocatingTick << std::endl;
+            return 2;
+        }
+    }
+
+    catch(const std::exception& ex){
+        std::cout << ex.what() << std::endl;
+        return 1;
+    }
+
+    catch(...){
+        std::cout << "UNRECOGNIZED EXCEPTION" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,395 @@
+/* -------------------------------------------------------------------------- *
+*                        OpenSim:  mainRegression.cpp                        *
+* -------------------------------------------------------------------------- *
+* The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+* See http://opensim.stanford.edu and the NOTICE file for more information.  *
+* OpenSim is developed at Stanford University and supported by the US        *
+* National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+* through the Warrior Web program.                                           *
+*                                                                            *
+* Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+* Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+*                                                                            *
+* Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+* not use this file except in compliance with the License. You may obtain a  *
+* copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+*                                                                            *
+* Unless required by applicable law or agreed to in writing, software        *
+* distributed under the License is distributed on an "AS IS" BASIS,          *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+* See the License for the specific language governing permissions and        *
+* limitations under the License.                                             *
+* -------------------------------------------------------------------------- */
+
+//=============================================================================
+//=============================================================================
+#include <OpenSim/OpenSim.h>
+#include "ReflexModelGenerator.h"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+using namespace OpenSim;
+using namespace SimTK;
+
+// a fixed reflex simulation whose trajectory and cost are tracked
+struct Scenario {
+    std::string name;
+    int numBodies;
+    int numMuscles;
+    ReflexModelSpec::Topology topology;
+    bool useDelayBank;
+};
+
+static const Scenario scenarios[] = {
+    {"tug_of_war", 1, 2, ReflexModelSpec::Parallel, false},
+    {"parallel_10x20_bank", 10, 20, ReflexModelSpec::Parallel, true},
+    {"chain_10x20", 10, 20, ReflexModelSpec::Chain, false},
+    {"tree_63x126", 63, 126, ReflexModelSpec::Tree, false},
+};
+
+// what a scenario costs; the steps and realizations are the same on every
+// machine, the wall time is not
+struct Budget {
+    double wallTime;
+    int steps;
+    int realizations;
+};
+
+//_____________________________________________________________________________
+/**
+ * Simulate a scenario from displaced blocks and record the states and the
+ * muscle forces every reportInterval seconds into trajectory. The integrator
+ * returns after every step and realizes Report there, as the Manager does,
+ * and it ends steps on the report times rather than interpolating to them,
+ * so every recorded state is a step the delay histories saw.
+ */
+static Budget simulate(const Scenario& scenario, double finalTime,
+                       double reportInterval, TimeSeriesTable& trajectory)
+{
+    ReflexModelSpec spec;
+    spec.numBodies = scenario.numBodies;
+    spec.numMuscles = scenario.numMuscles;
+    spec.topology = scenario.topology;
+    spec.useDelayBank = scenario.useDelayBank;
+
+    auto start = std::chrono::steady_clock::now();
+    Model model;
+    generateReflexModel(spec, model);
+    SimTK::State& si = model.initSystem();
+    for (const Coordinate& coordinate : model.getComponentList<Coordinate>())
+        coordinate.setValue(si, 0.02);
+    model.equilibrateMuscles(si);
+
+    const MultibodySystem& system = model.getMultibodySystem();
+    RungeKuttaMersonIntegrator integrator(system);
+    integrator.setAccuracy(1.0e-6);
+    integrator.setReturnEveryInternalStep(true);
+    integrator.setAllowInterpolation(false);
+    TimeStepper stepper(system, integrator);
+    stepper.initialize(si);
+
+    std::vector<std::string> labels;
+    Array<std::string> stateNames = model.getStateVariableNames();
+    for (int i = 0; i < stateNames.getSize(); i++)
+        labels.push_back(stateNames[i]);
+    std::vector<const Muscle*> muscles;
+    for (const Muscle& muscle : model.getComponentList<Muscle>()) {
+        labels.push_back(muscle.getName() + "|actuation");
+        muscles.push_back(&muscle);
+    }
+    trajectory = TimeSeriesTable();
+    trajectory.setColumnLabels(labels);
+
+    auto record = [&](const SimTK::State& s) {
+        system.realize(s, Stage::Dynamics);
+        SimTK::Vector states = model.getStateVariableValues(s);
+        SimTK::RowVector row(static_cast<int>(labels.size()));
+        for (int i = 0; i < states.size(); i++)
+            row[i] = states[i];
+        for (size_t m = 0; m < muscles.size(); m++)
+            row[states.size() + static_cast<int>(m)] = muscles[m]->getActuation(s);
+        trajectory.appendRow(s.getTime(), row);
+    };
+
+    record(stepper.getState());
+    int numReports = static_cast<int>(std::ceil(finalTime/reportInterval - 1e-9));
+    for (int k = 1; k <= numReports; k++) {
+        double reportTime = std::min(k*reportInterval, finalTime);
+        while (stepper.getTime() < reportTime) {
+            stepper.stepTo(reportTime);
+            system.realize(stepper.getState(), Stage::Report);
+        }
+        record(stepper.getState());
+    }
+
+    Budget budget;
+    budget.wallTime = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+    budget.steps = integrator.getNumStepsTaken();
+    budget.realizations = integrator.getNumRealizations();
+    return budget;
+}
+
+//_____________________________________________________________________________
+/**
+ * Compare a trajectory with its golden one, column by column, and return a
+ * description of every column that drifted, or nothing if none did. A value
+ * drifts when it differs by more than atol + rtol*(largest golden value of
+ * its column).
+ */
+static std::string compare(const TimeSeriesTable& trajectory,
+                           const TimeSeriesTable& golden,
+                           double rtol, double atol)
+{
+    std::ostringstream drift;
+    if (trajectory.getNumRows() != golden.getNumRows()) {
+        drift << "  " << trajectory.getNumRows() << " rows, expected "
+              << golden.getNumRows() << "\n";
+        return drift.str();
+    }
+    const std::vector<double>& times = trajectory.getIndependentColumn();
+    const std::vector<double>& goldenTimes = golden.getIndependentColumn();
+    for (size_t r = 0; r < times.size(); r++) {
+        if (std::abs(times[r] - goldenTimes[r]) > atol) {
+            drift << "  row " << r << " is at t = " << times[r]
+                  << ", expected " << goldenTimes[r] << "\n";
+            return drift.str();
+        }
+    }
+
+    for (const std::string& label : golden.getColumnLabels()) {
+        if (!trajectory.hasColumn(label)) {
+            drift << "  column '" << label << "' is missing\n";
+            continue;
+        }
+        auto expected = golden.getDependentColumn(label);
+        auto actual = trajectory.getDependentColumn(label);
+        double scale = 0, error = 0;
+        int worst = 0;
+        for (int r = 0; r < expected.size(); r++) {
+            scale = std::max(scale, std::abs(expected[r]));
+            double e = std::abs(actual[r] - expected[r]);
+            if (e > error) {
+                error = e;
+                worst = r;
+            }
+        }
+        if (error > atol + rtol*scale)
+            drift << "  " << label << " differs by " << error << " at t = "
+                  << times[worst] << "\n";
+    }
+    return drift.str();
+}
+
+// read the steps and realizations of every scenario from a budget file
+static std::map<std::string, Budget> readBudgets(const std::string& fileName)
+{
+    std::map<std::string, Budget> budgets;
+    std::ifstream in(fileName);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream row(line);
+        std::string name;
+        Budget budget;
+        budget.wallTime = 0;
+        if (row >> name >> budget.steps >> budget.realizations)
+            budgets[name] = budget;
+    }
+    return budgets;
+}
+
+// read the wall time of every scenario from a machine's wall time file
+static std::map<std::string, double> readWallTimes(const std::string& fileName)
+{
+    std::map<std::string, double> wallTimes;
+    std::ifstream in(fileName);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream row(line);
+        std::string name;
+        double wallTime;
+        if (row >> name >> wallTime)
+            wallTimes[name] = wallTime;
+    }
+    return wallTimes;
+}
+
+//_____________________________________________________________________________
+/**
+ * Run the reflex regression scenarios, from the tug-of-war block to larger
+ * generated models, and check them against their golden trajectories and
+ * budgets in a directory. The trajectories must match within the
+ * tolerances and the integrator steps and realizations must stay within the
+ * step tolerance of the budget. The golden trajectories and budget.tsv are
+ * deterministic and kept with the sources in testdata/regression, which
+ * CMake passes to the checkReflexRegression test.
+ *
+ * Wall times depend on the machine, so they are only checked against a
+ * file given with --wall-times: the fastest of the repeats must stay within
+ * the time tolerance of it. Exits with 1 if any check fails.
+ *
+ * --update writes the current trajectories (<scenario>.sto), steps and
+ * realizations (budget.tsv) and, with --wall-times, wall times as the new
+ * golden ones instead of checking them.
+ *
+ * Usage: checkReflexRegression [--dir directory] [--wall-times file]
+ *            [--update] [--scenario name] [--final-time t] [--rtol r]
+ *            [--atol a] [--step-tolerance f] [--time-tolerance f]
+ *            [--repeat n]
+ */
+int main(int argc, char* argv[]) {
+
+    try {
+        std::string directory = "regression", wallTimeFile, only;
+        bool update = false;
+        double finalTime = 0.5, reportInterval = 0.01;
+        double rtol = 1.0e-4, atol = 1.0e-6;
+        double stepTolerance = 0.05, timeTolerance = 0.25;
+        int repeat = 3;
+
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--update") {
+                update = true;
+                continue;
+            }
+            if (i + 1 >= argc)
+                throw Exception("Missing value for " + arg);
+            std::string value = argv[++i];
+            if (arg == "--dir")
+                directory = value;
+            else if (arg == "--wall-times")
+                wallTimeFile = value;
+            else if (arg == "--scenario")
+                only = value;
+            else if (arg == "--final-time")
+                finalTime = std::atof(value.c_str());
+            else if (arg == "--rtol")
+                rtol = std::atof(value.c_str());
+            else if (arg == "--atol")
+                atol = std::atof(value.c_str());
+            else if (arg == "--step-tolerance")
+                stepTolerance = std::atof(value.c_str());
+            else if (arg == "--time-tolerance")
+                timeTolerance = std::atof(value.c_str());
+            else if (arg == "--repeat")
+                repeat = std::max(1, std::atoi(value.c_str()));
+            else
+                throw Exception("Unknown option " + arg);
+        }
+
+        Logger::setLevel(Logger::Level::Warn);
+
+        std::string budgetFile = directory + "/budget.tsv";
+        std::map<std::string, Budget> budgets = readBudgets(budgetFile);
+        std::map<std::string, double> wallTimes;
+        if (!wallTimeFile.empty())
+            wallTimes = readWallTimes(wallTimeFile);
+        else
+            repeat = 1;
+        bool failed = false;
+
+        std::cout << "scenario\twall_s\tsteps\trealizations\tstatus" << std::endl;
+        for (const Scenario& scenario : scenarios) {
+            if (!only.empty() && scenario.name != only)
+                continue;
+
+            TimeSeriesTable trajectory;
+            Budget cost = simulate(scenario, finalTime, reportInterval, trajectory);
+            for (int r = 1; r < repeat; r++) {
+                TimeSeriesTable again;
+                cost.wallTime = std::min(cost.wallTime,
+                    simulate(scenario, finalTime, reportInterval, again).wallTime);
+            }
+
+            std::cout << scenario.name << "\t" << cost.wallTime << "\t"
+                      << cost.steps << "\t" << cost.realizations;
+
+            std::string goldenFile = directory + "/" + scenario.name + ".sto";
+            if (update) {
+                IO::makeDir(directory);
+                STOFileAdapter::write(trajectory, goldenFile);
+                budgets[scenario.name] = cost;
+                wallTimes[scenario.name] = cost.wallTime;
+                std::cout << "\tupdated" << std::endl;
+                continue;
+            }
+
+            std::ostringstream problems;
+            if (!std::ifstream(goldenFile))
+                problems << "  no golden trajectory " << goldenFile << "\n";
+            else
+                problems << compare(trajectory, TimeSeriesTable(goldenFile),
+                                    rtol, atol);
+
+            auto found = budgets.find(scenario.name);
+            if (found == budgets.end())
+                problems << "  no budget in " << budgetFile << "\n";
+            else {
+                const Budget& budget = found->second;
+                if (cost.steps > budget.steps*(1 + stepTolerance))
+                    problems << "  " << cost.steps << " steps, budget "
+                             << budget.steps << "\n";
+                if (cost.realizations > budget.realizations*(1 + stepTolerance))
+                    problems << "  " << cost.realizations
+                             << " realizations, budget "
+                             << budget.realizations << "\n";
+            }
+
+            if (!wallTimeFile.empty()) {
+                auto wallTime = wallTimes.find(scenario.name);
+                if (wallTime == wallTimes.end())
+                    problems << "  no wall time in " << wallTimeFile << "\n";
+                else if (cost.wallTime > wallTime->second*(1 + timeTolerance))
+                    problems << "  " << cost.wallTime << " s, budget "
+                             << wallTime->second << " s\n";
+            }
+
+            if (problems.str().empty())
+                std::cout << "\tok" << std::endl;
+            else {
+                failed = true;
+                std::cout << "\tFAILED\n" << problems.str() << std::flush;
+            }
+        }
+
+        if (update) {
+            std::ofstream out(budgetFile);
+            if (!out)
+                throw Exception("Could not open " + budgetFile);
+            out << "# scenario\tsteps\trealizations\n";
+            for (const auto& entry : budgets)
+                out << entry.first << "\t" << entry.second.steps << "\t"
+                    << entry.second.realizations << "\n";
+            std::cout << "Wrote " << budgetFile << std::endl;
+
+            if (!wallTimeFile.empty()) {
+                std::ofstream times(wallTimeFile);
+                if (!times)
+                    throw Exception("Could not open " + wallTimeFile);
+                times << "# scenario\twall_s\n";
+                for (const auto& entry : wallTimes)
+                    times << entry.first << "\t" << entry.second << "\n";
+                std::cout << "Wrote " << wallTimeFile << std::endl;
+            }
+        }
+        return failed ? 1 : 0;
+    }
+
+    catch(const std::exception& ex){
+        std::cout << ex.what() << std::endl;
+        return 1;
+    }
+
+    catch(...){
+        std::cout << "UNRECOGNIZED EXCEPTION" << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,175 @@
+/* -------------------------------------------------------------------------- *
+*                      OpenSim:  mainReplay.cpp                              *
+* -------------------------------------------------------------------------- *
+* The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+* See http://opensim.stanford.edu and the NOTICE file for more information.  *
+* OpenSim is developed at Stanford University and supported by the US        *
+* National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+* through the Warrior Web program.                                           *
+*                                                                            *
+* Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+* Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+*                                                                            *
+* Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+* not use this file except in compliance with the License. You may obtain a  *
+* copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+*                                                                            *
+* Unless required by applicable law or agreed to in writing, software        *
+* distributed under the License is distributed on an "AS IS" BASIS,          *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+* See the License for the specific language governing permissions and        *
+* limitations under the License.                                             *
+* -------------------------------------------------------------------------- */
+
+//=============================================================================
+//=============================================================================
+#include <OpenSim/OpenSim.h>
+#include "OpenSim/Common/STOFileAdapter.h"
+#include "RegisterTypes_osimReflexComponents.h"
+#include "ReflexController.h"
+#include "ReflexReplay.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <limits>
+
+using namespace OpenSim;
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+}
+
+//_____________________________________________________________________________
+/**
+ * Replay the ReflexController of a model open loop over a recorded trial
+ * (see ReflexReplay) and write the reflex controls. The trial holds the
+ * muscle lengths, speeds and tendon lengths, or the states, of the model.
+ * The parameters default to those of the model; --repeat times the replay
+ * over that many evaluations and reports the fastest.
+ *
+ * Usage: replayReflexController model.osim trial.sto [--controller path]
+ *            [--gain-length k] [--gain-velocity k] [--rest-length r]
+ *            [--delay d] [--golgi-delay d] [--repeat n]
+ *            [--out controls.sto]
+ */
+int main(int argc, char* argv[]) {
+
+    try {
+        if (argc < 3)
+            throw Exception("Usage: replayReflexController model.osim "
+                            "trial.sto [--controller path] [--gain-length k] "
+                            "[--gain-velocity k] [--rest-length r] "
+                            "[--delay d] [--golgi-delay d] [--repeat n] "
+                            "[--out controls.sto]");
+        RegisterTypes_osimReflexComponents();
+
+        std::string modelName = argv[1];
+        std::string trialName = argv[2];
+        std::string controllerPath;
+        std::string outName = "replay_controls.sto";
+        int repeat = 1;
+        // the parameters given, NaN for those of the model
+        const double unset = std::numeric_limits<double>::quiet_NaN();
+        ReflexReplay::Parameters given = {unset, unset, unset, unset, unset};
+
+        for (int i = 3; i < argc; i++) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc)
+                throw Exception("Missing value for " + arg);
+            std::string value = argv[++i];
+            if (arg == "--controller")
+                controllerPath = value;
+            else if (arg == "--gain-length")
+                given.gainLength = std::atof(value.c_str());
+            else if (arg == "--gain-velocity")
+                given.gainVelocity = std::atof(value.c_str());
+            else if (arg == "--rest-length")
+                given.normalizedRestLength = std::atof(value.c_str());
+            else if (arg == "--delay")
+                given.delay = std::atof(value.c_str());
+            else if (arg == "--golgi-delay")
+                given.golgiDelay = std::atof(value.c_str());
+            else if (arg == "--repeat")
+                repeat = std::max(1, std::atoi(value.c_str()));
+            else if (arg == "--out")
+                outName = value;
+            else
+                throw Exception("Unknown option " + arg);
+        }
+
+        Model model(modelName);
+        model.setUseVisualizer(false);
+        SimTK::State& s = model.initSystem();
+
+        const ReflexController* controller = nullptr;
+        if (!controllerPath.empty()) {
+            controller = &model.getComponent<ReflexController>(controllerPath);
+        }
+        else {
+            for (const ReflexController& c :
+                    model.getComponentList<ReflexController>()) {
+                controller = &c;
+                break;
+            }
+        }
+        if (!controller)
+            throw Exception("'" + modelName + "' has no ReflexController.");
+
+        ReflexReplay replay(model, s, *controller);
+        ReflexReplay::Parameters p = replay.getDefaultParameters();
+        if (!SimTK::isNaN(given.gainLength))
+            p.gainLength = given.gainLength;
+        if (!SimTK::isNaN(given.gainVelocity))
+            p.gainVelocity = given.gainVelocity;
+        if (!SimTK::isNaN(given.normalizedRestLength))
+            p.normalizedRestLength = given.normalizedRestLength;
+        if (!SimTK::isNaN(given.delay))
+            p.delay = given.delay;
+        if (!SimTK::isNaN(given.golgiDelay))
+            p.golgiDelay = given.golgiDelay;
+
+        auto start = std::chrono::steady_clock::now();
+        ReplayTrial trial = replay.createTrial(TimeSeriesTable(trialName));
+        double trialTime = millisecondsSince(start);
+
+        ReplayOutput output;
+        double replayTime = std::numeric_limits<double>::infinity();
+        for (int r = 0; r < repeat; ++r) {
+            start = std::chrono::steady_clock::now();
+            replay.evaluate(trial, p, output);
+            replayTime = std::min(replayTime, millisecondsSince(start));
+        }
+
+        STOFileAdapter_<double>::write(
+                replay.createControlsTable(trial, output), outName);
+
+        const int numFrames = trial.getNumFrames();
+        const double duration = numFrames > 1
+                ? trial.time.back() - trial.time.front() : 0;
+        std::cout << "Replayed " << replay.getNumChannels() << " channels over "
+                  << numFrames << " frames (" << duration << " s) with "
+                  << "gain_length " << p.gainLength << ", gain_velocity "
+                  << p.gainVelocity << ", normalized_rest_length "
+                  << p.normalizedRestLength << ", delay " << p.delay
+                  << ", golgi delay " << p.golgiDelay << "\n"
+                  << "  trial " << trialTime << " ms, replay " << replayTime
+                  << " ms ("
+                  << 1.e6*replayTime/std::max(1, numFrames*replay.getNumChannels())
+                  << " ns per frame and channel)\n"
+                  << "Wrote " << outName << std::endl;
+    }
+
+    catch(const std::exception& ex){
+        std::cout << ex.what() << std::endl;
+        return 1;
+    }
+
+    catch(...){
+        std::cout << "UNRECOGNIZED EXCEPTION" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
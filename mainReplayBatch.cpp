@@ -0,0 +1,218 @@
+/* -------------------------------------------------------------------------- *
+*                      OpenSim:  mainReplayBatch.cpp                         *
+* -------------------------------------------------------------------------- *
+* The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+* See http://opensim.stanford.edu and the NOTICE file for more information.  *
+* OpenSim is developed at Stanford University and supported by the US        *
+* National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+* through the Warrior Web program.                                           *
+*                                                                            *
+* Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+* Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+*                                                                            *
+* Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+* not use this file except in compliance with the License. You may obtain a  *
+* copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+*                                                                            *
+* Unless required by applicable law or agreed to in writing, software        *
+* distributed under the License is distributed on an "AS IS" BASIS,          *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+* See the License for the specific language governing permissions and        *
+* limitations under the License.                                             *
+* -------------------------------------------------------------------------- */
+
+//=============================================================================
+//=============================================================================
+#include <OpenSim/OpenSim.h>
+#include "RegisterTypes_osimReflexComponents.h"
+#include "ReflexController.h"
+#include "ReflexReplayBatch.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+using namespace OpenSim;
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+}
+
+//_____________________________________________________________________________
+/**
+ * Read parameter sets from a file with one set per line: gain_length,
+ * gain_velocity and optionally normalized_rest_length, delay and
+ * golgi_delay, which otherwise are those of the model. Blank lines and
+ * lines starting with '#' are skipped.
+ */
+static void readSets(const std::string& fileName,
+                     const ReflexReplay::Parameters& defaults,
+                     std::vector<ReflexReplay::Parameters>& sets)
+{
+    std::ifstream in(fileName);
+    if (!in)
+        throw Exception("Could not open parameter sets '" + fileName + "'");
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream row(line);
+        ReflexReplay::Parameters p = defaults;
+        if (!(row >> p.gainLength >> p.gainVelocity))
+            throw Exception("Malformed parameter set '" + line + "' in " +
+                            fileName);
+        // a failed read would zero the default
+        double value;
+        if (row >> value) {
+            p.normalizedRestLength = value;
+            if (row >> value) {
+                p.delay = value;
+                if (row >> value)
+                    p.golgiDelay = value;
+            }
+        }
+        sets.push_back(p);
+    }
+}
+
+//_____________________________________________________________________________
+/**
+ * Replay the ReflexController of a model open loop over every trial with
+ * every parameter set on all cores (see ReflexReplayBatch) and write one
+ * summary row per trial and set: the parameters and the mean and peak
+ * reflex control. --repeat runs the batch that many times and reports the
+ * fastest.
+ *
+ * Usage: batchReplayReflex model.osim trial.sto [trial.sto ...]
+ *            [--sets file] [--threads n] [--repeat n] [--out summary.tsv]
+ */
+int main(int argc, char* argv[]) {
+
+    try {
+        if (argc < 3)
+            throw Exception("Usage: batchReplayReflex model.osim trial.sto "
+                            "[trial.sto ...] [--sets file] [--threads n] "
+                            "[--repeat n] [--out summary.tsv]");
+        RegisterTypes_osimReflexComponents();
+
+        std::string modelName = argv[1];
+        std::vector<std::string> trialNames;
+        std::string setsName;
+        std::string outName = "replay_batch.tsv";
+        int numThreads = 0;
+        int repeat = 1;
+
+        int i = 2;
+        for (; i < argc && std::string(argv[i]).compare(0, 2, "--") != 0; ++i)
+            trialNames.push_back(argv[i]);
+        for (; i < argc; i++) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc)
+                throw Exception("Missing value for " + arg);
+            std::string value = argv[++i];
+            if (arg == "--sets")
+                setsName = value;
+            else if (arg == "--threads")
+                numThreads = std::atoi(value.c_str());
+            else if (arg == "--repeat")
+                repeat = std::max(1, std::atoi(value.c_str()));
+            else if (arg == "--out")
+                outName = value;
+            else
+                throw Exception("Unknown option " + arg);
+        }
+        if (trialNames.empty())
+            throw Exception("Expected at least one trial.");
+
+        Model model(modelName);
+        model.setUseVisualizer(false);
+        SimTK::State& s = model.initSystem();
+        const ReflexController* controller = nullptr;
+        for (const ReflexController& c :
+                model.getComponentList<ReflexController>()) {
+            controller = &c;
+            break;
+        }
+        if (!controller)
+            throw Exception("'" + modelName + "' has no ReflexController.");
+
+        ReflexReplay replay(model, s, *controller);
+        std::vector<ReflexReplay::Parameters> sets;
+        if (setsName.empty())
+            sets.push_back(replay.getDefaultParameters());
+        else
+            readSets(setsName, replay.getDefaultParameters(), sets);
+
+        // the trials are prepared once and then shared by the workers
+        auto start = std::chrono::steady_clock::now();
+        std::vector<ReplayTrial> trials;
+        long long totalFrames = 0;
+        for (const std::string& name : trialNames) {
+            trials.push_back(replay.createTrial(TimeSeriesTable(name)));
+            totalFrames += trials.back().getNumFrames();
+        }
+        double loadTime = millisecondsSince(start);
+
+        ReflexReplayBatch batch(replay, numThreads);
+        ReplayControls controls;
+        double batchTime = std::numeric_limits<double>::infinity();
+        for (int r = 0; r < repeat; ++r) {
+            start = std::chrono::steady_clock::now();
+            batch.evaluate(trials, sets, controls);
+            batchTime = std::min(batchTime, millisecondsSince(start));
+        }
+
+        std::ofstream out(outName);
+        if (!out)
+            throw Exception("Could not open '" + outName + "' for writing.");
+        out << "trial\tset\tgain_length\tgain_velocity\t"
+               "normalized_rest_length\tdelay\tgolgi_delay\tmean_control\t"
+               "peak_control\n";
+        const int numChannels = replay.getNumChannels();
+        for (int n = 0; n < (int)trials.size(); ++n) {
+            const size_t size = (size_t)trials[n].getNumFrames()*numChannels;
+            for (int k = 0; k < (int)sets.size(); ++k) {
+                const double* u = controls.getControls(n, k);
+                double sum = 0, peak = 0;
+                for (size_t j = 0; j < size; ++j) {
+                    sum += u[j];
+                    peak = std::max(peak, std::abs(u[j]));
+                }
+                const ReflexReplay::Parameters& p = sets[k];
+                out << trialNames[n] << "\t" << k << "\t" << p.gainLength
+                    << "\t" << p.gainVelocity << "\t"
+                    << p.normalizedRestLength << "\t" << p.delay << "\t"
+                    << p.golgiDelay << "\t"
+                    << (size ? sum/size : 0) << "\t" << peak << "\n";
+            }
+        }
+
+        const double replays = double(trials.size())*sets.size();
+        std::cout << "Replayed " << trials.size() << " trials ("
+                  << totalFrames << " frames, " << numChannels
+                  << " channels) x " << sets.size() << " parameter sets on "
+                  << batch.getNumThreads() << " threads\n"
+                  << "  trials " << loadTime << " ms, batch " << batchTime
+                  << " ms (" << 1.e3*replays/batchTime << " replays/s, "
+                  << 1.e-3*totalFrames*sets.size()/batchTime
+                  << " Mframes/s)\n"
+                  << "Wrote " << outName << std::endl;
+    }
+
+    catch(const std::exception& ex){
+        std::cout << ex.what() << std::endl;
+        return 1;
+    }
+
+    catch(...){
+        std::cout << "UNRECOGNIZED EXCEPTION" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
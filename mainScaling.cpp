@@ -0,0 +1,189 @@
+/* -------------------------------------------------------------------------- *
+*                          OpenSim:  mainScaling.cpp                         *
+* -------------------------------------------------------------------------- *
+* The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+* See http://opensim.stanford.edu and the NOTICE file for more information.  *
+* OpenSim is developed at Stanford University and supported by the US        *
+* National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+* through the Warrior Web program.                                           *
+*                                                                            *
+* Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+* Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+*                                                                            *
+* Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+* not use this file except in compliance with the License. You may obtain a  *
+* copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+*                                                                            *
+* Unless required by applicable law or agreed to in writing, software        *
+* distributed under the License is distributed on an "AS IS" BASIS,          *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+* See the License for the specific language governing permissions and        *
+* limitations under the License.                                             *
+* -------------------------------------------------------------------------- */
+
+//=============================================================================
+//=============================================================================
+#include <OpenSim/OpenSim.h>
+#include "ReflexModelGenerator.h"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+using namespace OpenSim;
+using namespace SimTK;
+
+//_____________________________________________________________________________
+/**
+ * The resident memory of the process in MB, or NaN where it is not
+ * measured.
+ */
+static double getResidentMegabytes()
+{
+#if defined(__linux__)
+    std::ifstream statm("/proc/self/statm");
+    long pages = 0, resident = 0;
+    if (statm >> pages >> resident)
+        return resident*double(sysconf(_SC_PAGESIZE))/(1024.0*1024.0);
+#endif
+    return std::numeric_limits<double>::quiet_NaN();
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+}
+
+//_____________________________________________________________________________
+/**
+ * Generate reflex models of growing size and report what each costs: the
+ * time to build the model, connect it, build its system and initialize its
+ * state, the memory it adds, and the cost of an integration step.
+ *
+ * The steps are taken as the Manager takes them, returning after every
+ * internal step and realizing Report there, so the delay histories are
+ * recorded as in a simulation.
+ *
+ * Usage: scaleReflexController [--sizes BxM,BxM,...]
+ *            [--topology parallel|chain|tree] [--duration t]
+ *            [--accuracy a] [--bank] [--snapshots]
+ */
+int main(int argc, char* argv[]) {
+
+    try {
+        ReflexModelSpec spec;
+        double duration = 0.01, accuracy = 1.0e-4;
+        std::vector<std::pair<int, int>> sizes;
+
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--bank") {
+                spec.useDelayBank = true;
+                continue;
+            }
+            if (arg == "--snapshots") {
+                spec.useSnapshots = true;
+                continue;
+            }
+            if (i + 1 >= argc)
+                throw Exception("Missing value for " + arg);
+            std::string value = argv[++i];
+            if (arg == "--sizes") {
+                std::istringstream in(value);
+                std::string size;
+                while (std::getline(in, size, ',')) {
+                    int bodies, muscles;
+                    char x;
+                    std::istringstream pair(size);
+                    if (!(pair >> bodies >> x >> muscles) || x != 'x')
+                        throw Exception("--sizes expects BxM, got '" + size + "'");
+                    sizes.emplace_back(bodies, muscles);
+                }
+            }
+            else if (arg == "--topology")
+                spec.topology = ReflexModelSpec::parseTopology(value);
+            else if (arg == "--duration")
+                duration = std::atof(value.c_str());
+            else if (arg == "--accuracy")
+                accuracy = std::atof(value.c_str());
+            else
+                throw Exception("Unknown option " + arg);
+        }
+        if (sizes.empty())
+            sizes = {{1, 1}, {10, 10}, {100, 100}, {1000, 1000},
+                     {10000, 10000}};
+
+        Logger::setLevel(Logger::Level::Warn);
+
+        std::cout << "topology\tbodies\tmuscles\tbuild_ms\tconnect_ms"
+                     "\tsystem_ms\tinit_ms\tmemory_mb\tsteps\tus_per_step"
+                     "\tns_per_step_muscle" << std::endl;
+        for (const std::pair<int, int>& size : sizes) {
+            spec.numBodies = size.first;
+            spec.numMuscles = size.second;
+
+            double memoryBefore = getResidentMegabytes();
+            auto start = std::chrono::steady_clock::now();
+            Model model;
+            generateReflexModel(spec, model);
+            double buildTime = millisecondsSince(start);
+
+            start = std::chrono::steady_clock::now();
+            model.finalizeFromProperties();
+            model.finalizeConnections();
+            double connectTime = millisecondsSince(start);
+
+            start = std::chrono::steady_clock::now();
+            model.buildSystem();
+            double systemTime = millisecondsSince(start);
+
+            start = std::chrono::steady_clock::now();
+            SimTK::State& si = model.initializeState();
+            model.equilibrateMuscles(si);
+            double initTime = millisecondsSince(start);
+            double memory = getResidentMegabytes() - memoryBefore;
+
+            const MultibodySystem& system = model.getMultibodySystem();
+            RungeKuttaMersonIntegrator integrator(system);
+            integrator.setAccuracy(accuracy);
+            integrator.setReturnEveryInternalStep(true);
+            TimeStepper stepper(system, integrator);
+            stepper.initialize(si);
+
+            start = std::chrono::steady_clock::now();
+            while (stepper.getTime() < duration) {
+                stepper.stepTo(duration);
+                system.realize(stepper.getState(), Stage::Report);
+            }
+            double stepTime = millisecondsSince(start);
+            int steps = integrator.getNumStepsTaken();
+            double usPerStep = steps > 0 ? 1000.0*stepTime/steps : 0.0;
+
+            std::cout << ReflexModelSpec::getTopologyName(spec.topology)
+                      << "\t" << spec.numBodies << "\t" << spec.numMuscles
+                      << "\t" << buildTime << "\t" << connectTime
+                      << "\t" << systemTime << "\t" << initTime
+                      << "\t" << memory << "\t" << steps
+                      << "\t" << usPerStep
+                      << "\t" << 1000.0*usPerStep/spec.numMuscles << std::endl;
+        }
+    }
+
+    catch(const std::exception& ex){
+        std::cout << ex.what() << std::endl;
+        return 1;
+    }
+
+    catch(...){
+        std::cout << "UNRECOGNIZED EXCEPTION" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
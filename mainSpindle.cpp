@@ -28,6 +28,9 @@
 #include <OpenSim/Common/IO.h>
 #include "OpenSim/Common/STOFileAdapter.h"
 #include "ReflexController.h"
+#include "StreamingReporter.h"
+#include "ColumnFile.h"
+#include "SignalRecorder.h"
 
 using namespace OpenSim;
 using namespace SimTK;
@@ -146,12 +149,27 @@ int main() {
         // Add the muscle controller to the model
         osimModel.addController(stretchReflex);
         
-        // Add analysis
-        MuscleAnalysis* muscAnalysis = new MuscleAnalysis(&osimModel);
-        Array<std::string> coords(blockToGround->getCoordinate(FreeJoint::Coord::TranslationZ).getName(),1);
-        muscAnalysis->setCoordinates(coords);
-        muscAnalysis->setComputeMoments(false);
-        osimModel.addAnalysis(muscAnalysis);
+        // Record the muscle signals of interest at 1 kHz
+        SignalRecorder* recorder = new SignalRecorder("recorder", 1000);
+        recorder->addToRecord(original1->getOutput("excitation"));
+        recorder->addToRecord(original1->getOutput("fiber_length"));
+        recorder->addToRecord(original1->getOutput("fiber_velocity"));
+        recorder->addToRecord(original1->getOutput("tendon_length"));
+        osimModel.addComponent(recorder);
+        
+        // Stream the coordinates and the muscle states and forces to disk
+        // while integrating; convertReflexResults turns the file into .sto
+        StreamingReporter* results =
+                new StreamingReporter("results", "tugOfWar_results.rxs");
+        for (int i = 0; i < blockToGround->numCoordinates(); ++i) {
+            const Coordinate& coord = blockToGround->get_coordinates(i);
+            results->addToReport(coord.getOutput("value"));
+            results->addToReport(coord.getOutput("speed"));
+        }
+        results->addToReport(original1->getOutput("activation"));
+        results->addToReport(original1->getOutput("fiber_length"));
+        results->addToReport(original1->getOutput("tendon_force"));
+        osimModel.addComponent(results);
         
         // set visualizer
         osimModel.setUseVisualizer(false);
@@ -183,13 +201,11 @@ int main() {
         // Compute initial conditions for muscles
         osimModel.equilibrateMuscles(si);
 
-        // Create the force reporter
-        ForceReporter* reporter = new ForceReporter(&osimModel);
-        osimModel.updAnalysisSet().adoptAndAppend(reporter);
-        
-        // Create the manager
+        // Create the manager; the results are streamed, so it keeps no
+        // states table
         Manager manager(osimModel);
         manager.setIntegratorAccuracy(1.0e-6);
+        manager.setWriteToStorage(false);
         
         // Print out details of the model
         osimModel.printDetailedInfo(si, std::cout);
@@ -204,20 +220,17 @@ int main() {
         // SAVE THE RESULTS TO FILE //
         //////////////////////////////
 
-        // Save the simulation results
-        // Save the states
-        auto statesTable = manager.getStatesTable();
-        STOFileAdapter_<double>::write(statesTable,
-                                      "tugOfWar_states.sto");
-
-        auto forcesTable = reporter->getForcesTable();
-        STOFileAdapter_<double>::write(forcesTable,
-                                      "tugOfWar_forces.sto");
+        // Complete the results stream and lay it out in columns, which
+        // ColumnFile maps for post-processing
+        results->close();
+        convertResultsStream(results->get_file_name(),
+                             "tugOfWar_results.rxc");
+        std::cout << "Wrote " << results->getNumRows() << " rows to "
+                  << "tugOfWar_results.rxc" << std::endl;
         
 
-        // Save the muscle analysis results
-        IO::makeDir("MuscleAnalysisResults");
-        muscAnalysis->printResults("original1", "MuscleAnalysisResults");
+        // Save the recorded muscle signals
+        recorder->writeColumnFile("tugOfWar_signals.rxc");
         
         // To print (serialize) the latest connections of the model, it is
         // necessary to finalizeConnections() first.
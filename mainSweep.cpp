@@ -0,0 +1,460 @@
+/* -------------------------------------------------------------------------- *
+*                           OpenSim:  mainSweep.cpp                          *
+* -------------------------------------------------------------------------- *
+* The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+* See http://opensim.stanford.edu and the NOTICE file for more information.  *
+* OpenSim is developed at Stanford University and supported by the US        *
+* National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+* through the Warrior Web program.                                           *
+*                                                                            *
+* Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+* Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+*                                                                            *
+* Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+* not use this file except in compliance with the License. You may obtain a  *
+* copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+*                                                                            *
+* Unless required by applicable law or agreed to in writing, software        *
+* distributed under the License is distributed on an "AS IS" BASIS,          *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+* See the License for the specific language governing permissions and        *
+* limitations under the License.                                             *
+* -------------------------------------------------------------------------- */
+
+//=============================================================================
+//=============================================================================
+#include <OpenSim/OpenSim.h>
+#include "SimpleSpindle.h"
+#include "GolgiTendon.h"
+#include "ReflexController.h"
+#include "WorkStealingPool.h"
+#include "StateCheckpoint.h"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <sstream>
+
+using namespace OpenSim;
+using namespace SimTK;
+
+// the swept parameters, in the column order of list files and of the output
+static const char* parameterNames[] = {
+    "gain_length", "gain_velocity", "normalized_rest_length", "delay",
+    "perturbation"};
+static const int numParameters = 5;
+
+struct RunParameters {
+    double values[numParameters];
+};
+
+struct RunSummary {
+    double peakForce;
+    double settlingTime;
+    double wallTime;
+    bool failed;
+};
+
+//_____________________________________________________________________________
+/**
+ * Build a block on a slider between two opposing muscles, each with a spindle
+ * and a Golgi tendon organ wired to one ReflexController. The block starts
+ * displaced so that the reflexes have a perturbation to settle.
+ */
+static void buildModel(Model& osimModel)
+{
+    osimModel.setName("reflexSweep");
+    Ground& ground = osimModel.updGround();
+
+    double blockMass = 20.0, blockSideLength = 0.1;
+    Inertia blockInertia = blockMass*Inertia::brick(blockSideLength, blockSideLength, blockSideLength);
+    OpenSim::Body *block = new OpenSim::Body("block", blockMass, Vec3(0), blockInertia);
+
+    double halfLength = blockSideLength/2.0;
+    SliderJoint *blockToGround = new SliderJoint("blockToGround", ground, Vec3(0, halfLength, 0), Vec3(0, SimTK::Pi/2, 0), *block, Vec3(0, halfLength, 0), Vec3(0, SimTK::Pi/2, 0));
+    blockToGround->updCoordinate().setDefaultValue(0.02);
+    osimModel.addBody(block);
+    osimModel.addJoint(blockToGround);
+
+    double maxIsometricForce = 1000.0, optimalFiberLength = 0.2,
+    tendonSlackLength = 0.1, pennationAngle = 0.0;
+
+    ReflexController *stretchReflex = new ReflexController("reflex", 1.0, 1.0, 1.0);
+
+    for (int i = 0; i < 2; i++) {
+        std::string name = "muscle" + std::to_string(i);
+        double side = (i == 0) ? 1.0 : -1.0;
+
+        Millard2012EquilibriumMuscle* muscle =
+            new Millard2012EquilibriumMuscle(name,
+                maxIsometricForce, optimalFiberLength, tendonSlackLength,
+                pennationAngle);
+        muscle->addNewPathPoint(name + "-point1", ground,
+            Vec3(0.0, halfLength, side*0.35));
+        muscle->addNewPathPoint(name + "-point2", *block,
+            Vec3(0.0, halfLength, side*halfLength));
+        muscle->setDefaultActivation(0.01);
+        muscle->setDefaultFiberLength(optimalFiberLength);
+        osimModel.addForce(muscle);
+
+        SimpleSpindle* spindle = new SimpleSpindle("spindle_" + name, *muscle, 1.0, 0.03);
+        GolgiTendon* golgi = new GolgiTendon("golgi_" + name, *muscle, 0.03);
+        osimModel.addComponent(spindle);
+        osimModel.addComponent(golgi);
+        stretchReflex->addSpindle(*spindle);
+        stretchReflex->addGolgi(*golgi);
+    }
+
+    stretchReflex->setActuators(osimModel.updActuators());
+    osimModel.addController(stretchReflex);
+    osimModel.setUseVisualizer(false);
+
+    // resolve the sockets into paths so that clones reconnect
+    osimModel.finalizeConnections();
+}
+
+// a worker's model, built and equilibrated once for all of its runs
+struct Worker {
+    std::unique_ptr<Model> model;
+    SimTK::State initialState;
+    bool initialized = false;
+};
+
+//_____________________________________________________________________________
+/**
+ * Simulate one parameter set from a copy of the worker's initial state, or
+ * from the checkpoint if there is one, until finalTime, sampling the peak
+ * muscle force and the block position every reportInterval seconds. The
+ * parameters are all kept in the State, so the system is not rebuilt. The
+ * perturbation is added to the block's speed at the start.
+ */
+static RunSummary simulate(Worker& worker, const RunParameters& p,
+                           const StateCheckpoint& checkpoint,
+                           double finalTime, double reportInterval)
+{
+    Model& model = *worker.model;
+    SimTK::State si = worker.initialState;
+    if (!checkpoint.isEmpty())
+        checkpoint.restore(model, si);
+
+    for (const ReflexController& controller : model.getComponentList<ReflexController>()) {
+        controller.setGainLength(si, p.values[0]);
+        controller.setGainVelocity(si, p.values[1]);
+    }
+    // a new delay clears the delay histories, so a continuation keeps the
+    // delay of its prefix
+    auto checkDelay = [&](double delay) {
+        if (!checkpoint.isEmpty() && delay != p.values[3])
+            throw Exception("The delay of a branch must match its checkpoint's.");
+        return delay != p.values[3];
+    };
+    for (const SimpleSpindle& spindle : model.getComponentList<SimpleSpindle>()) {
+        spindle.setNormalizedRestLength(si, p.values[2]);
+        if (checkDelay(spindle.getDelay(si)))
+            spindle.setDelay(si, p.values[3]);
+    }
+    for (const GolgiTendon& golgi : model.getComponentList<GolgiTendon>()) {
+        if (checkDelay(golgi.getDelay(si)))
+            golgi.setDelay(si, p.values[3]);
+    }
+
+    const Coordinate& coordinate = model.getCoordinateSet()[0];
+    const MultibodySystem& system = model.getMultibodySystem();
+    coordinate.setSpeedValue(si, coordinate.getSpeedValue(si) + p.values[4]);
+
+    // a Manager is cheap next to building the system
+    Manager manager(model);
+    manager.setIntegratorAccuracy(1.0e-6);
+    manager.setWriteToStorage(false);
+    manager.setPerformAnalyses(false);
+    manager.initialize(si);
+
+    double startTime = si.getTime();
+    double duration = finalTime - startTime;
+    if (!(duration > 0.0))
+        throw Exception("The run starts at or after --final-time.");
+    int numSamples = static_cast<int>(std::ceil(duration/reportInterval - 1e-9));
+    std::vector<double> position(numSamples + 1);
+    position[0] = coordinate.getValue(si);
+
+    RunSummary summary;
+    summary.peakForce = 0.0;
+    summary.failed = false;
+    for (int k = 1; k <= numSamples; k++) {
+        const SimTK::State& s = manager.integrate(
+                std::min(startTime + k*reportInterval, finalTime));
+        system.realize(s, Stage::Dynamics);
+        for (const Muscle& muscle : model.getComponentList<Muscle>())
+            summary.peakForce = std::max(summary.peakForce, std::abs(muscle.getActuation(s)));
+        position[k] = coordinate.getValue(s);
+    }
+
+    // settled once the block stays within 2% of its largest excursion from
+    // the final position
+    double finalPosition = position[numSamples];
+    double excursion = 0.0;
+    for (double x : position)
+        excursion = std::max(excursion, std::abs(x - finalPosition));
+    double band = std::max(0.02*excursion, 1.0e-6);
+    int last = -1;
+    for (int k = 0; k <= numSamples; k++)
+        if (std::abs(position[k] - finalPosition) > band)
+            last = k;
+    summary.settlingTime = std::min((last + 1)*reportInterval, duration);
+    return summary;
+}
+
+//_____________________________________________________________________________
+/**
+ * Expand "name=start:stop:count" into count evenly spaced values of the
+ * named parameter, or "name=value" into one.
+ */
+static int parseGrid(const std::string& spec, std::vector<double>& values)
+{
+    size_t eq = spec.find('=');
+    if (eq == std::string::npos)
+        throw Exception("--grid expects name=start:stop:count, got '" + spec + "'");
+    std::string name = spec.substr(0, eq);
+    int index = -1;
+    for (int i = 0; i < numParameters; i++)
+        if (name == parameterNames[i])
+            index = i;
+    if (index < 0)
+        throw Exception("--grid: unknown parameter '" + name + "'");
+
+    double start, stop;
+    int count;
+    char colon1, colon2;
+    std::istringstream in(spec.substr(eq + 1));
+    values.clear();
+    if (spec.find(':', eq) != std::string::npos) {
+        if (!(in >> start >> colon1 >> stop >> colon2 >> count)
+                || colon1 != ':' || colon2 != ':' || count < 1)
+            throw Exception("--grid: malformed range '" + spec + "'");
+        for (int i = 0; i < count; i++)
+            values.push_back(count == 1 ? start : start + (stop - start)*i/(count - 1));
+    }
+    else {
+        std::istringstream single(spec.substr(eq + 1));
+        if (!(single >> start))
+            throw Exception("--grid: malformed value '" + spec + "'");
+        values.push_back(start);
+    }
+    return index;
+}
+
+//_____________________________________________________________________________
+/**
+ * Read parameter sets from a file with one set per line, in the order of
+ * parameterNames. Blank lines and lines starting with '#' are skipped.
+ */
+static void readList(const std::string& fileName, std::vector<RunParameters>& runs)
+{
+    std::ifstream in(fileName);
+    if (!in)
+        throw Exception("Could not open parameter list '" + fileName + "'");
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream row(line);
+        RunParameters p;
+        for (int i = 0; i < numParameters; i++)
+            if (!(row >> p.values[i]))
+                throw Exception("Malformed parameter set '" + line + "' in " + fileName);
+        runs.push_back(p);
+    }
+}
+
+//_____________________________________________________________________________
+/**
+ * Simulate the reflex model for a grid or list of parameter sets on all
+ * cores and write one summary row per run: the parameters, the peak muscle
+ * force, the settling time of the block and the wall time of the run.
+ *
+ * Usage: sweepReflexController [--grid name=start:stop:count]...
+ *            [--list file] [--threads n] [--final-time t]
+ *            [--report-interval dt] [--out file]
+ *            [--branch-time t [--checkpoint file] | --from-checkpoint file]
+ *
+ * Grid parameters not given keep their default; the grid is the Cartesian
+ * product of the given ranges. The parameters are gain_length,
+ * gain_velocity, normalized_rest_length, delay (of every spindle and Golgi
+ * tendon organ) and perturbation, a speed (m/s) added to the block when the
+ * run starts.
+ *
+ * With --branch-time the runs share a prefix: it is simulated once, with
+ * the parameters of the first run, and every run continues from its
+ * checkpoint, which --checkpoint also writes to a file. --from-checkpoint
+ * continues from a checkpoint file instead. The settling time is then
+ * measured from the branch time.
+ */
+int main(int argc, char* argv[]) {
+
+    try {
+        int numThreads = 0;
+        double finalTime = 2.0, reportInterval = 0.001;
+        double branchTime = 0.0;
+        std::string outName, listName, checkpointName, fromCheckpointName;
+        std::vector<std::vector<double>> axes = {{1.0}, {1.0}, {1.0}, {0.03}, {0.0}};
+
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc)
+                throw Exception("Missing value for " + arg);
+            std::string value = argv[++i];
+            if (arg == "--grid") {
+                std::vector<double> values;
+                int index = parseGrid(value, values);
+                axes[index] = values;
+            }
+            else if (arg == "--list")
+                listName = value;
+            else if (arg == "--threads")
+                numThreads = std::atoi(value.c_str());
+            else if (arg == "--final-time")
+                finalTime = std::atof(value.c_str());
+            else if (arg == "--report-interval")
+                reportInterval = std::atof(value.c_str());
+            else if (arg == "--out")
+                outName = value;
+            else if (arg == "--branch-time")
+                branchTime = std::atof(value.c_str());
+            else if (arg == "--checkpoint")
+                checkpointName = value;
+            else if (arg == "--from-checkpoint")
+                fromCheckpointName = value;
+            else
+                throw Exception("Unknown option " + arg);
+        }
+        if (!(finalTime > 0.0) || !(reportInterval > 0.0))
+            throw Exception("--final-time and --report-interval must be positive");
+
+        std::vector<RunParameters> runs;
+        if (!listName.empty())
+            readList(listName, runs);
+        else {
+            RunParameters p;
+            std::vector<size_t> k(numParameters, 0);
+            for (;;) {
+                for (int i = 0; i < numParameters; i++)
+                    p.values[i] = axes[i][k[i]];
+                runs.push_back(p);
+                int i = numParameters - 1;
+                while (i >= 0 && ++k[i] == axes[i].size())
+                    k[i--] = 0;
+                if (i < 0)
+                    break;
+            }
+        }
+
+        // the per-worker model builds are routine here
+        Logger::setLevel(Logger::Level::Warn);
+
+        Model templateModel;
+        buildModel(templateModel);
+
+        // the shared prefix, simulated once
+        StateCheckpoint checkpoint;
+        if (!fromCheckpointName.empty())
+            checkpoint = StateCheckpoint(fromCheckpointName);
+        else if (branchTime > 0.0) {
+            Model prefixModel(templateModel);
+            const RunParameters& p = runs.front();
+            for (ReflexController& controller : prefixModel.updComponentList<ReflexController>()) {
+                controller.set_gain_length(p.values[0]);
+                controller.set_gain_velocity(p.values[1]);
+            }
+            for (SimpleSpindle& spindle : prefixModel.updComponentList<SimpleSpindle>()) {
+                spindle.set_normalized_rest_length(p.values[2]);
+                spindle.set_delay(p.values[3]);
+            }
+            for (GolgiTendon& golgi : prefixModel.updComponentList<GolgiTendon>())
+                golgi.set_delay(p.values[3]);
+
+            SimTK::State& si = prefixModel.initSystem();
+            prefixModel.equilibrateMuscles(si);
+            Manager manager(prefixModel);
+            manager.setIntegratorAccuracy(1.0e-6);
+            manager.setWriteToStorage(false);
+            manager.setPerformAnalyses(false);
+            manager.initialize(si);
+            checkpoint = StateCheckpoint(prefixModel, manager.integrate(branchTime));
+            if (!checkpointName.empty())
+                checkpoint.print(checkpointName);
+        }
+
+        // every worker owns a model, cloned up front so that no two threads
+        // touch the same one, and builds its system on its first run
+        WorkStealingPool pool(numThreads);
+        std::vector<Worker> workers(pool.getNumThreads());
+        for (Worker& worker : workers)
+            worker.model.reset(templateModel.clone());
+
+        std::vector<RunSummary> summaries(runs.size());
+        auto start = std::chrono::steady_clock::now();
+        pool.run(static_cast<int>(runs.size()), [&](int worker, int run) {
+            auto runStart = std::chrono::steady_clock::now();
+            RunSummary& summary = summaries[run];
+            try {
+                Worker& w = workers[worker];
+                if (!w.initialized) {
+                    SimTK::State& si = w.model->initSystem();
+                    w.model->equilibrateMuscles(si);
+                    w.initialState = si;
+                    w.initialized = true;
+                }
+                summary = simulate(w, runs[run], checkpoint, finalTime,
+                                   reportInterval);
+            }
+            catch (const std::exception& ex) {
+                log_warn("Run {} failed: {}", run, ex.what());
+                summary.peakForce = summary.settlingTime =
+                    std::numeric_limits<double>::quiet_NaN();
+                summary.failed = true;
+            }
+            summary.wallTime = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - runStart).count();
+        });
+        double total = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+
+        std::ofstream file;
+        if (!outName.empty()) {
+            file.open(outName);
+            if (!file)
+                throw Exception("Could not open " + outName);
+        }
+        std::ostream& out = outName.empty() ? std::cout : file;
+
+        out << "run";
+        for (int i = 0; i < numParameters; i++)
+            out << "\t" << parameterNames[i];
+        out << "\tpeak_force\tsettling_time\twall_time\tstatus" << std::endl;
+        for (size_t r = 0; r < runs.size(); r++) {
+            out << r;
+            for (int i = 0; i < numParameters; i++)
+                out << "\t" << runs[r].values[i];
+            const RunSummary& summary = summaries[r];
+            out << "\t" << summary.peakForce << "\t" << summary.settlingTime
+                << "\t" << summary.wallTime << "\t"
+                << (summary.failed ? "failed" : "ok") << "\n";
+        }
+
+        std::cerr << runs.size() << " runs on " << pool.getNumThreads()
+                  << " threads in " << total << " s" << std::endl;
+    }
+
+    catch(const std::exception& ex){
+        std::cout << ex.what() << std::endl;
+        return 1;
+    }
+
+    catch(...){
+        std::cout << "UNRECOGNIZED EXCEPTION" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,112 @@
+/* -------------------------------------------------------------------------- *
+*                      OpenSim:  testAlignedArray.cpp                        *
+* -------------------------------------------------------------------------- *
+* The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+* See http://opensim.stanford.edu and the NOTICE file for more information.  *
+* OpenSim is developed at Stanford University and supported by the US        *
+* National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+* through the Warrior Web program.                                           *
+*                                                                            *
+* Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+* Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+*                                                                            *
+* Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+* not use this file except in compliance with the License. You may obtain a  *
+* copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+*                                                                            *
+* Unless required by applicable law or agreed to in writing, software        *
+* distributed under the License is distributed on an "AS IS" BASIS,          *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+* See the License for the specific language governing permissions and        *
+* limitations under the License.                                             *
+* -------------------------------------------------------------------------- */
+
+//=============================================================================
+//=============================================================================
+#include "ReflexKernel.h"
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace OpenSim;
+
+static void check(bool condition, const std::string& message)
+{
+    if (!condition)
+        throw std::runtime_error(message);
+}
+
+static bool isAligned(const double* p)
+{
+    return reinterpret_cast<std::uintptr_t>(p) % AlignedArray::Alignment == 0;
+}
+
+static void checkSame(const AlignedArray& copy, const AlignedArray& original,
+                      const std::string& what)
+{
+    check(copy.size() == original.size(), what + ": size differs");
+    check(isAligned(copy.data()), what + ": not aligned");
+    for (int i = 0; i < original.size(); ++i)
+        check(copy[i] == original[i],
+              what + ": element " + std::to_string(i) + " differs");
+}
+
+//_____________________________________________________________________________
+/**
+ * Copies of an AlignedArray get buffers at other offsets from the alignment
+ * and must still hold the same values, as the per-State scratch arrays of
+ * ReflexController and the kinematics of a copied ReplayTrial do.
+ */
+int main() {
+
+    try {
+        std::vector<AlignedArray> copies;
+        std::vector<std::vector<char>> spacers;
+        for (int k = 0; k < 200; ++k) {
+            AlignedArray original;
+            original.assign(13, 0.0);
+            for (int i = 0; i < original.size(); ++i)
+                original[i] = k + 0.25*i;
+
+            // shift the heap so the copies land at varying offsets
+            spacers.emplace_back(8*k + 1);
+
+            AlignedArray constructed(original);
+            checkSame(constructed, original, "copy constructed");
+
+            AlignedArray assigned;
+            assigned.assign(3, 1.0);
+            assigned = original;
+            checkSame(assigned, original, "copy assigned");
+
+            AlignedArray reused;
+            reused.assign(13, -1.0);
+            reused = original;
+            checkSame(reused, original, "copy assigned in place");
+
+            AlignedArray moved(std::move(constructed));
+            checkSame(moved, original, "moved");
+
+            copies.push_back(original);
+        }
+        for (int k = 0; k < (int)copies.size(); ++k)
+            for (int i = 0; i < copies[k].size(); ++i)
+                check(copies[k][i] == k + 0.25*i,
+                      "copy " + std::to_string(k) + " changed");
+
+        AlignedArray empty;
+        AlignedArray emptyCopy(empty);
+        check(emptyCopy.size() == 0, "copy of an empty array is not empty");
+
+        std::cout << "AlignedArray copies hold their values." << std::endl;
+    }
+
+    catch(const std::exception& ex){
+        std::cout << ex.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
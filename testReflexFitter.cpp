@@ -0,0 +1,159 @@
+/* -------------------------------------------------------------------------- *
+*                      OpenSim:  testReflexFitter.cpp                        *
+* -------------------------------------------------------------------------- *
+* The OpenSim API is a toolkit for musculoskeletal modeling and simulation.  *
+* See http://opensim.stanford.edu and the NOTICE file for more information.  *
+* OpenSim is developed at Stanford University and supported by the US        *
+* National Institutes of Health (U54 GM072970, R24 HD065690) and by DARPA    *
+* through the Warrior Web program.                                           *
+*                                                                            *
+* Copyright (c) 2005-2021 Stanford University, TU Delft and the Authors      *
+* Author(s): Ajay Seth, Hjalti Hilmarsson                                    *
+*                                                                            *
+* Licensed under the Apache License, Version 2.0 (the "License"); you may    *
+* not use this file except in compliance with the License. You may obtain a  *
+* copy of the License at http://www.apache.org/licenses/LICENSE-2.0.         *
+*                                                                            *
+* Unless required by applicable law or agreed to in writing, software        *
+* distributed under the License is distributed on an "AS IS" BASIS,          *
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied    *
+* See the License for the specific language governing permissions and        *
+* limitations under the License.                                             *
+* -------------------------------------------------------------------------- */
+
+//=============================================================================
+//=============================================================================
+#include <OpenSim/OpenSim.h>
+#include "ReflexController.h"
+#include "ReflexFitter.h"
+#include "ReflexModelGenerator.h"
+#include <cmath>
+#include <iostream>
+
+using namespace OpenSim;
+
+static void check(bool condition, const std::string& message)
+{
+    if (!condition)
+        throw Exception(message);
+}
+
+//_____________________________________________________________________________
+/**
+ * Synthetic kinematics of the channels of replay: fiber lengths swinging
+ * around the rest length, their speeds, and tendons stretched past their
+ * slack lengths, at different frequencies for every muscle.
+ */
+static TimeSeriesTable createKinematics(const Model& model,
+                                        const ReflexReplay& replay,
+                                        double duration, double phase)
+{
+    const double pi = SimTK::Pi;
+    const std::vector<std::string>& names = replay.getChannelNames();
+    std::vector<std::string> labels;
+    for (const std::string& name : names) {
+        labels.push_back(name + "|length");
+        labels.push_back(name + "|lengthening_speed");
+        labels.push_back(name + "|tendon_length");
+    }
+    TimeSeriesTable table;
+    table.setColumnLabels(labels);
+
+    const int numFrames = (int)std::round(duration*1000) + 1;
+    SimTK::RowVector row((int)labels.size());
+    for (int i = 0; i < numFrames; ++i) {
+        const double t = 0.001*i;
+        for (int c = 0; c < (int)names.size(); ++c) {
+            const Muscle& muscle = model.getMuscles().get(names[c]);
+            const double l0 = muscle.getOptimalFiberLength();
+            const double slack = muscle.getTendonSlackLength();
+            const double f = 1.3 + 0.7*c;
+            const double a = 2*pi*f*t + phase + c;
+            row[3*c] = l0*(1 + 0.15*std::sin(a) + 0.05*std::sin(2.7*a));
+            row[3*c + 1] = l0*2*pi*f*(0.15*std::cos(a) +
+                                      0.05*2.7*std::cos(2.7*a));
+            row[3*c + 2] = slack*(1 + 0.02*std::sin(1.9*a + 1) +
+                                  0.01*std::sin(4.3*a));
+        }
+        table.appendRow(t, row);
+    }
+    return table;
+}
+
+//_____________________________________________________________________________
+/**
+ * Fit a ReflexController to the controls it produced with known parameters
+ * on synthetic trials, which reach the fitter by copy, and check that the
+ * fit recovers the parameters from a different starting point.
+ */
+int main() {
+
+    try {
+        ReflexModelSpec spec;
+        spec.numBodies = 1;
+        spec.numMuscles = 2;
+        Model model;
+        const ReflexController& controller = generateReflexModel(spec, model);
+        model.setUseVisualizer(false);
+        SimTK::State& s = model.initSystem();
+
+        ReflexReplay replay(model, s, controller);
+        ReflexReplay::Parameters truth = replay.getDefaultParameters();
+        truth.gainLength = 2.5;
+        truth.gainVelocity = 0.8;
+        truth.delay = 0.04;
+        truth.golgiDelay = 0.025;
+
+        ReflexFitter fitter(replay, 2);
+        for (int k = 0; k < 2; ++k) {
+            ReplayTrial trial = replay.createTrial(
+                    createKinematics(model, replay, 2.0, 0.5*k));
+            ReplayOutput output;
+            replay.evaluate(trial, truth, output);
+            TimeSeriesTable emg = replay.createControlsTable(trial, output);
+            // the trial is copied into the fitter
+            fitter.addTrial(trial, emg);
+        }
+        check(fitter.calcCost(truth) < 1e-20,
+              "The controls of the true parameters do not match the EMG.");
+
+        ReflexFitter::Settings& settings = fitter.updSettings();
+        settings.seed = 7;
+        settings.verbose = false;
+        settings.parameterTolerance = 1e-6;
+        settings.costTolerance = 1e-16;
+        settings.maxGenerations = 400;
+
+        ReflexReplay::Parameters initial = truth;
+        initial.gainLength = 1.0;
+        initial.gainVelocity = 1.0;
+        initial.delay = 0.02;
+        initial.golgiDelay = 0.05;
+        ReflexFitter::Result result = fitter.fit(initial);
+        const ReflexReplay::Parameters& p = result.parameters;
+
+        std::cout << "Fitted gain_length " << p.gainLength
+                  << ", gain_velocity " << p.gainVelocity
+                  << ", delay " << p.delay << ", golgi_delay "
+                  << p.golgiDelay << " with cost " << result.cost
+                  << " in " << result.generations << " generations"
+                  << std::endl;
+        check(std::abs(p.gainLength - truth.gainLength) < 0.01*truth.gainLength,
+              "gain_length was not recovered.");
+        check(std::abs(p.gainVelocity - truth.gainVelocity) <
+              0.01*truth.gainVelocity, "gain_velocity was not recovered.");
+        check(std::abs(p.delay - truth.delay) < 5e-4,
+              "delay was not recovered.");
+        check(std::abs(p.golgiDelay - truth.golgiDelay) < 5e-4,
+              "golgi_delay was not recovered.");
+        check(p.normalizedRestLength == truth.normalizedRestLength,
+              "The fixed normalized_rest_length changed.");
+    }
+
+    catch(const std::exception& ex){
+        std::cout << ex.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}